@@ -1,15 +1,35 @@
 import path from 'path';
 import fs from 'fs';
+import { createRequire } from 'module';
 import { fileURLToPath } from 'url';
 
 const __filename = fileURLToPath(import.meta.url);
 const __dirname = path.dirname(__filename);
 
-// WASM Battle Engine Loader
+// Native addon built by the engine's battle_sim_node target (see
+// engine/README.md); BATTLE_NATIVE_ADDON overrides the path
+const NATIVE_ADDON_PATH = path.join(__dirname, '../../native/battle_sim.node');
+
+// embind vectors expose size()/get(); the native addon returns plain arrays
+const toArray = (vector) => {
+  if (Array.isArray(vector)) {
+    return vector;
+  }
+  const items = [];
+  for (let i = 0; i < vector.size(); i++) {
+    items.push(vector.get(i));
+  }
+  return items;
+};
+
+// Battle Engine Loader. Uses the native Node.js addon when it is available
+// (battles then run on libuv worker threads) and the WASM module otherwise;
+// BATTLE_ENGINE=native|wasm forces one.
 class WASMEngine {
   constructor() {
     this.module = null;
     this.initialized = false;
+    this.backend = null;
   }
 
   async initialize() {
@@ -17,6 +37,11 @@ class WASMEngine {
       return;
     }
 
+    const preferred = process.env.BATTLE_ENGINE || 'auto';
+    if (preferred !== 'wasm' && this.loadNative(preferred === 'native')) {
+      return;
+    }
+
     try {
       const wasmPath = path.join(__dirname, '../../wasm/battle_sim.wasm');
       const jsPath = path.join(__dirname, '../../wasm/battle_sim.js');
@@ -69,6 +94,7 @@ class WASMEngine {
       });
 
       this.initialized = true;
+      this.backend = 'wasm';
       console.log('✅ WASM Battle Engine loaded successfully');
     } catch (error) {
       console.error('❌ Failed to load WASM module:', error);
@@ -76,6 +102,28 @@ class WASMEngine {
     }
   }
 
+  // Load the native addon; returns false (or throws when `required`) if it
+  // isn't built or doesn't load on this platform
+  loadNative(required) {
+    const addonPath = process.env.BATTLE_NATIVE_ADDON || NATIVE_ADDON_PATH;
+    try {
+      if (!fs.existsSync(addonPath)) {
+        throw new Error(`Native addon not found at ${addonPath}`);
+      }
+      this.module = createRequire(import.meta.url)(addonPath);
+      this.initialized = true;
+      this.backend = 'native';
+      console.log('✅ Native Battle Engine loaded successfully');
+      return true;
+    } catch (error) {
+      if (required) {
+        console.error('❌ Failed to load native engine:', error);
+        throw error;
+      }
+      return false;
+    }
+  }
+
   // Convert JavaScript unit to WASM Unit structure
   createUnit(jsUnit) {
     if (!this.initialized || !this.module) {
@@ -105,6 +153,74 @@ class WASMEngine {
     return wasmUnit;
   }
 
+  // Pack JavaScript units into fixed-width int32 records plus a string
+  // table (layout: engine/include/PackedInput.h)
+  packUnits(jsUnits) {
+    const UNIT_WORDS = 11;
+    const records = new Int32Array(jsUnits.length * UNIT_WORDS);
+    const names = [];
+    const nameIndex = new Map();
+    const intern = (name) => {
+      let index = nameIndex.get(name);
+      if (index === undefined) {
+        index = names.length;
+        names.push(name);
+        nameIndex.set(name, index);
+      }
+      return index;
+    };
+
+    jsUnits.forEach((unit, i) => {
+      const hp = unit.hp || 100;
+      records.set([
+        intern(String(unit.id)),
+        intern(unit.team || 'A'),
+        intern(unit.type || 'soldier'),
+        Math.floor(unit.x),
+        Math.floor(unit.y),
+        hp,
+        hp,
+        unit.attack || 10,
+        unit.defense || 5,
+        unit.speed || 1,
+        unit.range || 1
+      ], i * UNIT_WORDS);
+    });
+
+    return { records, names };
+  }
+
+  // Pack a terrain grid of { type, moveCost } cells (or type strings) into
+  // one byte per cell plus a palette of distinct cells
+  packTerrain(terrain) {
+    const height = terrain.length;
+    const width = height > 0 ? terrain[0].length : 0;
+    const cells = new Uint8Array(width * height);
+    const palette = [];
+    const paletteIndex = new Map();
+
+    for (let y = 0; y < height; y++) {
+      for (let x = 0; x < width; x++) {
+        const cell = terrain[y][x];
+        const type = typeof cell === 'string' ? cell : (cell?.type || 'ground');
+        const moveCost = typeof cell === 'object' && cell?.moveCost != null ? cell.moveCost : 1.0;
+        const key = `${type}:${moveCost}`;
+        let index = paletteIndex.get(key);
+        if (index === undefined) {
+          if (palette.length === 256) {
+            throw new Error('Terrain has more than 256 distinct cells');
+          }
+          index = palette.length;
+          palette.push({ type, moveCost });
+          paletteIndex.set(key, index);
+        }
+        cells[y * width + x] = index;
+      }
+    }
+
+    return { cells, width, height, palette };
+  }
+
   // Run simulation
   async runSimulation(config) {
     if (!this.initialized) {
@@ -118,22 +234,25 @@ class WASMEngine {
     const gridHeight = terrain.length;
     const engine = new this.module.BattleEngine(gridWidth, gridHeight, maxTicks);
 
-    // Add units
-    for (const unit of units) {
-      try {
-        const wasmUnit = this.createUnit(unit);
-        engine.addUnit(wasmUnit);
-      } catch (error) {
-        console.error('Error adding unit:', error);
-      }
+    const packedTerrain = this.packTerrain(terrain);
+    engine.setTerrainPacked(packedTerrain.cells, packedTerrain.width, packedTerrain.height, packedTerrain.palette);
+
+    // Add units in one packed call
+    const packed = this.packUnits(units);
+    if (!engine.addUnitsPacked(packed.records, packed.names)) {
+      throw new Error('Invalid unit data');
     }
 
     // Initialize battle
     engine.initialize();
 
-    // Run simulation
+    // Run simulation (natively off the event loop)
     const startTime = Date.now();
-    engine.run();
+    if (this.backend === 'native') {
+      await engine.runAsync();
+    } else {
+      engine.run();
+    }
     const duration = Date.now() - startTime;
 
     // Get results
@@ -142,10 +261,7 @@ class WASMEngine {
 
     // Convert WASM units back to JavaScript objects
     const finalUnits = [];
-    const unitsVector = finalState.units;
-    
-    for (let i = 0; i < unitsVector.size(); i++) {
-      const unit = unitsVector.get(i);
+    for (const unit of toArray(finalState.units)) {
       finalUnits.push({
         id: unit.id,
         team: unit.team,
@@ -163,11 +279,7 @@ class WASMEngine {
     }
 
     // Convert logs
-    const logs = [];
-    const logsVector = stats.logs;
-    for (let i = 0; i < logsVector.size(); i++) {
-      logs.push(logsVector.get(i));
-    }
+    const logs = toArray(stats.logs);
 
     return {
       winner: stats.winner,
@@ -178,7 +290,53 @@ class WASMEngine {
       units: finalUnits,
       logs: logs,
       duration: duration,
-      engine: 'wasm'
+      engine: this.backend
+    };
+  }
+
+  // Live typed-array views over an engine's unit columns (no per-unit
+  // marshalling). Layout is described in engine/include/StateBuffer.h.
+  // Pass the previous view back in to reuse it while the columns haven't moved.
+  getStateView(engine, previous = null) {
+    if (this.backend === 'native') {
+      throw new Error('State views need the WASM heap; use getState() with the native engine');
+    }
+    const STATE_MAGIC = 0x42545342;
+    const STATE_VERSION = 1;
+
+    const heap32 = this.module.HEAP32;
+    const header = engine.getStateBuffer() >> 2;
+    if (heap32[header] !== STATE_MAGIC || heap32[header + 1] !== STATE_VERSION) {
+      throw new Error('Unsupported WASM state buffer layout');
+    }
+
+    const generation = heap32[header + 2];
+    const tick = heap32[header + 3];
+    const status = heap32[header + 4];
+    const count = heap32[header + 5];
+
+    // Views detach when memory grows, and columns move when units are added
+    if (previous && previous.generation === generation &&
+        previous.buffer === heap32.buffer && previous.count === count) {
+      previous.tick = tick;
+      previous.status = status;
+      return previous;
+    }
+
+    const buffer = heap32.buffer;
+    const int32Column = (word) => new Int32Array(buffer, heap32[header + word], count);
+    return {
+      buffer,
+      generation,
+      tick,
+      status,
+      count,
+      x: int32Column(6),
+      y: int32Column(7),
+      health: int32Column(8),
+      cooldown: int32Column(9),
+      team: int32Column(10),
+      alive: new Uint8Array(buffer, heap32[header + 11], count)
     };
   }
 
@@ -188,6 +346,7 @@ class WASMEngine {
       // WASM cleanup if needed
       this.module = null;
       this.initialized = false;
+      this.backend = null;
     }
   }
 }
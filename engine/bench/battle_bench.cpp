@@ -0,0 +1,326 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../include/BattleEngine.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace BattleSimulator;
+
+// End-to-end BattleEngine throughput over generated scenarios. Each
+// scenario plays whole battles (capped at --ticks) until its time budget is
+// spent and prints one JSON object per line: ticks/sec, battles/sec,
+// p50/p99 tick latency and the process's peak RSS so far (scenarios run in
+// the order given, so list them smallest first).
+//
+// Scenario kinds:
+//   uniform     both armies scattered over the whole map
+//   clustered   each army in a few tight groups on its own side
+//   chokepoint  armies on either side of a wall with three narrow gaps
+//
+// Usage: battle_bench [--quick] [--seconds S] [--ticks N] [--mode sequential|twophase]
+//                     [--threads T] [--ai policy|strategy|callback] [--seed N] [--perf]
+//                     [kind:units:size ...]
+//        (default: a sweep from 10 units on 20x20 to 100k units on 2048x2048)
+//        --perf adds the engine's per-phase times and counters (getPerfCounters)
+
+namespace {
+
+struct ScenarioSpec {
+    std::string kind;
+    int units;
+    int size;
+};
+
+struct Scenario {
+    ScenarioSpec spec;
+    std::vector<Unit> units;
+    TerrainGrid terrain;
+};
+
+struct Options {
+    double seconds = 3.0;
+    int ticks = 300;
+    TickMode mode = TickMode::TwoPhase;
+    int threads = 1;
+    std::string ai = "policy";
+    unsigned seed = 42;
+    bool perf = false;
+};
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Peak resident set size in KB, or -1 where unavailable
+long peakRssKb() {
+#if defined(__APPLE__)
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss / 1024 : -1;
+#elif defined(__unix__)
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : -1;
+#else
+    return -1;
+#endif
+}
+
+Scenario makeScenario(const ScenarioSpec& spec, unsigned seed) {
+    Scenario scenario;
+    scenario.spec = spec;
+    const int size = spec.size;
+    std::mt19937 rng(seed);
+    std::vector<std::uint8_t> cells(static_cast<size_t>(size) * size, 0);
+    const int wall = size / 2;
+
+    if (spec.kind == "chokepoint") {
+        // Palette 0 is ground, 1 a wall down the middle with three gaps
+        const int gap = std::max(1, size / 30);
+        for (int y = 0; y < size; y++) {
+            const bool open = std::abs(y - size / 6) < gap || std::abs(y - size / 2) < gap ||
+                              std::abs(y - size * 5 / 6) < gap;
+            if (!open) cells[static_cast<size_t>(y) * size + wall] = 1;
+        }
+        TerrainGrid::fromPacked(cells.data(), size, size,
+                                {TerrainCell(), TerrainCell("wall", 0.0)}, scenario.terrain);
+    } else {
+        scenario.terrain = TerrainGrid(size, size);
+    }
+
+    // At most half the cells outside the wall
+    const int count = std::min(spec.units, size * (size - 1) / 2);
+    std::vector<std::uint8_t> taken(cells);
+    std::uniform_int_distribution<int> any(0, size - 1);
+    std::normal_distribution<double> spread(0.0, std::max(1.0, std::sqrt(count / 8.0)));
+    std::vector<Position> centres;
+    for (int team = 0; team < 2; team++) {
+        for (int c = 0; c < 4; c++) {
+            const int x = std::uniform_int_distribution<int>(0, std::max(0, size / 3 - 1))(rng);
+            centres.push_back(Position(team == 0 ? x : size - 1 - x, any(rng)));
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        const int team = i % 2;
+        Position position;
+        for (int attempt = 0;; attempt++) {
+            if (spec.kind == "clustered" && attempt < 32) {
+                const Position& centre = centres[team * 4 + (i / 2) % 4];
+                position = Position(centre.x + static_cast<int>(std::lround(spread(rng))),
+                                    centre.y + static_cast<int>(std::lround(spread(rng))));
+            } else if (spec.kind == "chokepoint" || spec.kind == "clustered") {
+                // Own side of the map
+                const int x = std::uniform_int_distribution<int>(0, std::max(0, wall - 1))(rng);
+                position = Position(team == 0 ? x : size - 1 - x, any(rng));
+            } else {
+                position = Position(any(rng), any(rng));
+            }
+            if (position.x < 0 || position.y < 0 || position.x >= size || position.y >= size) continue;
+            std::uint8_t& cell = taken[static_cast<size_t>(position.y) * size + position.x];
+            if (!cell) {
+                cell = 1;
+                break;
+            }
+        }
+        Unit unit("u" + std::to_string(i), team == 0 ? "teamA" : "teamB", i % 3 == 0 ? "archer" : "soldier");
+        unit.position = position;
+        unit.range = i % 3 == 0 ? 4 : 1;
+        unit.speed = i % 3 == 0 ? 1 : 2;
+        scenario.units.push_back(unit);
+    }
+    return scenario;
+}
+
+// The deployed default AI: attack the closest enemy in range, else close in
+Action attackClosest(const Unit& self, const BattleState& state) {
+    Action action;
+    const Unit* nearest = nullptr;
+    double best = 0.0;
+    for (const Unit& other : state.units) {
+        if (!other.isAlive() || other.team == self.team) continue;
+        const double distance = self.position.distanceTo(other.position);
+        if (!nearest || distance < best) {
+            nearest = &other;
+            best = distance;
+        }
+    }
+    if (!nearest) return action;
+    if (best <= self.range) {
+        action.type = Action::ATTACK;
+        action.targetUnitId = nearest->id;
+    } else {
+        action.type = Action::MOVE;
+        action.targetPosition = nearest->position;
+    }
+    return action;
+}
+
+void configureAi(BattleEngine& engine, const std::string& ai) {
+    if (ai == "callback") {
+        engine.setAICallback("teamA", attackClosest);
+        engine.setAICallback("teamB", attackClosest);
+    } else if (ai == "strategy") {
+        const char* source =
+            "if health < maxHealth * 0.3 and enemies(3) > allies(3) then retreat\n"
+            "if enemyDistance <= range then attack weakest\n"
+            "move enemy";
+        engine.setTeamStrategy("teamA", source);
+        engine.setTeamStrategy("teamB", source);
+    } else {
+        engine.setTeamPolicy("teamA", TeamPolicy::FocusFire);
+        engine.setTeamPolicy("teamB", TeamPolicy::Kite);
+    }
+}
+
+double percentile(std::vector<double>& values, double p) {
+    if (values.empty()) return 0.0;
+    const size_t k = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+std::string run(const Scenario& scenario, const Options& options) {
+    std::vector<double> tickMs;
+    PerfCounters perf;
+    int battles = 0;
+    long ticks = 0;
+    double runMs = 0.0;
+    const double budgetMs = options.seconds * 1000.0;
+
+    while (runMs < budgetMs) {
+        BattleEngine engine(scenario.spec.size, scenario.spec.size, options.ticks);
+        engine.setTerrainGrid(scenario.terrain);
+        for (const Unit& unit : scenario.units) {
+            engine.addUnit(unit);
+        }
+        engine.setTickMode(options.mode);
+        engine.setDecisionThreads(options.threads);
+        configureAi(engine, options.ai);
+        engine.setPerfCounters(options.perf);
+        engine.initialize();
+
+        while (!engine.isFinished() && runMs < budgetMs) {
+            const auto start = std::chrono::steady_clock::now();
+            engine.tick();
+            const double ms = elapsedMs(start);
+            tickMs.push_back(ms);
+            runMs += ms;
+            ticks++;
+        }
+        if (engine.isFinished()) battles++;
+        const PerfCounters totals = engine.getPerfCounters();
+        perf.indexMs += totals.indexMs;
+        perf.winCheckMs += totals.winCheckMs;
+        perf.decideMs += totals.decideMs;
+        perf.moveMs += totals.moveMs;
+        perf.attackMs += totals.attackMs;
+        perf.cooldownsMs += totals.cooldownsMs;
+        perf.loggingMs += totals.loggingMs;
+        perf.unitsScanned += totals.unitsScanned;
+        perf.collisionChecks += totals.collisionChecks;
+        perf.callbackInvocations += totals.callbackInvocations;
+    }
+
+    const double seconds = runMs / 1000.0;
+    std::ostringstream json;
+    json << "{\"scenario\":\"" << scenario.spec.kind << "\""
+         << ",\"units\":" << scenario.units.size()
+         << ",\"width\":" << scenario.spec.size << ",\"height\":" << scenario.spec.size
+         << ",\"mode\":\"" << (options.mode == TickMode::TwoPhase ? "twophase" : "sequential") << "\""
+         << ",\"threads\":" << options.threads
+         << ",\"ai\":\"" << options.ai << "\""
+         << ",\"ticks\":" << ticks
+         << ",\"battles\":" << battles
+         << ",\"seconds\":" << seconds
+         << ",\"ticksPerSec\":" << (seconds > 0.0 ? ticks / seconds : 0.0)
+         << ",\"battlesPerSec\":" << (seconds > 0.0 ? battles / seconds : 0.0)
+         << ",\"p50TickMs\":" << percentile(tickMs, 0.50)
+         << ",\"p99TickMs\":" << percentile(tickMs, 0.99)
+         << ",\"peakRssKb\":" << peakRssKb();
+    if (options.perf) {
+        json << ",\"perf\":{\"indexMs\":" << perf.indexMs << ",\"winCheckMs\":" << perf.winCheckMs
+             << ",\"decideMs\":" << perf.decideMs << ",\"moveMs\":" << perf.moveMs
+             << ",\"attackMs\":" << perf.attackMs << ",\"cooldownsMs\":" << perf.cooldownsMs
+             << ",\"loggingMs\":" << perf.loggingMs << ",\"unitsScanned\":" << perf.unitsScanned
+             << ",\"collisionChecks\":" << perf.collisionChecks
+             << ",\"callbackInvocations\":" << perf.callbackInvocations << "}";
+    }
+    json << "}";
+    return json.str();
+}
+
+bool parseSpec(const std::string& text, ScenarioSpec& spec) {
+    const size_t first = text.find(':');
+    const size_t second = text.find(':', first == std::string::npos ? first : first + 1);
+    if (first == std::string::npos || second == std::string::npos) return false;
+    spec.kind = text.substr(0, first);
+    spec.units = std::atoi(text.substr(first + 1, second - first - 1).c_str());
+    spec.size = std::atoi(text.substr(second + 1).c_str());
+    return (spec.kind == "uniform" || spec.kind == "clustered" || spec.kind == "chokepoint") &&
+           spec.units > 0 && spec.size >= 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    std::vector<ScenarioSpec> specs;
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--perf") {
+            options.perf = true;
+        } else if (arg == "--seconds" && hasValue) {
+            options.seconds = std::atof(argv[++i]);
+        } else if (arg == "--ticks" && hasValue) {
+            options.ticks = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--ai" && hasValue) {
+            options.ai = argv[++i];
+        } else if (arg == "--mode" && hasValue) {
+            options.mode = std::string(argv[++i]) == "sequential" ? TickMode::Sequential : TickMode::TwoPhase;
+        } else {
+            ScenarioSpec spec;
+            if (!parseSpec(arg, spec)) {
+                std::cerr << "bad argument '" << arg << "' (scenarios are kind:units:size, "
+                          << "kind uniform, clustered or chokepoint)\n";
+                return 2;
+            }
+            specs.push_back(spec);
+        }
+    }
+    if (specs.empty()) {
+        specs = {
+            {"uniform", 10, 20}, {"clustered", 100, 64}, {"chokepoint", 100, 64},
+            {"uniform", 1000, 128}, {"clustered", 1000, 128}, {"chokepoint", 1000, 128},
+            {"uniform", 10000, 512}, {"clustered", 10000, 512}, {"chokepoint", 10000, 512}
+        };
+        if (!quick) {
+            specs.push_back({"clustered", 100000, 2048});
+            specs.push_back({"uniform", 100000, 2048});
+        }
+    }
+    if (quick) {
+        options.seconds = std::min(options.seconds, 0.5);
+    }
+
+    for (const ScenarioSpec& spec : specs) {
+        const Scenario scenario = makeScenario(spec, options.seed);
+        std::cout << run(scenario, options) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <vector>
+#include "../include/BattleEngine.h"
+#include "../include/MctsController.h"
+
+using namespace BattleSimulator;
+
+// Decision quality of the MCTS team controller against the attack-closest
+// baseline, on mirrored random skirmishes. Each scenario is played with the
+// controller on each side, so map/slot bias cancels out.
+//
+// Usage: mcts_bench [scenarios] [iterations] [threads]   (default: 20 200 1)
+
+namespace {
+
+struct Scenario {
+    int width;
+    int height;
+    std::vector<Unit> units;
+};
+
+// Mixed armies: melee bruisers and fragile ranged units, mirrored per side
+Scenario makeScenario(unsigned seed) {
+    Scenario scenario;
+    scenario.width = 24;
+    scenario.height = 16;
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> yDist(0, scenario.height - 1);
+    std::uniform_int_distribution<int> xDist(0, 4);
+    std::uniform_int_distribution<int> kind(0, 2);
+
+    for (int i = 0; i < 8; i++) {
+        int k = kind(rng);
+        int x = xDist(rng);
+        int y = yDist(rng);
+        for (int side = 0; side < 2; side++) {
+            Unit unit("u" + std::to_string(i * 2 + side), side == 0 ? "teamA" : "teamB",
+                      k == 0 ? "knight" : k == 1 ? "archer" : "soldier");
+            unit.position = Position(side == 0 ? x : scenario.width - 1 - x, y);
+            unit.range = k == 1 ? 4 : 1;
+            unit.attack = k == 0 ? 25 : k == 1 ? 14 : 18;
+            unit.health = unit.maxHealth = k == 0 ? 160 : k == 1 ? 70 : 100;
+            unit.defense = k == 0 ? 10 : 4;
+            scenario.units.push_back(unit);
+        }
+    }
+    return scenario;
+}
+
+struct Outcome {
+    std::string winner;
+    int decisions;
+    double planningMs;
+};
+
+Outcome play(const Scenario& scenario, const std::string& mctsTeam, const MctsConfig& config) {
+    BattleEngine engine(scenario.width, scenario.height, 400);
+    engine.setEventCapture(false);
+    for (const auto& unit : scenario.units) {
+        engine.addUnit(unit);
+    }
+    engine.setAICallback("teamA", attackClosestPolicy);
+    engine.setAICallback("teamB", attackClosestPolicy);
+
+    std::shared_ptr<MctsController> controller;
+    if (!mctsTeam.empty()) {
+        controller = MctsController::attach(engine, mctsTeam, config);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    engine.run();
+    double elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    Outcome outcome;
+    outcome.winner = engine.getWinner();
+    outcome.decisions = controller ? controller->decisions() : 0;
+    outcome.planningMs = outcome.decisions > 0 ? elapsed / outcome.decisions : 0.0;
+    return outcome;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int scenarios = argc > 1 ? std::atoi(argv[1]) : 20;
+    MctsConfig config;
+    config.iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+    config.threads = argc > 3 ? std::atoi(argv[3]) : 1;
+
+    int baselineA = 0, baselineB = 0, baselineDraws = 0;
+    int wins = 0, losses = 0, draws = 0, decisions = 0;
+    double planningMs = 0.0;
+
+    for (int s = 0; s < scenarios; s++) {
+        Scenario scenario = makeScenario(1000 + s);
+
+        std::string baseline = play(scenario, "", config).winner;
+        baselineA += baseline == "teamA";
+        baselineB += baseline == "teamB";
+        baselineDraws += baseline == "draw";
+
+        for (const char* side : {"teamA", "teamB"}) {
+            Outcome outcome = play(scenario, side, config);
+            wins += outcome.winner == side;
+            draws += outcome.winner == "draw";
+            losses += outcome.winner != side && outcome.winner != "draw";
+            decisions += outcome.decisions;
+            planningMs += outcome.planningMs * outcome.decisions;
+        }
+    }
+
+    const int games = scenarios * 2;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "scenarios: " << scenarios << ", iterations/decision: " << config.iterations
+              << ", threads: " << config.threads << "\n";
+    std::cout << "baseline vs baseline: teamA " << baselineA << ", teamB " << baselineB
+              << ", draws " << baselineDraws << "\n";
+    std::cout << "mcts vs baseline:     won " << wins << "/" << games
+              << " (" << 100.0 * wins / games << "%), lost " << losses
+              << ", drew " << draws << "\n";
+    std::cout << "time per decision:    "
+              << std::setprecision(2) << (decisions > 0 ? planningMs / decisions : 0.0) << " ms\n";
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+#include "../include/Pathfinder.h"
+
+using namespace BattleSimulator;
+
+// HPA* path queries against plain grid A* on a large random map.
+// `units` units per tick each ask for a path to one of a few targets (as
+// units chasing enemies would); the first tick runs with cold caches.
+//
+// Usage: path_bench [size] [units] [clusterSize]   (default: 512 500 16)
+
+namespace {
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Ground with patches of forest, swamp, roads and wall segments
+std::shared_ptr<CostGrid> makeMap(int size, std::mt19937& rng) {
+    auto grid = std::make_shared<CostGrid>();
+    grid->width = size;
+    grid->height = size;
+    grid->cost.assign(size * size, 1.0f);
+    std::uniform_int_distribution<int> pos(0, size - 1);
+    const float patchCosts[] = {2.0f, 4.0f, 0.5f};
+    for (int i = 0; i < size * size / 400; i++) {
+        const int x = pos(rng), y = pos(rng), r = 2 + rng() % 8;
+        const float cost = patchCosts[rng() % 3];
+        for (int dy = -r; dy <= r; dy++) {
+            for (int dx = -r; dx <= r; dx++) {
+                if (x + dx >= 0 && y + dy >= 0 && x + dx < size && y + dy < size) {
+                    grid->cost[(y + dy) * size + x + dx] = cost;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < size * size / 300; i++) {
+        const int x = pos(rng), y = pos(rng), length = 5 + rng() % 30;
+        const bool vertical = rng() % 2;
+        for (int k = 0; k < length; k++) {
+            const int cx = vertical ? x : x + k;
+            const int cy = vertical ? y + k : y;
+            if (cx < size && cy < size) grid->cost[cy * size + cx] = 0.0f;
+        }
+    }
+    return grid;
+}
+
+// Reference: A* over the whole grid; returns the path cost or -1
+float gridAStar(const CostGrid& grid, int from, int to) {
+    const int width = grid.width;
+    std::vector<float> g(grid.cost.size(), CostGrid::kInfinity);
+    std::vector<std::pair<float, int>> open;
+    auto order = std::greater<std::pair<float, int>>();
+    auto h = [&](int cell) {
+        return 0.5f * (std::abs(cell % width - to % width) + std::abs(cell / width - to / width));
+    };
+    g[from] = 0.0f;
+    open.emplace_back(h(from), from);
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), order);
+        const int cell = open.back().second;
+        const float f = open.back().first;
+        open.pop_back();
+        if (f - h(cell) > g[cell]) continue;
+        if (cell == to) return g[cell];
+        const int x = cell % width;
+        const int neighbours[4] = {cell - width, x > 0 ? cell - 1 : -1,
+                                   x + 1 < width ? cell + 1 : -1, cell + width};
+        for (int n : neighbours) {
+            if (n < 0 || n >= static_cast<int>(grid.cost.size())) continue;
+            if (n != to && !grid.passable(n)) continue;
+            const float next = g[cell] + (grid.passable(n) ? grid.cost[n] : 1.0f);
+            if (next < g[n]) {
+                g[n] = next;
+                open.emplace_back(next + h(n), n);
+                std::push_heap(open.begin(), open.end(), order);
+            }
+        }
+    }
+    return -1.0f;
+}
+
+float pathCost(const CostGrid& grid, const std::vector<int>& path) {
+    float cost = 0.0f;
+    for (int cell : path) cost += grid.passable(cell) ? grid.cost[cell] : 1.0f;
+    return cost;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int size = argc > 1 ? std::atoi(argv[1]) : 512;
+    const int units = argc > 2 ? std::atoi(argv[2]) : 500;
+    const int clusterSize = argc > 3 ? std::atoi(argv[3]) : 16;
+
+    std::mt19937 rng(42);
+    auto grid = makeMap(size, rng);
+
+    auto start = std::chrono::steady_clock::now();
+    Pathfinder pathfinder(grid, clusterSize);
+    const double buildMs = elapsedMs(start);
+
+    // Units spread over the map, chasing one of 8 targets
+    std::uniform_int_distribution<int> cell(0, size * size - 1);
+    std::vector<int> from(units), targets(8);
+    for (int& t : targets) t = cell(rng);
+    for (int& f : from) {
+        do { f = cell(rng); } while (!grid->passable(f));
+    }
+
+    std::vector<int> path;
+    auto tick = [&]() {
+        int found = 0;
+        for (int i = 0; i < units; i++) {
+            found += pathfinder.findPath(from[i], targets[i % targets.size()], path);
+        }
+        return found;
+    };
+    start = std::chrono::steady_clock::now();
+    const int found = tick();
+    const double coldMs = elapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    tick();
+    const double warmMs = elapsedMs(start);
+
+    // Quality and speed against grid A* on a sample
+    const int sample = std::min(units, 50);
+    double ratioSum = 0.0, worst = 1.0, referenceMs = 0.0;
+    int compared = 0;
+    for (int i = 0; i < sample; i++) {
+        const int to = targets[i % targets.size()];
+        start = std::chrono::steady_clock::now();
+        const float best = gridAStar(*grid, from[i], to);
+        referenceMs += elapsedMs(start);
+        if (best > 0.0f && pathfinder.findPath(from[i], to, path)) {
+            const double ratio = pathCost(*grid, path) / best;
+            ratioSum += ratio;
+            worst = std::max(worst, ratio);
+            compared++;
+        }
+    }
+
+    // Incremental update: drop a wall into one spot
+    auto changed = std::make_shared<CostGrid>(*grid);
+    for (int k = 0; k < 20; k++) changed->cost[(size / 2) * size + size / 2 + k] = 0.0f;
+    start = std::chrono::steady_clock::now();
+    const int rebuilt = pathfinder.update(changed);
+    const double updateMs = elapsedMs(start);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "map " << size << "x" << size << ", cluster " << clusterSize << ": "
+              << pathfinder.clusterCount() << " clusters, " << pathfinder.nodeCount()
+              << " nodes, built in " << buildMs << " ms\n";
+    std::cout << units << " queries: cold " << coldMs << " ms, warm " << warmMs << " ms ("
+              << 1000.0 * warmMs / units << " us/query), " << found << " found\n";
+    std::cout << "grid A*: " << referenceMs / sample << " ms/query; HPA* cost ratio avg "
+              << std::setprecision(3) << (compared ? ratioSum / compared : 0.0)
+              << ", worst " << worst << "\n";
+    std::cout << std::setprecision(2) << "update after a local change: " << rebuilt
+              << " clusters rebuilt in " << updateMs << " ms\n";
+    std::cout << "shared routes: " << pathfinder.routeHits() << ", exact searches: "
+              << pathfinder.exactSearches() << "\n";
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "../include/BattleEngine.h"
+
+using namespace BattleSimulator;
+
+// Ticks/sec of BattleEngine with the spatial grid vs. the linear scans.
+//
+// Usage: spatial_bench [unitCount...]   (default: 1000 10000 50000)
+
+namespace {
+
+struct Scenario {
+    int width;
+    int height;
+    std::vector<Unit> units;
+};
+
+Scenario makeScenario(int unitCount, unsigned seed) {
+    Scenario scenario;
+    int side = static_cast<int>(std::sqrt(unitCount * 8.0));
+    scenario.width = side;
+    scenario.height = side;
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> yDist(0, side - 1);
+    std::uniform_int_distribution<int> xDist(0, side / 3);
+
+    for (int i = 0; i < unitCount; i++) {
+        bool teamA = (i % 2) == 0;
+        Unit unit("u" + std::to_string(i), teamA ? "teamA" : "teamB", "soldier");
+        int x = xDist(rng);
+        unit.position = Position(teamA ? x : side - 1 - x, yDist(rng));
+        unit.range = 3;
+        scenario.units.push_back(unit);
+    }
+    return scenario;
+}
+
+// Mostly attack-closest, with a share of units advancing each tick so the
+// index also sees moves and collision checks
+Action benchPolicy(const Unit& self, const BattleState& state) {
+    Action action;
+    if ((self.position.x + self.position.y + state.tick) % 3 == 0) {
+        action.type = Action::MOVE;
+        action.direction = "forward";
+    } else {
+        action.type = Action::ATTACK;
+    }
+    return action;
+}
+
+double measureTicksPerSecond(const Scenario& scenario, bool useGrid,
+                             int maxTicks, double budgetSeconds, int& ticksRun) {
+    BattleEngine engine(scenario.width, scenario.height, maxTicks + 1);
+    engine.setSpatialIndexEnabled(useGrid);
+    for (const auto& unit : scenario.units) {
+        engine.addUnit(unit);
+    }
+    engine.setAICallback("teamA", benchPolicy);
+    engine.setAICallback("teamB", benchPolicy);
+    engine.initialize();
+
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    ticksRun = 0;
+    while (ticksRun < maxTicks && !engine.isFinished()) {
+        engine.tick();
+        ticksRun++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= budgetSeconds) break;
+    }
+    return elapsed > 0.0 ? ticksRun / elapsed : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<int> counts;
+    for (int i = 1; i < argc; i++) {
+        counts.push_back(std::atoi(argv[i]));
+    }
+    if (counts.empty()) {
+        counts = {1000, 10000, 50000};
+    }
+
+    std::cout << std::left << std::setw(10) << "units"
+              << std::setw(12) << "map"
+              << std::setw(18) << "scan ticks/s"
+              << std::setw(18) << "grid ticks/s"
+              << "speedup\n";
+
+    for (int count : counts) {
+        Scenario scenario = makeScenario(count, 42);
+
+        int scanTicks = 0, gridTicks = 0;
+        double scan = measureTicksPerSecond(scenario, false, 50, 5.0, scanTicks);
+        double grid = measureTicksPerSecond(scenario, true, 50, 5.0, gridTicks);
+
+        std::cout << std::left << std::setw(10) << count
+                  << std::setw(12) << (std::to_string(scenario.width) + "x" + std::to_string(scenario.height))
+                  << std::setw(18) << std::fixed << std::setprecision(2) << scan
+                  << std::setw(18) << grid
+                  << std::setprecision(1) << (scan > 0.0 ? grid / scan : 0.0) << "x"
+                  << "  (" << scanTicks << "/" << gridTicks << " ticks)\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef BATTLE_BATCH_RUNNER_H
+#define BATTLE_BATCH_RUNNER_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <functional>
+#include <cstdint>
+#include "BattleEngine.h"
+#include "ThreadPool.h"
+
+namespace BattleSimulator {
+
+// Builds a team's AI callback for one battle. The seed is derived from the
+// battle seed and the team name, so stochastic policies are reproducible.
+// Callbacks created here are only ever used by a single battle/thread.
+using AIPolicyFactory = std::function<AIDecisionCallback(std::uint64_t seed)>;
+
+// One independent battle in a batch
+struct BattleConfig {
+    int width;
+    int height;
+    int maxTicks;
+    std::uint64_t seed;
+    std::vector<Unit> units;
+    std::vector<std::vector<TerrainCell>> terrain;   // empty = terrainGrid
+    TerrainGrid terrainGrid;                         // empty = all ground; cells shared, not copied
+    std::map<std::string, AIPolicyFactory> policies; // keyed by team
+    
+    BattleConfig() : width(20), height(20), maxTicks(1000), seed(0) {}
+};
+
+// Aggregate outcome of a batch
+struct BatchSummary {
+    int battles;
+    int teamAWins;
+    int teamBWins;
+    int draws;
+    double teamAWinRate;
+    double teamBWinRate;
+    double drawRate;
+    double averageTicks;
+    
+    BatchSummary()
+        : battles(0), teamAWins(0), teamBWins(0), draws(0),
+          teamAWinRate(0.0), teamBWinRate(0.0), drawRate(0.0), averageTicks(0.0) {}
+};
+
+struct BatchResult {
+    std::vector<BattleEngine::BattleStats> battles;   // same order as the configs
+    BatchSummary summary;
+    double elapsedSeconds;
+};
+
+// Runs many independent battles (Monte-Carlo matchups, strategy sweeps) on
+// a work-stealing thread pool. Each battle gets its own BattleEngine, so
+// results don't depend on the thread count or scheduling order.
+class BattleBatchRunner {
+public:
+    // threads < 0 uses every hardware thread
+    explicit BattleBatchRunner(int threads = -1);
+    
+    BatchResult run(const std::vector<BattleConfig>& configs);
+    
+    // Event capture is off for batch battles (so stats carry no logs) unless enabled
+    void setKeepLogs(bool keep) { keepLogs_ = keep; }
+    int threadCount() const { return pool_.concurrency(); }
+    
+    // Run a single config on the calling thread
+    static BattleEngine::BattleStats runOne(const BattleConfig& config, bool keepLogs);
+    
+    // Per-team policy seed for a battle seed
+    static std::uint64_t teamSeed(std::uint64_t battleSeed, const std::string& team);
+    
+private:
+    ThreadPool pool_;
+    bool keepLogs_;
+};
+
+} // namespace BattleSimulator
+
+#endif // BATTLE_BATCH_RUNNER_H
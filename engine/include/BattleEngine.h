@@ -5,15 +5,27 @@
 #include <string>
 #include <memory>
 #include <functional>
-#include <map>
+#include <cstdint>
+#include "SpatialGrid.h"
+#include "TerrainGrid.h"
+#include "FlowField.h"
+#include "Pathfinder.h"
+#include "Strategy.h"
+#include "UnitStore.h"
+#include "ThreadPool.h"
+#include "EventLog.h"
+#include "PerfCounters.h"
+#include "Hash128.h"
+#include "StateBuffer.h"
+#include "PackedInput.h"
 
 namespace BattleSimulator {
 
 // Forward declarations
 struct Position;
 struct Unit;
-struct TerrainCell;
 class BattleEngine;
+class ReplayRecorder;
 
 // Position structure
 struct Position {
@@ -53,13 +65,21 @@ struct Unit {
     void heal(int amount);
 };
 
-// Terrain cell
-struct TerrainCell {
-    std::string type;
-    double moveCost;
+// Read-only terrain grid that copies share instead of duplicating;
+// assigning a new grid replaces it for this copy only
+class SharedTerrain {
+public:
+    SharedTerrain() : grid_(std::make_shared<const TerrainGrid>()) {}
+    SharedTerrain(TerrainGrid grid) : grid_(std::make_shared<const TerrainGrid>(std::move(grid))) {}
+    
+    const TerrainGrid& grid() const { return *grid_; }
+    const TerrainGrid* operator->() const { return grid_.get(); }
+    size_t size() const { return grid_->size(); }
+    bool empty() const { return grid_->empty(); }
+    TerrainGrid::Row operator[](size_t row) const { return (*grid_)[row]; }
     
-    TerrainCell() : type("ground"), moveCost(1.0) {}
-    TerrainCell(const std::string& t, double cost) : type(t), moveCost(cost) {}
+private:
+    std::shared_ptr<const TerrainGrid> grid_;
 };
 
 // Action structure
@@ -67,65 +87,440 @@ struct Action {
     enum Type {
         IDLE,
         MOVE,
-        ATTACK
+        ATTACK,
+        // Restore half the unit's attack (at least 1) to itself, or to the
+        // ally named by targetUnitId if it is in range; cools down like ATTACK
+        HEAL
     };
     
     Type type;
     Position targetPosition;
     std::string targetUnitId;
+    // "up", "down", "left", "right", "forward", or "advance": step along the
+    // team's flow field towards the nearest enemy, around units and terrain
     std::string direction;
     
-    Action() : type(IDLE) {}
+    // targetPosition defaults to (-1, -1) meaning "no target position". A MOVE
+    // with a target position, or with only targetUnitId set, follows a path
+    // around walls and expensive terrain (see Pathfinder.h)
+    Action() : type(IDLE), targetPosition(-1, -1) {}
+};
+
+// Battle lifecycle
+enum class BattleStatus {
+    Idle,
+    Initialized,
+    Running,
+    Finished
+};
+
+// "idle", "initialized", "running", "finished"
+const char* statusName(BattleStatus status);
+BattleStatus parseStatus(const std::string& name);
+
+// Built-in team behaviours that run inside the engine (see setTeamPolicy)
+enum class TeamPolicy {
+    None,
+    FocusFire,       // weakest enemy in range, else close on the weakest within engageRange
+    Kite,            // shoot from range; step back when an outranged enemy could hit next tick
+    HoldFormation,   // stay within `leash` of the starting cell, engaging what comes close
+    Flank,           // approach the nearest enemy from the side, flankOffset cells out
+    RetreatAndHeal   // fall back below retreatHealth, heal once no enemy is within engageRange
+};
+
+// "none", "focusFire", "kite", "holdFormation", "flank", "retreatAndHeal"
+const char* teamPolicyName(TeamPolicy policy);
+bool parseTeamPolicy(const std::string& name, TeamPolicy& policy);
+
+// Tuning for the policies; each uses only the fields named above
+struct PolicyParams {
+    double retreatHealth;   // fraction of maxHealth
+    double engageRange;     // cells
+    double leash;           // cells
+    double flankOffset;     // cells
+    
+    PolicyParams() : retreatHealth(0.3), engageRange(8.0), leash(3.0), flankOffset(4.0) {}
 };
 
 // Battle state
 struct BattleState {
     int tick;
     std::vector<Unit> units;
-    std::vector<std::vector<TerrainCell>> terrain;
-    std::string status;
+    SharedTerrain terrain;
+    BattleStatus status;
     std::string winner;
+    // Formatted from the engine's event log when getState() is called; not
+    // refreshed inside AI callbacks
     std::vector<std::string> logs;
     
-    BattleState() : tick(0), status("idle") {}
+    BattleState() : tick(0), status(BattleStatus::Idle) {}
+};
+
+// Changed fields of one unit in a StateDelta
+struct UnitDelta {
+    int index;                 // position in BattleState::units
+    Position position;
+    int health;
+    bool alive;
+    int cooldown;
+};
+
+// Changes since a given tick (see BattleEngine::getStateDelta)
+struct StateDelta {
+    int sinceTick;
+    int tick;
+    // When true the delta could not be computed (tick too old, in the
+    // future, or units were added since) and `snapshot` holds every unit
+    bool full;
+    BattleStatus status;
+    std::string winner;
+    std::vector<UnitDelta> units;
+    std::vector<Unit> snapshot;
+    // Log lines for events recorded after sinceTick
+    std::vector<std::string> logs;
+    
+    StateDelta() : sinceTick(0), tick(0), full(false), status(BattleStatus::Idle) {}
+};
+
+// Why advance() returned
+enum class AdvanceStop {
+    TickBudget,     // ran the requested number of ticks
+    Finished,       // battle ended (win or draw)
+    Event,          // a tick produced an event in the stop mask
+    Predicate       // advanceUntil's predicate returned true
+};
+
+const char* advanceStopName(AdvanceStop stop);
+
+// What happened during one advance()/advanceUntil() call
+struct AdvanceSummary {
+    int startTick;
+    int endTick;
+    int ticks;
+    AdvanceStop stoppedBy;
+    int moves;
+    int attacks;
+    int damage;
+    int kills;
+    
+    AdvanceSummary()
+        : startTick(0), endTick(0), ticks(0), stoppedBy(AdvanceStop::TickBudget),
+          moves(0), attacks(0), damage(0), kills(0) {}
 };
 
 // AI Decision callback type
 using AIDecisionCallback = std::function<Action(const Unit&, const BattleState&)>;
 
+// One team's ready units (alive and off cooldown), in slot order, for a
+// TeamDecisionCallback. The ready columns are gathered copies: entry i
+// describes the unit in slots[i]. `units` and `unitHealth` cover every unit
+// by slot, for scanning the rest of the battlefield. Valid only during the
+// call.
+struct TeamBatch {
+    int tick;
+    int count;
+    const int* slots;
+    const int* x;
+    const int* y;
+    const int* health;
+    const int* attack;
+    const int* range;
+    const int* speed;
+    UnitColumns units;
+    const int* unitHealth;
+};
+
+// Batched AI: called once per team per tick with its ready units; fills
+// actions[0..count), which are IDLE on entry
+using TeamDecisionCallback = std::function<void(const TeamBatch& batch, Action* actions)>;
+
+// How a tick runs the units' AI
+enum class TickMode {
+    // Each unit decides and acts in slot order; later units see the effects
+    // of earlier ones within the same tick
+    Sequential,
+    // Every ready unit decides against the same start-of-tick snapshot
+    // (optionally in parallel), then actions are resolved deterministically:
+    // all moves in slot order (a cell claimed by a lower slot blocks higher
+    // ones), then all attacks in slot order against post-move positions.
+    // Attacks are simultaneous: a unit killed this tick still fires.
+    TwoPhase
+};
+
 // Battle Engine class
 class BattleEngine {
 private:
-    BattleState state_;
+    // state_.units is a view of units_ that is refreshed lazily (see
+    // syncUnitView); everything else in state_ is authoritative
+    mutable BattleState state_;
+    UnitStore units_;
     int gridWidth_;
     int gridHeight_;
     int maxTicks_;
     
-    std::map<std::string, AIDecisionCallback> aiCallbacks_;
+    // AI callbacks indexed by team handle; shared with forks and copied
+    // before a change
+    std::shared_ptr<std::vector<AIDecisionCallback>> aiCallbacks_;
+    // Batched callbacks, shared the same way (take precedence over per-unit
+    // callbacks)
+    std::shared_ptr<std::vector<TeamDecisionCallback>> teamCallbacks_;
+    // Compiled strategies indexed by team handle (take precedence over
+    // callbacks), and the instruction budget of one decision
+    std::vector<std::shared_ptr<const Strategy>> strategies_;
+    int strategyBudget_;
+    // Built-in policies indexed by team handle (TeamPolicy::None if unset)
+    struct TeamPolicySlot {
+        TeamPolicy policy;
+        PolicyParams params;
+    };
+    std::vector<TeamPolicySlot> policies_;
+    // Caller-declared identities of deterministic callbacks, by team handle
+    // (see setCallbackKey), and the battle seed
+    std::vector<std::string> callbackKeys_;
+    std::uint64_t seed_;
+    int teamA_;
+    int teamB_;
+    
+    // Slots whose view in state_.units is out of date; a fork starts with
+    // no view at all and builds it on first use
+    mutable std::vector<int> staleUnits_;
+    mutable std::vector<std::uint8_t> staleFlags_;
+    mutable bool viewBuilt_;
+    
+    // Tick at which each slot last changed, and the earliest sinceTick a
+    // delta is available for (raised when units are added, the engine is
+    // reset or initialized)
+    std::vector<int> changedTick_;
+    int deltaBaseTick_;
+    
+    // Zero-copy state header (see StateBuffer.h)
+    mutable std::intptr_t stateHeader_[kStateHeaderWords];
+    std::intptr_t stateGeneration_;
+    
+    // Spatial index over unit slots (alive units only), one layer per team handle
+    SpatialGrid grid_;
+    bool spatialIndexEnabled_;
+    bool spatialIndexDirty_;
+    
+    // Terrain move costs (built on first use, shared with forks) and one
+    // flow field per team handle towards the closest enemies, refreshed at
+    // most once per tick
+    struct TeamFlow {
+        FlowField field;
+        int tick;
+    };
+    std::shared_ptr<const CostGrid> moveCosts_;
+    std::vector<TeamFlow> flowFields_;
+    
+    // Paths for MOVE actions aimed at a position or unit. The pathfinder is
+    // shared with forks and copied before a terrain update; a unit keeps its
+    // path while the goal stays in the same cluster and the unit is not yet
+    // in that cluster. Forks copy the paths and snapshots save them, since
+    // a kept path and a fresh one can differ.
+    struct UnitPath {
+        int goal;
+        int at;              // cell the unit is expected to be on
+        size_t next;
+        std::vector<int> cells;
+    };
+    std::shared_ptr<Pathfinder> pathfinder_;
+    std::vector<UnitPath> unitPaths_;
+    
+    // Two-phase tick state; the pool is shared between copies of an engine
+    TickMode tickMode_;
+    std::shared_ptr<ThreadPool> decisionPool_;
+    std::vector<int> readyUnits_;
+    std::vector<Action> decisions_;
+    
+    // This tick's batched decisions by slot, and per-team gather buffers
+    struct TeamBatchScratch {
+        std::vector<int> slots, x, y, health, attack, range, speed;
+        std::vector<Action> actions;
+    };
+    std::vector<Action> batchActions_;
+    std::vector<TeamBatchScratch> batchScratch_;
+    
+    // Typed events; state_.logs is formatted from them on demand
+    EventLog events_;
+    mutable bool logsDirty_;
+    
+    // Running totals since initialize(), kept whether or not events are
+    // captured, and the event types seen during the current tick
+    struct Counters {
+        int moves;
+        int attacks;
+        int damage;
+        int kills;
+    };
+    Counters counters_;
+    std::uint32_t tickEvents_;
+    
+    // Opt-in tick instrumentation (mutable: log formatting is timed too);
+    // forks start with it off
+    mutable PerfRecorder perf_;
+    
+    std::shared_ptr<ReplayRecorder> recorder_;
+    
+    struct ForkTag {};
+    BattleEngine(const BattleEngine& source, ForkTag);
     
     // Private helper methods
-    void processUnit(Unit& unit);
-    void executeAction(Unit& unit, const Action& action);
-    void handleMove(Unit& unit, const Action& action);
-    void handleAttack(Unit& unit, const Action& action);
+    const AIDecisionCallback* teamCallback(int team) const {
+        const auto& callbacks = *aiCallbacks_;
+        return team < static_cast<int>(callbacks.size()) && callbacks[team] ? &callbacks[team] : nullptr;
+    }
+    const Strategy* teamStrategy(int team) const {
+        return team < static_cast<int>(strategies_.size()) ? strategies_[team].get() : nullptr;
+    }
+    const TeamPolicySlot* teamPolicy(int team) const {
+        return team < static_cast<int>(policies_.size()) && policies_[team].policy != TeamPolicy::None
+            ? &policies_[team] : nullptr;
+    }
+    const TeamDecisionCallback* teamBatchCallback(int team) const {
+        const auto& callbacks = *teamCallbacks_;
+        return team < static_cast<int>(callbacks.size()) && callbacks[team] ? &callbacks[team] : nullptr;
+    }
+    bool hasDecisionMaker(int team) const {
+        return teamStrategy(team) || teamPolicy(team) || teamBatchCallback(team) || teamCallback(team);
+    }
+    void runTeamCallbacks();
+    Action decide(int unit);
+    Action policyAction(int unit, const TeamPolicySlot& slot);
+    const char* directionAway(int unit, int from) const;
+    int weakestEnemyWithin(int unit, int radius);
+    Action strategyAction(int unit, const Strategy& strategy);
+    double strategySense(int unit, StrategySensor sensor, double arg, int& nearest);
+    void runTick();
+    void processUnit(int unit);
+    void runTwoPhaseTick();
+    int decideReadyUnits();
+    void executeAction(int unit, const Action& action);
+    void handleMove(int unit, const Action& action);
+    void handleAttack(int unit, const Action& action);
+    void handleHeal(int unit, const Action& action);
+    void flowMove(int unit, Position& newPos);
+    void pathMove(int unit, const Position& target, Position& newPos);
+    const std::shared_ptr<const CostGrid>& moveCosts();
+    const FlowField& teamFlowField(int team);
+    const Pathfinder& pathfinder();
     
-    Unit* findUnitById(const std::string& id);
-    Unit* findClosestEnemy(const Unit& unit);
-    std::vector<Unit*> getEnemiesInRange(const Unit& unit, int range);
-    std::vector<Unit*> getAlliesInRange(const Unit& unit, int range);
+    int findUnitById(const std::string& id) const { return units_.findAlive(id); }
+    int findClosestEnemy(int unit);
+    std::vector<int> getEnemiesInRange(int unit, int range);
+    std::vector<int> getAlliesInRange(int unit, int range);
     
-    bool checkCollision(const Position& pos, const std::string& excludeUnitId);
+    bool checkCollision(const Position& pos, int excludeUnit);
     bool checkWinCondition();
-    void addLog(const std::string& message);
+    void recordEvent(EventType type, int actor, int target, int amount);
+    void recordEnd(BattleOutcome outcome);
+    std::string formatEvent(const BattleEvent& event) const;
+    void formatLogs() const;
+    
+    void markStale(int unit);
+    void syncUnitView() const;
+    void rebuildSpatialIndex();
     
 public:
     BattleEngine(int width, int height, int maxTicks = 1000);
+    BattleEngine(const BattleEngine&) = default;
+    BattleEngine(BattleEngine&&) = default;
+    BattleEngine& operator=(const BattleEngine&) = default;
+    BattleEngine& operator=(BattleEngine&&) = default;
     ~BattleEngine();
     
-    // Initialization
-    void setTerrain(const std::vector<std::vector<TerrainCell>>& terrain);
+    // Mutable simulation state of an engine, for restore() on the same engine
+    // (or a fork of it) with the same units. Includes the units' saved paths,
+    // which decide how a MOVE towards a moving goal continues.
+    struct Snapshot {
+        int tick;
+        BattleStatus status;
+        std::string winner;
+        std::vector<int> posX;
+        std::vector<int> posY;
+        std::vector<int> health;
+        std::vector<int> cooldown;
+        std::vector<std::uint8_t> alive;
+        std::vector<int> teamAlive;
+        std::vector<UnitPath> paths;
+        EventLog events;
+        Counters counters;
+    };
+    
+    // Initialization. setTerrain interns the cells into a TerrainGrid and
+    // returns false (changing nothing) if there are more than 256 distinct
+    // (type, moveCost) cells
+    bool setTerrain(const std::vector<std::vector<TerrainCell>>& terrain);
+    void setTerrainGrid(TerrainGrid terrain);
     void addUnit(const Unit& unit);
     void setAICallback(const std::string& team, AIDecisionCallback callback);
+    // Batched alternative to setAICallback: one call per team per tick
+    // instead of one per unit. Every ready unit decides against the
+    // start-of-tick state; in Sequential mode the actions are still
+    // executed in slot order. An empty callback removes it.
+    void setTeamDecisionCallback(const std::string& team, TeamDecisionCallback callback);
+    
+    // Team strategy in the rule language of Strategy.h, run natively instead
+    // of the team's callback and replacing any policy. Returns false
+    // (changing nothing) with a message in `error` if it doesn't compile; an
+    // empty source removes the strategy. Each decision runs at most
+    // setStrategyBudget() instructions (256 by default) and idles if it runs
+    // out.
+    bool setTeamStrategy(const std::string& team, const std::string& source,
+                         std::string* error = nullptr);
+    void setStrategyBudget(int instructions) { strategyBudget_ = instructions; }
+    
+    // Built-in policy for a team, run natively instead of its callback and
+    // replacing any strategy; TeamPolicy::None removes it. The name overload
+    // returns false for an unknown name.
+    void setTeamPolicy(const std::string& team, TeamPolicy policy,
+                       const PolicyParams& params = PolicyParams());
+    bool setTeamPolicy(const std::string& team, const std::string& name,
+                       const PolicyParams& params = PolicyParams());
+    
+    // Bulk setup. addUnitsPacked reads `count` PackedUnitLayout records;
+    // setTerrainPacked reads width * height palette indices in row-major
+    // order. Both validate the whole input first and return false (changing
+    // nothing) if any index is out of range.
+    bool addUnitsPacked(const std::int32_t* records, int count,
+                        const std::vector<std::string>& names);
+    bool setTerrainPacked(const std::uint8_t* cells, int width, int height,
+                          const std::vector<TerrainCell>& palette);
+    
+    // Spatial queries use a uniform grid by default; disabling it falls back
+    // to linear scans over all units (kept for benchmarking and validation)
+    void setSpatialIndexEnabled(bool enabled);
+    bool isSpatialIndexEnabled() const { return spatialIndexEnabled_; }
+    
+    // Tick mode (Sequential by default). In TwoPhase mode with more than one
+    // decision thread, AI callbacks are called concurrently and must be
+    // thread-safe; results do not depend on the thread count.
+    void setTickMode(TickMode mode) { tickMode_ = mode; }
+    TickMode getTickMode() const { return tickMode_; }
+    // Threads used for the TwoPhase decision phase (1 = calling thread only,
+    // < 0 = all hardware threads)
+    void setDecisionThreads(int threads);
+    
+    // Event capture. Events are kept in a ring buffer of `capacity` records
+    // (100 by default); disabling capture skips recording entirely, which is
+    // what batch runs want. The mask selects event types (see eventBit).
+    void setEventCapture(bool enabled);
+    void setEventMask(std::uint32_t mask) { events_.setMask(mask); }
+    void setEventLogCapacity(int capacity);
+    const EventLog& getEvents() const { return events_; }
+    
+    // What-if evaluation. snapshot()/restore() save and reload only the
+    // per-tick state (positions, health, cooldowns, status, events); restore
+    // fails if units were added since. fork() returns an independent engine
+    // that shares terrain, unit metadata, AI callbacks and the decision pool
+    // with this one and copies only the hot columns, so it costs about one
+    // memcpy of the unit columns. A fork has no replay recorder attached.
+    Snapshot snapshot() const;
+    bool restore(const Snapshot& snapshot);
+    BattleEngine fork() const;
+    
+    // Replay recording: once attached, initialize() starts a new replay and
+    // every tick appends a frame (see Replay.h). Pass nullptr to detach.
+    void setReplayRecorder(std::shared_ptr<ReplayRecorder> recorder) { recorder_ = recorder; }
     
     // Simulation control
     bool initialize();
@@ -133,9 +528,73 @@ public:
     void run();
     void reset();
     
+    // Run up to `maxTicks` ticks in one call, stopping early when the battle
+    // ends or after a tick that produced any event in `stopEvents` (a mask of
+    // eventBit values, e.g. eventBit(EventType::Kill)). Event stops work
+    // whether or not events are being captured. Initializes the battle
+    // first if needed.
+    AdvanceSummary advance(int maxTicks, std::uint32_t stopEvents = 0);
+    // Same, stopping after the first tick for which `predicate` is true
+    AdvanceSummary advanceUntil(const std::function<bool(const BattleEngine&)>& predicate,
+                                int maxTicks, std::uint32_t stopEvents = 0);
+    
+    // Determinism: given the same inputs a battle plays out identically on
+    // every platform, thread count and run. The engine draws no random
+    // numbers and only uses IEEE-exact arithmetic (+, -, *, /, sqrt), so
+    // native and WASM builds agree. Strategies and policies are
+    // deterministic; callbacks must be too (seed any randomness from
+    // getSeed()) for a battle to be reproducible.
+    void setSeed(std::uint64_t seed) { seed_ = seed; }
+    std::uint64_t getSeed() const { return seed_; }
+    // Declares a team's callbacks deterministic given the seed, under a
+    // caller-chosen identity (e.g. a hash of the AI's source). Battles whose
+    // callbacks all have keys can be hashed and cached; an empty key removes
+    // it.
+    void setCallbackKey(const std::string& team, const std::string& key);
+    // Canonical hash of everything run() depends on: grid size, maxTicks,
+    // tick mode, seed, strategy budget, event capture, terrain cells (not
+    // their storage layout or palette order), units in slot order, their
+    // saved paths, and each team's strategy, policy and callback keys. Not
+    // the current tick, since run() starts over at tick 0. Equal hashes
+    // mean equal results (barring a 128-bit collision). Returns false when
+    // a team with units is driven by a callback without a key.
+    bool inputHash(Hash128& out) const;
+    
+    // Tick instrumentation: per-phase times and hot-path counters, and
+    // optionally a Chrome trace-event dump of every tick. Off by default;
+    // enabling clears the totals. Compiled out (always zero) when
+    // BATTLE_PERF_COUNTERS is 0.
+    void setPerfCounters(bool enabled) { perf_.setEnabled(enabled); }
+    void setPerfTrace(bool enabled) { perf_.setTracing(enabled); }
+    void clearPerfCounters() { perf_.clear(); }
+    PerfCounters getPerfCounters() const { return perf_.snapshot(); }
+    // JSON for chrome://tracing or Perfetto
+    std::string getPerfTrace() const { return perf_.traceJson(); }
+    
     // State access
-    const BattleState& getState() const { return state_; }
-    bool isFinished() const { return state_.status == "finished"; }
+    const BattleState& getState() const;
+    // Id of the unit in `slot` (e.g. to target a unit from a TeamBatch)
+    const std::string& unitId(int slot) const { return units_.cold(slot).id; }
+    // Slots are 0..getUnitCount(), team handles 0..getTeamCount()
+    int getUnitCount() const { return units_.size(); }
+    int getTeamCount() const { return units_.teams.size(); }
+    // Units whose position, health, alive flag or cooldown changed after
+    // `sinceTick`, plus the events recorded since; falls back to a full
+    // snapshot when sinceTick predates the available history
+    StateDelta getStateDelta(int sinceTick) const;
+    // Address of the StateBufferLayout header describing the live unit
+    // columns; refreshed on each call, no per-unit copying
+    std::uintptr_t getStateBuffer() const;
+    const std::string& getTeamName(int handle) const { return units_.teams.name(handle); }
+    // Field that `team`'s "advance" moves follow, brought up to date for the
+    // current tick (distances are summed move costs to the nearest enemy)
+    const FlowField& getFlowField(const std::string& team);
+    // Path that a MOVE towards `to` would follow from `from` (excluding
+    // `from`); empty if unreachable
+    std::vector<Position> findPath(const Position& from, const Position& to);
+    bool isFinished() const { return state_.status == BattleStatus::Finished; }
+    BattleStatus getStatus() const { return state_.status; }
+    std::string getStatusName() const { return statusName(state_.status); }
     int getCurrentTick() const { return state_.tick; }
     std::string getWinner() const { return state_.winner; }
     
@@ -0,0 +1,95 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace BattleSimulator {
+
+// Kinds of battle events
+enum class EventType : std::uint8_t {
+    Initialized,
+    Move,        // actor moved to (x, y)
+    Attack,      // actor hit target for `amount` damage
+    Kill,        // actor eliminated target
+    End,         // battle finished; `amount` holds a BattleOutcome
+    Heal         // actor restored `amount` health to target
+};
+
+// How a battle finished (payload of EventType::End)
+enum class BattleOutcome : std::int32_t {
+    DrawMaxTicks,
+    DrawEliminated,
+    TeamAWins,
+    TeamBWins
+};
+
+// Fixed-size event record. actor/target are unit slots (-1 if unused).
+struct BattleEvent {
+    std::int32_t tick;
+    EventType type;
+    std::int32_t actor;
+    std::int32_t target;
+    std::int32_t amount;
+    std::int32_t x;
+    std::int32_t y;
+};
+
+// Bit for an event type in an EventLog mask
+constexpr std::uint32_t eventBit(EventType type) {
+    return 1u << static_cast<unsigned>(type);
+}
+
+// Bounded ring buffer of BattleEvents.
+//
+// Storage is allocated once (setCapacity) and recording never allocates or
+// shifts: once full, each new event overwrites the oldest. Events whose type
+// is not in the mask are dropped at the call site cost of one branch, and a
+// zero capacity or empty mask turns capture off entirely.
+class EventLog {
+public:
+    // Everything except moves, which are too frequent to be useful by default
+    static constexpr std::uint32_t kDefaultMask = ~eventBit(EventType::Move);
+
+    explicit EventLog(int capacity = 100);
+
+    void setCapacity(int capacity);
+    int capacity() const { return static_cast<int>(events_.size()); }
+
+    void setMask(std::uint32_t mask) { mask_ = mask; }
+    std::uint32_t mask() const { return mask_; }
+    bool wants(EventType type) const {
+        return (mask_ & eventBit(type)) != 0 && !events_.empty();
+    }
+
+    void record(const BattleEvent& event) {
+        if (!wants(event.type)) return;
+        events_[head_] = event;
+        head_ = head_ + 1 == events_.size() ? 0 : head_ + 1;
+        if (count_ < events_.size()) count_++;
+        total_++;
+    }
+
+    void clear();
+
+    // Events currently held, oldest first
+    int size() const { return static_cast<int>(count_); }
+    const BattleEvent& at(int i) const;
+    // Events recorded since the last clear, including overwritten ones
+    std::uint64_t totalRecorded() const { return total_; }
+
+    // Copy of the held events, oldest first
+    std::vector<BattleEvent> snapshot() const;
+
+private:
+    std::vector<BattleEvent> events_;
+    std::size_t head_;      // next write position
+    std::size_t count_;
+    std::uint64_t total_;
+    std::uint32_t mask_;
+};
+
+} // namespace BattleSimulator
+
+#endif // EVENT_LOG_H
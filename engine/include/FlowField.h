@@ -0,0 +1,95 @@
+#ifndef FLOW_FIELD_H
+#define FLOW_FIELD_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <limits>
+
+namespace BattleSimulator {
+
+// Movement cost of entering each cell of a width x height map, row-major.
+// Costs <= 0 (or infinite) mark impassable cells.
+struct CostGrid {
+    int width;
+    int height;
+    std::vector<float> cost;
+
+    CostGrid() : width(0), height(0) {}
+    bool passable(int cell) const { return cost[cell] > 0.0f && cost[cell] < kInfinity; }
+
+    static constexpr float kInfinity = std::numeric_limits<float>::infinity();
+};
+
+// Distance-to-goal field over a CostGrid (Dijkstra from every goal cell at
+// once, 4-connected, paying the cost of each cell entered).
+//
+// update() diffs the new goal set against the previous one. If the cost grid
+// is the same, the old field is repaired instead of rebuilt: every cell
+// remembers which goal it leads to, cells that led to a removed goal are
+// cleared, and Dijkstra restarts from the edge of the cleared area plus the
+// new goals. Goals that stay put cost nothing, so a team whose enemies barely
+// move pays for only the cells around the ones that did.
+//
+// Reading a step is O(1): look at the four neighbours.
+class FlowField {
+public:
+    FlowField();
+
+    // Bring the field up to date for `goals` (cell indices, any order,
+    // duplicates allowed). Returns the number of cells settled.
+    int update(const std::shared_ptr<const CostGrid>& costs, std::vector<int> goals);
+
+    bool empty() const { return !costs_; }
+    const std::shared_ptr<const CostGrid>& costs() const { return costs_; }
+    float distance(int x, int y) const;
+    bool reachable(int x, int y) const { return distance(x, y) < CostGrid::kInfinity; }
+    // Whether the last update reused the previous field
+    bool wasRepaired() const { return repaired_; }
+
+    // Neighbour of (x, y) with the lowest distance strictly below the current
+    // one that `blocked(nx, ny)` rejects; false if there is none (at a goal,
+    // unreachable, or every way down is blocked). Ties go up, left, right,
+    // down, so the result is deterministic.
+    template <typename Blocked>
+    bool nextStep(int x, int y, Blocked blocked, int& outX, int& outY) const;
+
+private:
+    int settle(std::vector<std::pair<float, int>>& heap);
+
+    std::shared_ptr<const CostGrid> costs_;
+    std::vector<float> dist_;
+    std::vector<int> source_;          // goal cell each cell leads to, or -1
+    std::vector<int> goals_;           // sorted, unique
+    std::vector<std::uint8_t> isGoal_;
+    bool repaired_;
+};
+
+template <typename Blocked>
+bool FlowField::nextStep(int x, int y, Blocked blocked, int& outX, int& outY) const {
+    if (!costs_ || x < 0 || y < 0 || x >= costs_->width || y >= costs_->height) {
+        return false;
+    }
+    static const int dx[4] = {0, -1, 1, 0};
+    static const int dy[4] = {-1, 0, 0, 1};
+
+    float best = dist_[y * costs_->width + x];
+    bool found = false;
+    for (int d = 0; d < 4; d++) {
+        int nx = x + dx[d];
+        int ny = y + dy[d];
+        if (nx < 0 || ny < 0 || nx >= costs_->width || ny >= costs_->height) continue;
+        float value = dist_[ny * costs_->width + nx];
+        if (value < best && !blocked(nx, ny)) {
+            best = value;
+            outX = nx;
+            outY = ny;
+            found = true;
+        }
+    }
+    return found;
+}
+
+} // namespace BattleSimulator
+
+#endif // FLOW_FIELD_H
@@ -0,0 +1,87 @@
+#ifndef HASH_128_H
+#define HASH_128_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace BattleSimulator {
+
+// 128-bit digest (non-cryptographic)
+struct Hash128 {
+    std::uint64_t hi;
+    std::uint64_t lo;
+
+    Hash128() : hi(0), lo(0) {}
+    Hash128(std::uint64_t h, std::uint64_t l) : hi(h), lo(l) {}
+    bool operator==(const Hash128& other) const { return hi == other.hi && lo == other.lo; }
+    bool operator!=(const Hash128& other) const { return !(*this == other); }
+    // 32 lowercase hex digits, hi first
+    std::string toHex() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex(32, '0');
+        for (int i = 0; i < 16; i++) {
+            hex[15 - i] = digits[(hi >> (4 * i)) & 0xf];
+            hex[31 - i] = digits[(lo >> (4 * i)) & 0xf];
+        }
+        return hex;
+    }
+};
+
+// Streaming hash over values, not memory: integers, doubles and strings
+// are fed by value, so the digest is the same on any endianness or word
+// size (native and WASM alike)
+class Hasher128 {
+public:
+    Hasher128() : a_(0x243f6a8885a308d3ULL), b_(0x13198a2e03707344ULL), count_(0) {}
+
+    void add(std::uint64_t value) {
+        a_ = rotl(a_ ^ (value * 0x9e3779b97f4a7c15ULL), 29) * 0xbf58476d1ce4e5b9ULL;
+        b_ = (rotl(b_ + value, 31) ^ a_) * 0x94d049bb133111ebULL;
+        count_++;
+    }
+    void add(std::int64_t value) { add(static_cast<std::uint64_t>(value)); }
+    void add(int value) { add(static_cast<std::uint64_t>(static_cast<std::int64_t>(value))); }
+    void add(bool value) { add(static_cast<std::uint64_t>(value ? 1 : 0)); }
+    // By bit pattern, with -0 folded into 0
+    void add(double value) {
+        if (value == 0.0) value = 0.0;
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        add(bits);
+    }
+    void add(const std::string& value) {
+        add(static_cast<std::uint64_t>(value.size()));
+        std::uint64_t word = 0;
+        for (size_t i = 0; i < value.size(); i++) {
+            word |= static_cast<std::uint64_t>(static_cast<unsigned char>(value[i])) << (8 * (i % 8));
+            if (i % 8 == 7) {
+                add(word);
+                word = 0;
+            }
+        }
+        if (value.size() % 8) add(word);
+    }
+
+    Hash128 finish() const {
+        return Hash128(mix(b_ ^ rotl(a_, 17) ^ count_), mix(a_ ^ (count_ * 0x9e3779b97f4a7c15ULL)));
+    }
+
+private:
+    static std::uint64_t rotl(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    static std::uint64_t mix(std::uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    std::uint64_t a_;
+    std::uint64_t b_;
+    std::uint64_t count_;
+};
+
+} // namespace BattleSimulator
+
+#endif // HASH_128_H
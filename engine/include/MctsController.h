@@ -0,0 +1,113 @@
+#ifndef MCTS_CONTROLLER_H
+#define MCTS_CONTROLLER_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "BattleEngine.h"
+#include "ThreadPool.h"
+
+namespace BattleSimulator {
+
+// Team-level behaviours the planner chooses between. Each one is a cheap
+// per-unit rule; the planner picks which rule the whole team follows for
+// the next few ticks.
+enum class TeamMacro {
+    Advance,       // attack the nearest enemy, closing in if out of range
+    Hold,          // attack in range, otherwise stay put
+    FocusWeakest,  // attack the weakest enemy in range, otherwise advance
+    Retreat        // badly hurt units back off, the rest advance
+};
+
+const int kTeamMacroCount = 4;
+const char* teamMacroName(TeamMacro macro);
+
+// One unit's action under a macro. Scans state.units, so it is O(units).
+Action macroAction(TeamMacro macro, const Unit& self, const BattleState& state);
+
+// The attack-closest baseline: attack the closest enemy, closing in along
+// the longer axis when nothing is in range (same as TeamMacro::Advance)
+Action attackClosestPolicy(const Unit& self, const BattleState& state);
+
+struct MctsConfig {
+    int iterations;          // rollouts per decision, summed over threads
+    double timeBudgetMs;     // > 0 stops each decision after this long
+    int threads;             // 1 = calling thread only, < 0 = all hardware threads
+    int decisionTicks;       // ticks each macro choice is held for
+    int treeDepth;           // macro choices searched per rollout
+    int rolloutTicks;        // ticks simulated after the tree part
+    double exploration;      // UCT exploration constant
+    double randomRollout;    // chance a rollout step picks a random macro
+    std::uint64_t seed;
+    // Policy assumed for the opposing team in rollouts; defaults to
+    // attackClosestPolicy. Called from worker threads, so it must be
+    // thread-safe when threads != 1.
+    AIDecisionCallback opponentModel;
+
+    MctsConfig()
+        : iterations(200), timeBudgetMs(0.0), threads(1), decisionTicks(5),
+          treeDepth(3), rolloutTicks(30), exploration(1.4), randomRollout(0.25),
+          seed(1) {}
+};
+
+// Monte-Carlo tree search over team macros.
+//
+// Once per decision interval (the first time any unit of the team is asked
+// to act in a tick that falls on the interval), the controller forks the
+// engine and runs UCT over sequences of TeamMacro choices, each held for
+// decisionTicks, followed by a rollout. Rollouts score a win as 1, a loss
+// as 0, and anything else by the remaining-health balance. Units then act
+// with the chosen macro's rule until the next decision.
+//
+// With threads > 1, each thread grows its own tree from its own seed (root
+// parallelization) and the root visit counts are summed. With a fixed
+// iteration budget the choice is deterministic for a given thread count;
+// a time budget trades that for bounded latency.
+//
+// The controller reads the engine it was attached to, so that engine must
+// stay at the same address while the controller is in use.
+class MctsController {
+public:
+    MctsController(const BattleEngine& engine, const std::string& team, const MctsConfig& config);
+
+    // Create a controller and install it as `team`'s AI callback
+    static std::shared_ptr<MctsController> attach(BattleEngine& engine, const std::string& team,
+                                                  const MctsConfig& config = MctsConfig());
+
+    Action decide(const Unit& self, const BattleState& state);
+
+    TeamMacro currentMacro() const { return macro_; }
+    // Rollouts run by the last decision
+    int lastIterations() const { return lastIterations_; }
+    int decisions() const { return decisions_; }
+
+private:
+    struct Node;
+    struct SearchResult {
+        std::vector<int> visits;
+        std::vector<double> value;
+        int iterations;
+    };
+
+    TeamMacro plan();
+    SearchResult search(int worker, int iterations, double deadlineMs) const;
+    double rollout(const std::vector<int>& path, std::uint64_t& rng) const;
+
+    const BattleEngine& engine_;
+    std::string team_;
+    std::string opponent_;
+    MctsConfig config_;
+    std::shared_ptr<ThreadPool> pool_;
+
+    std::mutex mutex_;
+    int plannedTick_;
+    TeamMacro macro_;
+    int lastIterations_;
+    int decisions_;
+};
+
+} // namespace BattleSimulator
+
+#endif // MCTS_CONTROLLER_H
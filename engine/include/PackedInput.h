@@ -0,0 +1,35 @@
+#ifndef PACKED_INPUT_H
+#define PACKED_INPUT_H
+
+namespace BattleSimulator {
+
+// Fixed-width unit records for BattleEngine::addUnitsPacked.
+//
+// Each record is kPackedUnitWords int32 values in the order below. Id, team
+// and type are indices into the string table passed alongside the records,
+// so a scenario with thousands of units still only ships each distinct name
+// once. maxHealth <= 0 means "same as health".
+namespace PackedUnitLayout {
+
+enum Field {
+    Id,
+    Team,
+    Type,
+    X,
+    Y,
+    Health,
+    MaxHealth,
+    Attack,
+    Defense,
+    Speed,
+    Range,
+    Words
+};
+
+} // namespace PackedUnitLayout
+
+const int kPackedUnitWords = PackedUnitLayout::Words;
+
+} // namespace BattleSimulator
+
+#endif // PACKED_INPUT_H
@@ -0,0 +1,136 @@
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include "FlowField.h"
+
+namespace BattleSimulator {
+
+// Hierarchical A* (HPA*) over a CostGrid.
+//
+// The map is cut into square clusters. Where two neighbouring clusters share
+// a run of open border cells, one transition (two for long runs) links them;
+// the transition cells are the nodes of an abstract graph, and the cost of
+// crossing each cluster between its nodes is precomputed with a Dijkstra
+// bounded to the cluster. A query then searches the small abstract graph and
+// refines the result into cells with A* bounded to single clusters.
+//
+// Caches shared by every caller make repeated queries cheap:
+//   routes    abstract route per (start cluster, goal cluster) pair, used by
+//             every unit travelling between those clusters
+//   trees     per goal, one reverse Dijkstra over the abstract graph; a route
+//             from any other cluster to that goal is then a walk down it
+//   segments  refined cell path per pair of nodes in the same cluster
+// Clusters split by walls are handled by labelling each cluster's connected
+// pieces and keying routes by (cluster, piece), so a cached route is always
+// reachable from inside its piece. Queries starting or ending on an
+// impassable cell run an exact abstract search from their own cells.
+//
+// update() takes a new cost grid of the same size and rebuilds only the
+// clusters containing changed cells and their neighbours. It drops every
+// cached route and goal tree, since a change can open a shorter way between
+// clusters it doesn't touch, but keeps segments outside rebuilt clusters.
+//
+// Paths are near-optimal, not optimal: crossing costs are bounded to one
+// cluster and shared routes are planned cluster to cluster.
+class Pathfinder {
+public:
+    explicit Pathfinder(const std::shared_ptr<const CostGrid>& costs, int clusterSize = 16);
+    Pathfinder(const Pathfinder& other);
+    Pathfinder& operator=(const Pathfinder&) = delete;
+
+    // Switch to `costs`. Returns the number of clusters rebuilt; a grid of a
+    // different size rebuilds everything.
+    int update(const std::shared_ptr<const CostGrid>& costs);
+    const std::shared_ptr<const CostGrid>& costs() const { return costs_; }
+
+    // Cells (row-major indices) from `from`, exclusive, to `to`, inclusive.
+    // The goal may be impassable (e.g. a cell to attack); every other cell on
+    // the path is passable. Returns false if there is no path. Safe to call
+    // from several threads at once, but not concurrently with update().
+    bool findPath(int from, int to, std::vector<int>& path) const;
+
+    int clusterSize() const { return clusterSize_; }
+    int clusterOf(int cell) const;
+    int clusterCount() const { return static_cast<int>(clusters_.size()); }
+    int nodeCount() const { return static_cast<int>(nodeIds_.size()); }
+
+    // Queries answered with a shared route, and ones that needed an exact
+    // abstract search of their own
+    std::uint64_t routeHits() const { return routeHits_; }
+    std::uint64_t exactSearches() const { return exactSearches_; }
+
+private:
+    struct Bounds {
+        int x0, y0, x1, y1;          // cell bounds, exclusive end
+    };
+    struct Cluster : Bounds {
+        std::vector<int> nodes;      // node cells, sorted
+        std::vector<int> ids;        // their node ids
+        std::vector<float> cost;     // nodes x nodes crossing costs
+    };
+    struct Node {
+        int cell;                                 // -1 for a free id
+        int slot;                                 // index in its cluster's nodes
+        std::vector<std::pair<int, float>> links; // neighbouring-cluster node id, entry cost
+    };
+
+    void build();
+    void buildBorder(int border);
+    void clearBorder(int border);
+    int nodeId(int cell);
+    void buildCluster(int c);
+    void updateMinCost();
+
+    // Dijkstra bounded to a cluster from `origin`; with `reverse`, costs are
+    // of paths *into* origin. Fills dist over the cluster's cells.
+    void clusterDijkstra(int c, int origin, bool reverse, std::vector<float>& dist) const;
+    // A* bounded to an area (a cluster or two)
+    bool localPath(const Bounds& area, int from, int to, std::vector<int>& path) const;
+    // Abstract search; starts and goals are (node id, cost) pairs and the
+    // route comes back as node cells
+    bool abstractSearch(const std::vector<std::pair<int, float>>& starts,
+                        const std::vector<std::pair<int, float>>& goals, int goalCluster,
+                        std::vector<int>& route) const;
+    struct GoalTree {
+        std::vector<float> dist;     // per node id: cost to the goal piece
+        std::vector<int> next;       // next node id towards it, -1 at the goal
+    };
+    std::shared_ptr<const GoalTree> goalTree(int goalCluster, int goalPiece) const;
+    bool routeFor(int from, int to, std::vector<int>& route) const;
+    bool segment(int c, int from, int to, std::vector<int>& path) const;
+    bool assemble(int from, int to, const std::vector<int>& route, std::vector<int>& path) const;
+    bool exactPath(int from, int to, std::vector<int>& path) const;
+
+    std::shared_ptr<const CostGrid> costs_;
+    int clusterSize_;
+    int clustersX_;
+    int clustersY_;
+    float minCost_;              // cheapest passable cell, for the heuristic
+    std::vector<Cluster> clusters_;
+    // Abstract graph nodes by dense id, so searches can use flat arrays
+    std::vector<Node> nodes_;
+    std::vector<int> freeIds_;
+    std::unordered_map<int, int> nodeIds_;
+    // Connected piece of its cluster each cell belongs to (-1 if impassable)
+    std::vector<int> component_;
+    // Transitions per border (cluster * 2 + 0 for the right edge, + 1 for
+    // the bottom edge) as (cell in the cluster, cell across the edge)
+    std::vector<std::vector<std::pair<int, int>>> borders_;
+
+    mutable std::mutex cacheMutex_;
+    mutable std::unordered_map<std::uint64_t, std::vector<int>> routes_;
+    mutable std::unordered_map<int, std::shared_ptr<const GoalTree>> trees_;
+    mutable std::unordered_map<std::uint64_t, std::vector<int>> segments_;
+    mutable std::atomic<std::uint64_t> routeHits_;
+    mutable std::atomic<std::uint64_t> exactSearches_;
+};
+
+} // namespace BattleSimulator
+
+#endif // PATHFINDER_H
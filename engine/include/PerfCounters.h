@@ -0,0 +1,167 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Set to 0 (CMake: -DBATTLE_PERF_COUNTERS=OFF) to compile the tick
+// instrumentation out entirely; getPerfCounters() then returns zeros
+#ifndef BATTLE_PERF_COUNTERS
+#define BATTLE_PERF_COUNTERS 1
+#endif
+
+namespace BattleSimulator {
+
+// Timed sections of a tick
+enum class TickPhase : std::uint8_t {
+    Index,       // spatial index rebuild
+    WinCheck,
+    Decide,      // strategies, policies and callbacks
+    Move,
+    Attack,      // attacks and heals
+    Cooldowns,
+    Logging      // replay recording and log formatting
+};
+const int kTickPhaseCount = 7;
+// "index", "winCheck", "decide", "move", "attack", "cooldowns", "logging"
+const char* tickPhaseName(TickPhase phase);
+
+enum class PerfCounter : std::uint8_t {
+    UnitsScanned,        // units examined by nearest/range queries
+    CollisionChecks,
+    CallbackInvocations, // per-unit and batched callbacks
+    Decisions,           // unit decisions from any source
+    Allocations          // heap buffers the queries return, and scratch growth
+};
+const int kPerfCounterCount = 5;
+
+// Totals since the counters were enabled or cleared. Counts are doubles so
+// they reach JS exactly (up to 2^53).
+struct PerfCounters {
+    double ticks;
+    double indexMs;
+    double winCheckMs;
+    double decideMs;
+    double moveMs;
+    double attackMs;
+    double cooldownsMs;
+    double loggingMs;
+    double unitsScanned;
+    double collisionChecks;
+    double callbackInvocations;
+    double decisions;
+    double allocations;
+
+    PerfCounters()
+        : ticks(0), indexMs(0), winCheckMs(0), decideMs(0), moveMs(0), attackMs(0),
+          cooldownsMs(0), loggingMs(0), unitsScanned(0), collisionChecks(0),
+          callbackInvocations(0), decisions(0), allocations(0) {}
+};
+
+// The engine's instrumentation. Everything is a no-op until enabled, so
+// the cost when disabled is one branch per site. Counters may be bumped
+// from decision threads; phases and the trace only from the ticking thread.
+class PerfRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Cap on buffered trace events (further ones are dropped)
+    static const size_t kMaxTraceEvents = 1 << 20;
+
+    PerfRecorder();
+    PerfRecorder(const PerfRecorder& other);
+    PerfRecorder& operator=(const PerfRecorder& other);
+
+    bool enabled() const { return enabled_; }
+    bool tracing() const { return tracing_; }
+    // Enabling clears the totals; tracing implies enabled
+    void setEnabled(bool enabled);
+    void setTracing(bool tracing);
+    void clear();
+
+    void count(PerfCounter counter, std::uint64_t n = 1) {
+        counts_[static_cast<int>(counter)].fetch_add(n, std::memory_order_relaxed);
+    }
+    void addPhase(TickPhase phase, Clock::time_point start, Clock::time_point end, bool traced);
+    void beginTick(int tick);
+    void endTick();
+
+    PerfCounters snapshot() const;
+    // Chrome trace-event JSON (chrome://tracing, Perfetto): a span per tick
+    // with its phase times as args, and spans for the phases that run as
+    // one block
+    std::string traceJson() const;
+    size_t traceEventCount() const { return trace_.size(); }
+
+private:
+    struct TraceEvent {
+        TickPhase phase;
+        bool isTick;
+        int tick;
+        double startUs;
+        double durationUs;
+        double phaseMs[kTickPhaseCount];   // tick spans only
+    };
+
+    double sinceOriginUs(Clock::time_point t) const {
+        return std::chrono::duration<double, std::micro>(t - origin_).count();
+    }
+
+    bool enabled_;
+    bool tracing_;
+    Clock::time_point origin_;
+    std::atomic<std::uint64_t> counts_[kPerfCounterCount];
+    double phaseMs_[kTickPhaseCount];
+    double ticks_;
+
+    // Current tick
+    int tick_;
+    Clock::time_point tickStart_;
+    double tickPhaseMs_[kTickPhaseCount];
+
+    std::vector<TraceEvent> trace_;
+    bool traceTruncated_;
+};
+
+// Times a block into a phase when the recorder is enabled
+class PerfScope {
+public:
+    PerfScope(PerfRecorder& recorder, TickPhase phase, bool traced = true)
+        : recorder_(recorder.enabled() ? &recorder : nullptr), phase_(phase), traced_(traced) {
+        if (recorder_) start_ = PerfRecorder::Clock::now();
+    }
+    ~PerfScope() {
+        if (recorder_) recorder_->addPhase(phase_, start_, PerfRecorder::Clock::now(), traced_);
+    }
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    PerfRecorder* recorder_;
+    TickPhase phase_;
+    bool traced_;
+    PerfRecorder::Clock::time_point start_;
+};
+
+} // namespace BattleSimulator
+
+// Instrumentation sites in the engine; they vanish when compiled out.
+// PERF_PHASE times the rest of the enclosing block.
+#if BATTLE_PERF_COUNTERS
+#define BATTLE_PERF_CONCAT2(a, b) a##b
+#define BATTLE_PERF_CONCAT(a, b) BATTLE_PERF_CONCAT2(a, b)
+#define PERF_PHASE(recorder, phase) \
+    ::BattleSimulator::PerfScope BATTLE_PERF_CONCAT(perfScope_, __LINE__)((recorder), (phase))
+#define PERF_PHASE_UNTRACED(recorder, phase) \
+    ::BattleSimulator::PerfScope BATTLE_PERF_CONCAT(perfScope_, __LINE__)((recorder), (phase), false)
+#define PERF_COUNT(recorder, counter, n) \
+    do { if ((recorder).enabled()) (recorder).count(::BattleSimulator::PerfCounter::counter, (n)); } while (0)
+#else
+#define PERF_PHASE(recorder, phase) do {} while (0)
+#define PERF_PHASE_UNTRACED(recorder, phase) do {} while (0)
+#define PERF_COUNT(recorder, counter, n) do {} while (0)
+#endif
+
+#endif // PERF_COUNTERS_H
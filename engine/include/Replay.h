@@ -0,0 +1,128 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "BattleEngine.h"
+
+namespace BattleSimulator {
+
+// Compact binary battle replays.
+//
+// Layout (all integers are LEB128 varints, signed ones zigzag-encoded):
+//   header    "BRPL", version byte, width, height, keyframe interval,
+//             roster (id/team/type strings and static stats per unit),
+//             terrain palette and one palette index per cell
+//   frames    one per tick, starting with the tick-0 keyframe:
+//             kind byte, tick, status byte, winner string once finished,
+//             then either every unit's dynamic fields (keyframe, every K
+//             ticks) or only the units that changed since the previous
+//             frame (slot gap, field mask, field deltas)
+//   footer    keyframe index (tick, byte offset), last tick, and a fixed
+//             4-byte little-endian offset of the footer itself
+//
+// The reader seeks to any tick by decoding the closest keyframe at or
+// before it and applying at most K-1 deltas; AI callbacks never run.
+class ReplayRecorder {
+public:
+    explicit ReplayRecorder(int keyframeInterval = 32);
+
+    // Start a replay from the engine's current state (called by the
+    // engine's initialize() once attached with setReplayRecorder)
+    void begin(const BattleEngine& engine);
+    // Append a frame for the engine's current tick. Returns false if the
+    // tick was already recorded or the roster changed since begin().
+    bool record(const BattleEngine& engine);
+    // Finish the replay and return its bytes; recording can't continue
+    std::vector<std::uint8_t> finish();
+
+    int keyframeInterval() const { return keyframeInterval_; }
+    size_t size() const { return out_.size(); }
+
+private:
+    struct Keyframe {
+        int tick;
+        size_t offset;
+    };
+
+    void writeFrame(const BattleEngine& engine, bool keyframe);
+
+    int keyframeInterval_;
+    int lastTick_;
+    bool finished_;
+    std::vector<std::uint8_t> out_;
+    std::vector<Keyframe> keyframes_;
+
+    // Dynamic fields as of the last frame
+    std::vector<int> x_;
+    std::vector<int> y_;
+    std::vector<int> health_;
+    std::vector<int> cooldown_;
+    std::vector<std::uint8_t> alive_;
+};
+
+// Dynamic unit fields at one tick, indexed by roster slot
+struct ReplayFrame {
+    int tick;
+    BattleStatus status;
+    std::string winner;
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> health;
+    std::vector<int> cooldown;
+    std::vector<std::uint8_t> alive;
+
+    ReplayFrame() : tick(0), status(BattleStatus::Idle) {}
+};
+
+class ReplayReader {
+public:
+    ReplayReader();
+
+    // Parse the header and footer; false if the data isn't a valid replay
+    bool open(const std::vector<std::uint8_t>& data);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int keyframeInterval() const { return keyframeInterval_; }
+    int firstTick() const { return keyframes_.empty() ? 0 : keyframes_.front().tick; }
+    int lastTick() const { return lastTick_; }
+
+    // Units as they were when recording began (static fields are exact)
+    const std::vector<Unit>& roster() const { return roster_; }
+    const TerrainGrid& terrain() const { return terrain_; }
+
+    // Position the reader at `tick`; false if out of range or corrupt
+    bool seek(int tick);
+    // Step to the following tick; false at the end
+    bool next();
+    const ReplayFrame& frame() const { return frame_; }
+
+private:
+    struct Keyframe {
+        int tick;
+        size_t offset;
+    };
+
+    bool readFrame();
+
+    std::vector<std::uint8_t> data_;
+    size_t cursor_;        // next frame to decode
+    size_t framesEnd_;     // start of the footer
+
+    int width_;
+    int height_;
+    int keyframeInterval_;
+    int lastTick_;
+    std::vector<Unit> roster_;
+    TerrainGrid terrain_;
+    std::vector<Keyframe> keyframes_;
+
+    ReplayFrame frame_;
+    bool positioned_;
+};
+
+} // namespace BattleSimulator
+
+#endif // REPLAY_H
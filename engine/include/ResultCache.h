@@ -0,0 +1,73 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "BattleEngine.h"
+#include "Hash128.h"
+
+namespace BattleSimulator {
+
+// LRU cache of finished battles keyed by BattleEngine::inputHash, so
+// re-running an identical battle (same armies, terrain, strategies and
+// seed) returns its stats without simulating. Memory is bounded by an
+// estimate of each entry's footprint (stats, logs, bookkeeping); the least
+// recently used entries are evicted to stay under it. Safe to share between
+// threads.
+class BattleResultCache {
+public:
+    explicit BattleResultCache(size_t maxBytes = 64 << 20);
+    BattleResultCache(const BattleResultCache&) = delete;
+    BattleResultCache& operator=(const BattleResultCache&) = delete;
+
+    // Counts a hit or a miss
+    bool lookup(const Hash128& key, BattleEngine::BattleStats& out);
+    // An entry larger than the whole budget is not stored
+    void insert(const Hash128& key, const BattleEngine::BattleStats& stats);
+
+    // engine.run() unless the result is cached. On a hit the engine is left
+    // as it was (not run). Battles that can't be hashed always run and count
+    // as uncacheable rather than as misses.
+    BattleEngine::BattleStats run(BattleEngine& engine);
+
+    void clear();
+    void setMaxBytes(size_t maxBytes);
+    size_t maxBytes() const;
+    size_t memoryBytes() const;
+    size_t size() const;
+
+    std::uint64_t hits() const;
+    std::uint64_t misses() const;
+    std::uint64_t evictions() const;
+    std::uint64_t uncacheable() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const Hash128& key) const { return static_cast<size_t>(key.lo ^ key.hi); }
+    };
+    struct Entry {
+        Hash128 key;
+        BattleEngine::BattleStats stats;
+        size_t bytes;
+    };
+    using EntryList = std::list<Entry>;
+
+    static size_t footprint(const BattleEngine::BattleStats& stats);
+    void evictTo(size_t limit);
+
+    mutable std::mutex mutex_;
+    EntryList entries_;   // most recently used first
+    std::unordered_map<Hash128, EntryList::iterator, KeyHash> index_;
+    size_t maxBytes_;
+    size_t bytes_;
+    std::uint64_t hits_;
+    std::uint64_t misses_;
+    std::uint64_t evictions_;
+    std::uint64_t uncacheable_;
+};
+
+} // namespace BattleSimulator
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,54 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <vector>
+#include <cstdint>
+
+namespace BattleSimulator {
+
+// Vectorized target-selection kernels over packed int32 unit columns.
+//
+// Distances are compared as squared int32 values (no sqrt), and candidates
+// are filtered with alive/team masks. Results are identical to the scalar
+// scans in BattleEngine: the nearest enemy is the first unit in slot order
+// with the smallest distance, and in-range enemies come back in slot order.
+// Coordinates are assumed to differ by less than 32768 per axis, the same
+// range in which Position::distanceTo's int arithmetic is defined.
+//
+// The implementation is picked once: AVX2 on x86 CPUs that support it
+// (checked at run time), SIMD128 when compiled for WebAssembly with
+// -msimd128, and a portable scalar loop otherwise.
+
+enum class SimdLevel {
+    Scalar,
+    AVX2,
+    SIMD128
+};
+
+// Read-only view of the columns the kernels need
+struct UnitColumns {
+    const int* x;
+    const int* y;
+    const int* team;
+    const std::uint8_t* alive;
+    int count;
+};
+
+// Best level supported by this build and CPU
+SimdLevel detectSimdLevel();
+SimdLevel getSimdLevel();
+// Force a level (e.g. Scalar for validation); unsupported levels fall back
+// to the detected one. Returns the level actually selected.
+SimdLevel setSimdLevel(SimdLevel level);
+const char* simdLevelName(SimdLevel level);
+
+// Slot of the closest alive unit not on `team`, or -1
+int nearestEnemy(const UnitColumns& units, int x, int y, int team);
+
+// Append slots of alive units not on `team` within `range` of (x, y)
+void enemiesInRange(const UnitColumns& units, int x, int y, int team, int range,
+                    std::vector<int>& out);
+
+} // namespace BattleSimulator
+
+#endif // SIMD_KERNELS_H
@@ -0,0 +1,221 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+namespace BattleSimulator {
+
+// Uniform-grid spatial index over unit slots.
+//
+// Units are kept in per-layer cell lists (the engine uses one layer per team)
+// so nearest-enemy searches never wade through allies. Each cell entry holds
+// the slot index plus a copy of the position, so queries don't touch the unit
+// records at all. Every layer also tracks the bounding box of its occupied
+// cells, which lets ring searches skip the empty space between armies.
+//
+// The engine keeps the grid up to date incrementally (insert on spawn, move on
+// handleMove, remove on death). Positions outside the map are clamped into the
+// border cells; all distance checks use the exact stored coordinates.
+class SpatialGrid {
+public:
+    SpatialGrid();
+
+    // Set up an empty grid covering a width x height map
+    void reset(int width, int height, int cellSize);
+    void clear();
+
+    void insert(int index, int layer, int x, int y);
+    void remove(int index);
+    void move(int index, int x, int y);
+    bool contains(int index) const;
+
+    int getCellSize() const { return cellSize_; }
+    int layerCount() const { return static_cast<int>(layers_.size()); }
+    int size() const { return count_; }
+
+    // Pick a cell size giving a handful of units per cell on average
+    static int suggestCellSize(int width, int height, int unitCount);
+
+    // Visit every unit of a layer whose squared distance to (x, y) is
+    // <= radius^2. Visit order is by cell, not by slot index.
+    template <typename Visitor>
+    void forEachInRadius(int x, int y, int radius, int layer, Visitor visit) const;
+
+    // Visit every indexed unit (any layer) standing exactly on (x, y)
+    template <typename Visitor>
+    void forEachAt(int x, int y, Visitor visit) const;
+
+    // Closest accepted unit of a layer to (x, y). Candidates are compared by
+    // (squared distance, slot index), so when called with a running best the
+    // result matches a linear scan that keeps the first strictly-closer unit.
+    // Returns true if best/bestDist were improved.
+    template <typename Accept>
+    bool nearest(int x, int y, int layer, Accept accept,
+                 int& best, std::int64_t& bestDist) const;
+
+private:
+    struct Entry {
+        int index;
+        int x;
+        int y;
+    };
+
+    struct Layer {
+        std::vector<std::vector<Entry>> cells;
+        std::vector<int> rowCount;
+        std::vector<int> colCount;
+        int count;
+        // Occupied-cell bounding box (empty when count == 0)
+        int minCol, maxCol, minRow, maxRow;
+    };
+
+    int cellCoord(int v, int limit) const;
+    int cellOf(int x, int y) const;
+    Layer& ensureLayer(int layer);
+    void trimBounds(Layer& layer);
+
+    template <typename Accept>
+    bool scanCell(const std::vector<Entry>& cell, int x, int y, Accept& accept,
+                  int& best, std::int64_t& bestDist) const;
+
+    int width_;
+    int height_;
+    int cellSize_;
+    int cellsX_;
+    int cellsY_;
+    int count_;
+
+    std::vector<Layer> layers_;
+    std::vector<int> cellOfIndex_;   // -1 when the slot is not indexed
+    std::vector<int> layerOfIndex_;
+    std::vector<int> slotInCell_;
+};
+
+inline int SpatialGrid::cellCoord(int v, int limit) const {
+    v = std::max(0, std::min(limit - 1, v));
+    return v / cellSize_;
+}
+
+inline int SpatialGrid::cellOf(int x, int y) const {
+    return cellCoord(y, height_) * cellsX_ + cellCoord(x, width_);
+}
+
+template <typename Visitor>
+void SpatialGrid::forEachInRadius(int x, int y, int radius, int layer, Visitor visit) const {
+    if (layer < 0 || layer >= layerCount() || radius < 0) return;
+    const Layer& l = layers_[layer];
+    if (l.count == 0) return;
+
+    const std::int64_t r2 = static_cast<std::int64_t>(radius) * radius;
+    const int cx0 = std::max(l.minCol, cellCoord(x - radius, width_));
+    const int cx1 = std::min(l.maxCol, cellCoord(x + radius, width_));
+    const int cy0 = std::max(l.minRow, cellCoord(y - radius, height_));
+    const int cy1 = std::min(l.maxRow, cellCoord(y + radius, height_));
+
+    for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            for (const Entry& e : l.cells[cy * cellsX_ + cx]) {
+                std::int64_t dx = e.x - x;
+                std::int64_t dy = e.y - y;
+                if (dx * dx + dy * dy <= r2) {
+                    visit(e.index);
+                }
+            }
+        }
+    }
+}
+
+template <typename Visitor>
+void SpatialGrid::forEachAt(int x, int y, Visitor visit) const {
+    if (count_ == 0) return;
+
+    const int cell = cellOf(x, y);
+    for (const Layer& l : layers_) {
+        for (const Entry& e : l.cells[cell]) {
+            if (e.x == x && e.y == y) {
+                visit(e.index);
+            }
+        }
+    }
+}
+
+template <typename Accept>
+bool SpatialGrid::scanCell(const std::vector<Entry>& cell, int x, int y, Accept& accept,
+                           int& best, std::int64_t& bestDist) const {
+    bool improved = false;
+    for (const Entry& e : cell) {
+        std::int64_t dx = e.x - x;
+        std::int64_t dy = e.y - y;
+        std::int64_t d = dx * dx + dy * dy;
+        if (d > bestDist || (d == bestDist && best >= 0 && e.index > best)) continue;
+        if (!accept(e.index)) continue;
+        best = e.index;
+        bestDist = d;
+        improved = true;
+    }
+    return improved;
+}
+
+template <typename Accept>
+bool SpatialGrid::nearest(int x, int y, int layer, Accept accept,
+                          int& best, std::int64_t& bestDist) const {
+    if (layer < 0 || layer >= layerCount()) return false;
+    const Layer& l = layers_[layer];
+    if (l.count == 0) return false;
+
+    const int qx = cellCoord(x, width_);
+    const int qy = cellCoord(y, height_);
+
+    // Only rings that intersect the layer's bounding box can hold candidates
+    const int gapX = std::max(0, std::max(l.minCol - qx, qx - l.maxCol));
+    const int gapY = std::max(0, std::max(l.minRow - qy, qy - l.maxRow));
+    const int firstRing = std::max(gapX, gapY);
+    const int lastRing = std::max(std::max(qx - l.minCol, l.maxCol - qx),
+                                  std::max(qy - l.minRow, l.maxRow - qy));
+
+    bool improved = false;
+    for (int ring = firstRing; ring <= lastRing; ring++) {
+        // Anything at ring >= 1 is more than (ring - 1) * cellSize away, so
+        // stop once that bound passes the best distance found so far. Equal
+        // distances must keep searching so a lower slot index can still win.
+        if (best >= 0 && ring > 0) {
+            std::int64_t bound = static_cast<std::int64_t>(ring - 1) * cellSize_;
+            if (bound * bound > bestDist) break;
+        }
+
+        const int x0 = qx - ring, x1 = qx + ring;
+        const int y0 = qy - ring, y1 = qy + ring;
+        const int colLo = std::max(l.minCol, x0), colHi = std::min(l.maxCol, x1);
+        const int rowLo = std::max(l.minRow, y0 + 1), rowHi = std::min(l.maxRow, y1 - 1);
+
+        // Top and bottom rows of the ring
+        for (int cx = colLo; cx <= colHi; cx++) {
+            if (y0 >= l.minRow && y0 <= l.maxRow) {
+                improved |= scanCell(l.cells[y0 * cellsX_ + cx], x, y, accept, best, bestDist);
+            }
+            if (ring > 0 && y1 >= l.minRow && y1 <= l.maxRow) {
+                improved |= scanCell(l.cells[y1 * cellsX_ + cx], x, y, accept, best, bestDist);
+            }
+        }
+        // Left and right columns, corners excluded
+        if (ring > 0) {
+            for (int cy = rowLo; cy <= rowHi; cy++) {
+                if (x0 >= l.minCol && x0 <= l.maxCol) {
+                    improved |= scanCell(l.cells[cy * cellsX_ + x0], x, y, accept, best, bestDist);
+                }
+                if (x1 >= l.minCol && x1 <= l.maxCol) {
+                    improved |= scanCell(l.cells[cy * cellsX_ + x1], x, y, accept, best, bestDist);
+                }
+            }
+        }
+    }
+
+    return improved;
+}
+
+} // namespace BattleSimulator
+
+#endif // SPATIAL_GRID_H
@@ -0,0 +1,50 @@
+#ifndef STATE_BUFFER_H
+#define STATE_BUFFER_H
+
+#include <cstdint>
+
+
+namespace BattleSimulator {
+
+// Flat, versioned description of the engine's unit columns for zero-copy
+// readers (the WebAssembly host maps typed arrays straight onto them).
+//
+// BattleEngine::getStateBuffer() returns the address of a header of
+// kStateHeaderWords pointer-sized words (int32 in WebAssembly, so the host
+// reads it through HEAP32) laid out as below. Column entries are byte
+// addresses in the engine's memory of `unitCount` contiguous values, indexed
+// by unit slot (the same order as BattleState::units). Int32 columns are
+// positions, health, cooldown and team handle; `alive` is one byte per unit.
+//
+// Column addresses are only valid for the header's `generation`: adding
+// units or resetting the engine may move the columns and bumps it, so a
+// reader caches its views per generation (and, in WebAssembly, per memory
+// buffer, since memory growth detaches old views).
+namespace StateBufferLayout {
+
+const std::intptr_t kMagic = 0x42545342;   // "BSTB"
+const std::intptr_t kVersion = 1;
+
+enum Word {
+    Magic,
+    Version,
+    Generation,
+    Tick,
+    Status,              // BattleStatus as int
+    UnitCount,
+    PosXColumn,
+    PosYColumn,
+    HealthColumn,
+    CooldownColumn,
+    TeamColumn,
+    AliveColumn,         // uint8 per unit
+    HeaderWords
+};
+
+} // namespace StateBufferLayout
+
+const int kStateHeaderWords = StateBufferLayout::HeaderWords;
+
+} // namespace BattleSimulator
+
+#endif // STATE_BUFFER_H
@@ -0,0 +1,163 @@
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+
+namespace BattleSimulator {
+
+// What a unit's strategy can read about itself and its surroundings
+enum class StrategySensor : std::uint8_t {
+    Health,
+    MaxHealth,
+    Attack,
+    Defense,
+    Speed,
+    Range,
+    Cooldown,
+    X,
+    Y,
+    Tick,
+    EnemyDistance,     // to the nearest enemy; kNoEnemy if there is none
+    EnemyHealth,
+    EnemyX,
+    EnemyY,
+    EnemyCount,        // alive enemies on the map
+    AllyCount,         // alive allies, not counting the unit itself
+    TerrainCost,       // move cost of the unit's cell
+    AlliesWithin,      // allies(r): allies within distance r
+    EnemiesWithin      // enemies(r): enemies within distance r
+};
+
+// Actions a strategy ends with
+enum class StrategyAction : std::uint8_t {
+    Idle,
+    AttackNearest,
+    AttackWeakest,     // lowest-health enemy in range, else the nearest
+    MoveUp,
+    MoveDown,
+    MoveLeft,
+    MoveRight,
+    MoveForward,
+    MoveAdvance,       // along the team's flow field
+    MoveToEnemy,       // path to the nearest enemy
+    Retreat            // one step directly away from the nearest enemy
+};
+
+struct StrategyDecision {
+    StrategyAction action;
+    bool exhausted;    // ran out of instructions (the action is Idle)
+};
+
+// A team strategy in a small rule language, compiled to register bytecode.
+//
+// A program is a list of statements separated by newlines or ';'; the first
+// one that produces an action decides, and falling off the end idles:
+//
+//   # charge, but fall back when hurt and alone
+//   if health < maxHealth * 0.3 and allies(3) == 0 then retreat
+//   if enemyDistance <= range then attack weakest
+//   if enemyDistance < 8 then move enemy else move advance
+//
+//   statement  if <expr> then <statement> [else <statement>] | <action>
+//   action     attack [nearest | weakest] | move <up | down | left | right |
+//              forward | advance | enemy> | retreat | idle
+//   expr       numbers, sensors, allies(r), enemies(r), + - * / %,
+//              < <= > >= == !=, and, or, not, parentheses
+//
+// Sensors are health, maxHealth, attack, defense, speed, range, cooldown, x,
+// y, tick, enemyDistance, enemyHealth, enemyX, enemyY, enemyCount,
+// allyCount and terrainCost. Values are doubles; zero is false, comparisons
+// give 1 or 0, and division or modulo by zero gives 0.
+//
+// Instructions are 32-bit words (opcode, then three byte operands or one
+// byte and a 16-bit operand) over up to 256 double registers; jumps only go
+// forward, so every program terminates, and run() also stops after a fixed
+// instruction budget. A program has no access to anything but its sensors.
+class Strategy {
+public:
+    static constexpr double kNoEnemy = 1e9;
+
+    Strategy();
+
+    // Returns false and describes the first problem (with its line) in
+    // `error` if `source` doesn't compile; `out` is left unchanged
+    static bool compile(const std::string& source, Strategy& out, std::string& error);
+
+    // Evaluate for one unit. `sense(sensor, argument)` supplies sensor values
+    // (the argument is the radius for AlliesWithin/EnemiesWithin).
+    template <typename Sensors>
+    StrategyDecision run(Sensors&& sense, int budget) const;
+
+    const std::vector<std::uint32_t>& code() const { return code_; }
+    const std::vector<double>& constants() const { return constants_; }
+
+    enum Op : std::uint8_t {
+        LoadK,       // a = constants[bc]
+        Read,        // a = sense(b)
+        ReadArg,     // a = sense(b, r[c])
+        Add, Sub, Mul, Div, Mod,
+        Lt, Le, Gt, Ge, Eq, Ne,
+        Not,         // a = !r[b]
+        Neg,         // a = -r[b]
+        JumpIfFalse, // if !r[a] goto bc
+        JumpIfTrue,  // if r[a] goto bc
+        Jump,        // goto bc
+        Act          // decide action a
+    };
+
+private:
+    static std::uint32_t encode(Op op, int a, int b, int c) {
+        return static_cast<std::uint32_t>(op) | static_cast<std::uint32_t>(a) << 8 |
+               static_cast<std::uint32_t>(b) << 16 | static_cast<std::uint32_t>(c) << 24;
+    }
+    friend class StrategyCompiler;
+
+    std::vector<std::uint32_t> code_;
+    std::vector<double> constants_;
+};
+
+template <typename Sensors>
+StrategyDecision Strategy::run(Sensors&& sense, int budget) const {
+    double r[256];
+    const std::uint32_t* code = code_.data();
+    const size_t size = code_.size();
+    size_t pc = 0;
+    while (pc < size) {
+        if (budget-- <= 0) return StrategyDecision{StrategyAction::Idle, true};
+        const std::uint32_t word = code[pc++];
+        const int a = (word >> 8) & 0xff;
+        const int b = (word >> 16) & 0xff;
+        const int c = word >> 24;
+        const int bc = word >> 16;
+        switch (static_cast<Op>(word & 0xff)) {
+            case LoadK: r[a] = constants_[bc]; break;
+            case Read: r[a] = sense(static_cast<StrategySensor>(b), 0.0); break;
+            case ReadArg: r[a] = sense(static_cast<StrategySensor>(b), r[c]); break;
+            case Add: r[a] = r[b] + r[c]; break;
+            case Sub: r[a] = r[b] - r[c]; break;
+            case Mul: r[a] = r[b] * r[c]; break;
+            case Div: r[a] = r[c] != 0.0 ? r[b] / r[c] : 0.0; break;
+            case Mod: r[a] = r[c] != 0.0 ? std::fmod(r[b], r[c]) : 0.0; break;
+            case Lt: r[a] = r[b] < r[c]; break;
+            case Le: r[a] = r[b] <= r[c]; break;
+            case Gt: r[a] = r[b] > r[c]; break;
+            case Ge: r[a] = r[b] >= r[c]; break;
+            case Eq: r[a] = r[b] == r[c]; break;
+            case Ne: r[a] = r[b] != r[c]; break;
+            case Not: r[a] = r[b] == 0.0; break;
+            case Neg: r[a] = -r[b]; break;
+            case JumpIfFalse: if (r[a] == 0.0) pc = bc; break;
+            case JumpIfTrue: if (r[a] != 0.0) pc = bc; break;
+            case Jump: pc = bc; break;
+            case Act: return StrategyDecision{static_cast<StrategyAction>(a), false};
+        }
+    }
+    return StrategyDecision{StrategyAction::Idle, false};
+}
+
+} // namespace BattleSimulator
+
+#endif // STRATEGY_H
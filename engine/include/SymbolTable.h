@@ -0,0 +1,32 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+namespace BattleSimulator {
+
+// Interns strings into dense integer handles (0, 1, 2, ...).
+//
+// Used for team and unit type names so the tick loop compares ints instead
+// of strings; the original names are only looked up at the API boundary.
+class SymbolTable {
+public:
+    // Handle for name, adding it if it hasn't been seen yet
+    int intern(const std::string& name);
+    // Handle for name, or -1 if unknown
+    int find(const std::string& name) const;
+    const std::string& name(int handle) const { return names_[handle]; }
+
+    int size() const { return static_cast<int>(names_.size()); }
+    void clear();
+
+private:
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, int> handles_;
+};
+
+} // namespace BattleSimulator
+
+#endif // SYMBOL_TABLE_H
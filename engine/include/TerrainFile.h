@@ -0,0 +1,109 @@
+#ifndef TERRAIN_FILE_H
+#define TERRAIN_FILE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "TerrainGrid.h"
+
+namespace BattleSimulator {
+
+// On-disk tiled terrain for maps too large to copy per battle.
+//
+// Layout (fixed-width little-endian, so the file can be mapped as is):
+//   header     "BTER", version byte, tileShift byte, u16 palette size,
+//              u32 width, u32 height
+//   palette    per entry: u16 type length, type bytes, f64 moveCost
+//   directory  at the next multiple of 8, one 16-byte entry per tile in
+//              row-major tile order: u64 offset, u32 size, u8 encoding,
+//              u8 fill index, u16 reserved
+//   tiles      from the next multiple of 4096; each 2^tileShift cells
+//              square, row-major palette indices, padded at the map edges
+//
+// Tiles are stored raw, as a single fill index (uniform tiles), or
+// run-length encoded as (count, index) byte pairs. Compression only applies
+// to tiles it shrinks.
+//
+// open() maps the file read-only, so the OS pages tiles in as they are
+// touched and every process and battle using the same map shares one page
+// cache copy. When every tile is raw, grid() is a zero-copy TerrainGrid over
+// the mapping (kept alive by the grid). Compressed files decode tiles on
+// first use through tile(), or all at once into a private grid. Replace a
+// map that may be in use by writing a new file and renaming it over the old
+// one: truncating a mapped file faults every reader.
+class TerrainFile {
+public:
+    enum TileEncoding : std::uint8_t {
+        RawTile = 0,
+        FillTile = 1,
+        RleTile = 2
+    };
+
+    TerrainFile();
+    TerrainFile(const TerrainFile&) = delete;
+    TerrainFile& operator=(const TerrainFile&) = delete;
+
+    // Write `grid` with tiles of 2^tileShift cells (3..10). Returns false on
+    // a bad tile size or an I/O error.
+    static bool write(const std::string& path, const TerrainGrid& grid, int tileShift = 5,
+                      bool compress = false);
+    // Terrain from the JSON the backend sends: an array of rows, or an object
+    // with a "terrain" array of rows. Cells are {"type", "moveCost"} objects,
+    // type strings (cost 1) or null (ground). Returns false on malformed JSON
+    // or more than 256 distinct cells.
+    static bool parseJson(const std::string& json, TerrainGrid& out);
+
+    // Validates the header, palette and tile directory (not the cells of raw
+    // tiles, which stay unread until used). Returns false if the file is
+    // missing or malformed.
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return static_cast<bool>(storage_); }
+    // False when the platform has no mmap and the file was read into memory
+    bool isMapped() const { return mapped_; }
+    bool isCompressed() const { return !contiguous_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int tileShift() const { return tileShift_; }
+    int tilesX() const { return tilesX_; }
+    int tilesY() const { return tilesY_; }
+    const std::vector<TerrainCell>& palette() const { return palette_; }
+
+    // 2^tileShift x 2^tileShift palette indices of tile (tx, ty), row-major.
+    // Safe to call from several threads.
+    const std::uint8_t* tile(int tx, int ty) const;
+    TerrainGrid grid() const;
+
+private:
+    struct TileEntry {
+        std::uint64_t offset;
+        std::uint32_t size;
+        std::uint8_t encoding;
+        std::uint8_t fill;
+    };
+
+    void decode(const TileEntry& entry, std::uint8_t* out) const;
+
+    std::shared_ptr<const void> storage_;  // mapping or buffer; owns `data_`
+    const std::uint8_t* data_;
+    size_t size_;
+    bool mapped_;
+    int width_;
+    int height_;
+    int tileShift_;
+    int tilesX_;
+    int tilesY_;
+    std::vector<TerrainCell> palette_;
+    std::vector<TileEntry> tiles_;
+    bool contiguous_;                       // every tile raw, in order, back to back
+
+    mutable std::mutex decodeMutex_;
+    mutable std::vector<std::unique_ptr<std::uint8_t[]>> decoded_;
+};
+
+} // namespace BattleSimulator
+
+#endif // TERRAIN_FILE_H
@@ -0,0 +1,124 @@
+#ifndef TERRAIN_GRID_H
+#define TERRAIN_GRID_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+namespace BattleSimulator {
+
+// Terrain cell
+struct TerrainCell {
+    std::string type;
+    double moveCost;
+
+    TerrainCell() : type("ground"), moveCost(1.0) {}
+    TerrainCell(const std::string& t, double cost) : type(t), moveCost(cost) {}
+};
+
+// Terrain map stored as one byte per cell indexing a palette of at most 256
+// distinct (type, moveCost) entries, so a 1000x1000 map is 1 MB of indices
+// instead of a million strings.
+//
+// Cells are laid out in square tiles of 2^tileShift cells per side, tile
+// after tile and row-major inside each tile; tileShift 0 is plain row-major.
+// Tiles at the right and bottom edges are padded to full size. Either way
+// at(x, y) is a couple of shifts and masks.
+//
+// Rows of TerrainCell objects are only built at the API boundary (toRows);
+// terrain[y][x] reads go through a lightweight row view.
+//
+// The cell bytes are immutable and shared between copies. They are either
+// owned (calloc'd, so an untouched all-ground map costs no resident memory)
+// or borrowed from storage such as a memory-mapped TerrainFile, which the
+// grid keeps alive.
+class TerrainGrid {
+public:
+    static constexpr int kMaxPalette = 256;
+
+    class Row {
+    public:
+        Row(const TerrainGrid& grid, int y) : grid_(&grid), y_(y) {}
+        const TerrainCell& operator[](size_t x) const { return grid_->at(static_cast<int>(x), y_); }
+        size_t size() const { return static_cast<size_t>(grid_->width()); }
+
+    private:
+        const TerrainGrid* grid_;
+        int y_;
+    };
+
+    TerrainGrid();
+    // width x height cells of `fill`
+    TerrainGrid(int width, int height, const TerrainCell& fill = TerrainCell(), int tileShift = 0);
+
+    // Interns the distinct cells of `rows`; the width is the longest row and
+    // cells missing from shorter rows are ground. Returns false if there are
+    // more than kMaxPalette distinct cells.
+    static bool fromRows(const std::vector<std::vector<TerrainCell>>& rows, TerrainGrid& out,
+                         int tileShift = 0);
+    // Row-major palette indices; returns false on an index outside the
+    // palette
+    static bool fromPacked(const std::uint8_t* cells, int width, int height,
+                           const std::vector<TerrainCell>& palette, TerrainGrid& out,
+                           int tileShift = 0);
+    std::vector<std::vector<TerrainCell>> toRows() const;
+    // Same cells in another layout
+    TerrainGrid retiled(int tileShift) const;
+    // Grid over cells laid out for `tileShift` that live in `storage`.
+    // Indices are not scanned (that would page in the whole map); the
+    // palette is padded so any index past it reads as an impassable "void".
+    static TerrainGrid wrap(int width, int height, int tileShift, std::vector<TerrainCell> palette,
+                            const std::uint8_t* cells, std::shared_ptr<const void> storage);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    bool empty() const { return width_ == 0 || height_ == 0; }
+    int tileShift() const { return tileShift_; }
+    int tileSize() const { return 1 << tileShift_; }
+    int tilesX() const { return tilesX_; }
+    int tilesY() const { return tilesY_; }
+
+    size_t index(int x, int y) const {
+        const int mask = (1 << tileShift_) - 1;
+        const size_t tile = static_cast<size_t>(y >> tileShift_) * tilesX_ + (x >> tileShift_);
+        return (tile << (2 * tileShift_)) + ((y & mask) << tileShift_) + (x & mask);
+    }
+    bool inBounds(int x, int y) const { return x >= 0 && y >= 0 && x < width_ && y < height_; }
+    std::uint8_t paletteIndex(int x, int y) const { return cells_[index(x, y)]; }
+    const TerrainCell& at(int x, int y) const { return palette_[cells_[index(x, y)]]; }
+    double moveCost(int x, int y) const { return palette_[cells_[index(x, y)]].moveCost; }
+
+    const std::vector<TerrainCell>& palette() const { return palette_; }
+    // tileSize() x tileSize() indices of tile (tx, ty), row-major
+    const std::uint8_t* tile(int tx, int ty) const {
+        return cells_ + ((static_cast<size_t>(ty) * tilesX_ + tx) << (2 * tileShift_));
+    }
+    const std::uint8_t* data() const { return cells_; }
+    // What keeps data() alive (shared by copies of this grid)
+    const std::shared_ptr<const void>& storage() const { return storage_; }
+    size_t dataSize() const { return static_cast<size_t>(tilesX_) * tilesY_ << (2 * tileShift_); }
+    size_t memoryBytes() const;
+
+    // Row view, so terrain[y][x] and terrain.size() read like the old rows
+    Row operator[](size_t y) const { return Row(*this, static_cast<int>(y)); }
+    size_t size() const { return static_cast<size_t>(height_); }
+
+private:
+    // Sets the dimensions and returns zeroed, owned cell storage
+    std::uint8_t* allocate(int width, int height, int tileShift);
+
+    int width_;
+    int height_;
+    int tileShift_;
+    int tilesX_;
+    int tilesY_;
+    std::vector<TerrainCell> palette_;
+    const std::uint8_t* cells_;
+    std::shared_ptr<const void> storage_;
+};
+
+} // namespace BattleSimulator
+
+#endif // TERRAIN_GRID_H
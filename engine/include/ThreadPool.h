@@ -0,0 +1,83 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <cstdint>
+
+namespace BattleSimulator {
+
+// Fixed-size work-stealing thread pool.
+//
+// parallelFor() splits an index range into chunks and deals them round-robin
+// onto per-worker deques. Each worker drains its own deque from the back and,
+// when it runs dry, steals from the front of the others, so uneven work
+// (battles that end early, units with expensive AI) balances itself. The
+// calling thread takes part as an extra worker.
+//
+// A pool with zero workers runs everything inline on the caller, which is
+// also what happens for nested parallelFor calls made from inside a task
+// and for WebAssembly builds without pthreads.
+class ThreadPool {
+public:
+    // threads < 0 picks one worker per hardware thread (minus the caller)
+    explicit ThreadPool(int threads = -1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Worker threads, not counting the calling thread
+    int workerCount() const { return static_cast<int>(workers_.size()); }
+    // Threads that execute a parallelFor, including the caller
+    int concurrency() const { return workerCount() + 1; }
+
+    // Run body(begin, end) over [0, count) in chunks of at most `grain`
+    // indices and wait for all of them. The first exception thrown by a
+    // chunk is rethrown here once every chunk has finished.
+    void parallelFor(int count, int grain, const std::function<void(int, int)>& body);
+
+    static int hardwareThreads();
+
+private:
+    struct Chunk {
+        int begin;
+        int end;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    void workerLoop(int worker);
+    bool popOrSteal(int worker, Chunk& chunk);
+    void runChunks(int worker);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<Queue>> queues_;   // one per worker + caller
+
+    std::mutex jobMutex_;
+    std::condition_variable jobReady_;
+    std::condition_variable jobDone_;
+    const std::function<void(int, int)>* body_;
+    std::uint64_t generation_;
+    std::atomic<int> pending_;
+    int activeWorkers_;
+    bool stopping_;
+    std::exception_ptr error_;
+
+    // Serializes concurrent parallelFor calls from different threads
+    std::mutex runMutex_;
+};
+
+} // namespace BattleSimulator
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,108 @@
+#ifndef UNIT_STORE_H
+#define UNIT_STORE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <memory>
+#include "SymbolTable.h"
+#include "SimdKernels.h"
+
+namespace BattleSimulator {
+
+struct Unit;
+
+// Structure-of-arrays unit storage used by BattleEngine.
+//
+// Everything the tick loop reads lives in contiguous per-field columns, so a
+// pass over positions or health only pulls those bytes through the cache.
+// Strings and rarely used stats live in a separate cold table indexed by the
+// same slot. A full Unit is only materialized on demand.
+//
+// Team and type names are interned into dense handles when a unit is added;
+// the slot index doubles as the unit's handle and ids resolve to slots
+// through a hash index.
+//
+// The cold table, type names and id index never change during a battle, so
+// they live in a Roster shared between copies of the store (forked engines)
+// and are only copied when a unit is added to a store that shares them.
+struct UnitStore {
+    // Hot columns
+    std::vector<int> team;             // handle into teams
+    std::vector<int> posX;
+    std::vector<int> posY;
+    std::vector<int> health;
+    std::vector<int> cooldown;
+    std::vector<int> attack;
+    std::vector<int> defense;
+    std::vector<int> range;
+    std::vector<int> speed;
+    std::vector<std::uint8_t> alive;   // alive && health > 0
+
+    // Cold table
+    struct ColdData {
+        std::string id;
+        int type;                      // handle into types
+        std::string targetId;
+        int maxHealth;
+        int startX;                    // position when added
+        int startY;
+        int nextWithSameId;            // next slot sharing this id, or -1
+    };
+    struct Roster {
+        std::vector<ColdData> cold;
+        SymbolTable types;
+        std::unordered_map<std::string, int> firstSlotById;
+    };
+    std::shared_ptr<Roster> roster;
+
+    SymbolTable teams;
+    std::vector<int> teamAlive;        // alive units per team handle
+
+    UnitStore();
+
+    const ColdData& cold(int i) const { return roster->cold[i]; }
+    const std::string& typeName(int i) const { return roster->types.name(roster->cold[i].type); }
+
+    int size() const { return static_cast<int>(posX.size()); }
+    bool isAlive(int i) const { return alive[i] != 0; }
+    const std::string& teamName(int i) const { return teams.name(team[i]); }
+    int aliveCount(int teamHandle) const {
+        return teamHandle >= 0 && teamHandle < static_cast<int>(teamAlive.size())
+            ? teamAlive[teamHandle] : 0;
+    }
+
+    // Column view for the SIMD kernels
+    UnitColumns columns() const {
+        return UnitColumns{posX.data(), posY.data(), team.data(), alive.data(), size()};
+    }
+
+    // Intern a team name (so handles can be fixed before units arrive)
+    int internTeam(const std::string& name);
+    // First alive slot with the given id, or -1
+    int findAlive(const std::string& id) const;
+
+    // Roster for writing; copied first if another store shares it
+    Roster& mutableRoster();
+    
+    // Append a unit and return its slot
+    int add(const Unit& unit);
+    // Remove all units; team handles are kept
+    void clear();
+    void reserve(size_t count);
+
+    // Returns true if the hit killed the unit
+    bool takeDamage(int i, int damage);
+    void heal(int i, int amount);
+
+    // Build the public Unit view of a slot
+    Unit materialize(int i) const;
+    // Refresh only the fields the simulation mutates (position, health,
+    // alive, cooldown) on an existing view
+    void refresh(int i, Unit& view) const;
+};
+
+} // namespace BattleSimulator
+
+#endif // UNIT_STORE_H
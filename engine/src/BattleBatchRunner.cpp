@@ -0,0 +1,90 @@
+#include "BattleBatchRunner.h"
+#include <chrono>
+#include <algorithm>
+
+namespace BattleSimulator {
+
+namespace {
+
+std::uint64_t splitMix64(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+BattleBatchRunner::BattleBatchRunner(int threads)
+    : pool_(threads < 0 ? -1 : std::max(0, threads - 1)), keepLogs_(false) {}
+
+std::uint64_t BattleBatchRunner::teamSeed(std::uint64_t battleSeed, const std::string& team) {
+    // FNV-1a over the team name, so the result is stable across platforms
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : team) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return splitMix64(battleSeed ^ hash);
+}
+
+BattleEngine::BattleStats BattleBatchRunner::runOne(const BattleConfig& config, bool keepLogs) {
+    BattleEngine engine(config.width, config.height, config.maxTicks);
+    engine.setEventCapture(keepLogs);
+    engine.setSeed(config.seed);
+    
+    if (!config.terrain.empty()) {
+        engine.setTerrain(config.terrain);
+    } else if (!config.terrainGrid.empty()) {
+        engine.setTerrainGrid(config.terrainGrid);
+    }
+    for (const auto& unit : config.units) {
+        engine.addUnit(unit);
+    }
+    for (const auto& policy : config.policies) {
+        if (policy.second) {
+            engine.setAICallback(policy.first, policy.second(teamSeed(config.seed, policy.first)));
+        }
+    }
+    
+    engine.run();
+    
+    return engine.getBattleStats();
+}
+
+BatchResult BattleBatchRunner::run(const std::vector<BattleConfig>& configs) {
+    BatchResult result;
+    result.battles.resize(configs.size());
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    // One battle per chunk: battles vary a lot in length, stealing evens it out
+    pool_.parallelFor(static_cast<int>(configs.size()), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            result.battles[i] = runOne(configs[i], keepLogs_);
+        }
+    });
+    
+    result.elapsedSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    
+    BatchSummary& summary = result.summary;
+    long long totalTicks = 0;
+    for (const auto& stats : result.battles) {
+        summary.battles++;
+        totalTicks += stats.totalTicks;
+        if (stats.winner == "teamA") summary.teamAWins++;
+        else if (stats.winner == "teamB") summary.teamBWins++;
+        else summary.draws++;
+    }
+    if (summary.battles > 0) {
+        double n = static_cast<double>(summary.battles);
+        summary.teamAWinRate = summary.teamAWins / n;
+        summary.teamBWinRate = summary.teamBWins / n;
+        summary.drawRate = summary.draws / n;
+        summary.averageTicks = totalTicks / n;
+    }
+    
+    return result;
+}
+
+} // namespace BattleSimulator
@@ -1,10 +1,89 @@
 #include "BattleEngine.h"
+#include "Replay.h"
 #include <cmath>
 #include <algorithm>
 #include <sstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 namespace BattleSimulator {
 
+namespace {
+
+// Below this many units a vectorized scan beats walking grid cells
+const int kDenseScanLimit = 64;
+
+// Units per chunk in the parallel decision phase
+const int kDecisionGrain = 16;
+
+// Move costs are a float per cell, derived once per terrain storage and
+// shared by every engine using it (e.g. all battles on one memory-mapped
+// TerrainFile) rather than built per battle. Entries hold the terrain's
+// storage so its address can't be reused while they are alive.
+struct SharedCosts {
+    CostGrid grid;
+    std::shared_ptr<const void> storage;
+};
+
+struct CostKey {
+    const std::uint8_t* cells;
+    int width;
+    int height;
+    int terrainWidth;
+    int terrainHeight;
+    int tileShift;
+    std::vector<float> palette;
+
+    bool operator<(const CostKey& other) const {
+        return std::tie(cells, width, height, terrainWidth, terrainHeight, tileShift, palette) <
+               std::tie(other.cells, other.width, other.height, other.terrainWidth,
+                        other.terrainHeight, other.tileShift, other.palette);
+    }
+};
+
+std::mutex costCacheMutex;
+std::map<CostKey, std::weak_ptr<const CostGrid>> costCache;
+
+// width x height costs (1 outside the terrain)
+std::shared_ptr<const CostGrid> sharedMoveCosts(const TerrainGrid& terrain, int width, int height) {
+    CostKey key = CostKey{terrain.data(), width, height, terrain.width(), terrain.height(),
+                          terrain.tileShift(), std::vector<float>()};
+    for (const TerrainCell& cell : terrain.palette()) {
+        key.palette.push_back(static_cast<float>(cell.moveCost));
+    }
+    
+    std::lock_guard<std::mutex> lock(costCacheMutex);
+    auto found = costCache.find(key);
+    if (found != costCache.end()) {
+        if (std::shared_ptr<const CostGrid> costs = found->second.lock()) return costs;
+    }
+    for (auto it = costCache.begin(); it != costCache.end();) {
+        it = it->second.expired() ? costCache.erase(it) : std::next(it);
+    }
+    
+    auto shared = std::make_shared<SharedCosts>();
+    shared->storage = terrain.storage();
+    CostGrid& costs = shared->grid;
+    costs.width = width;
+    costs.height = height;
+    costs.cost.assign(static_cast<size_t>(width) * static_cast<size_t>(height), 1.0f);
+    const int terrainWidth = std::min(width, terrain.width());
+    const int terrainHeight = std::min(height, terrain.height());
+    for (int y = 0; y < terrainHeight; y++) {
+        float* row = costs.cost.data() + static_cast<size_t>(y) * static_cast<size_t>(width);
+        for (int x = 0; x < terrainWidth; x++) {
+            row[x] = key.palette[terrain.paletteIndex(x, y)];
+        }
+    }
+    std::shared_ptr<const CostGrid> result(shared, &shared->grid);
+    costCache[key] = result;
+    return result;
+}
+
+} // namespace
+
 // Position implementation
 double Position::distanceTo(const Position& other) const {
     int dx = other.x - x;
@@ -27,69 +106,632 @@ Unit::Unit(const std::string& id, const std::string& team, const std::string& ty
       health(100), maxHealth(100), attack(10), defense(5),
       speed(1), range(1), alive(true), cooldown(0), targetId("") {}
 
+void Unit::takeDamage(int damage) {
+    health -= damage;
+    if (health <= 0) {
+        health = 0;
+        alive = false;
+    }
+}
+
+void Unit::heal(int amount) {
+    if (!isAlive()) return;
+    health = std::min(maxHealth, health + amount);
+}
+
+// BattleStatus names
+const char* statusName(BattleStatus status) {
+    switch (status) {
+        case BattleStatus::Initialized: return "initialized";
+        case BattleStatus::Running: return "running";
+        case BattleStatus::Finished: return "finished";
+        case BattleStatus::Idle:
+        default: return "idle";
+    }
+}
+
+BattleStatus parseStatus(const std::string& name) {
+    if (name == "initialized") return BattleStatus::Initialized;
+    if (name == "running") return BattleStatus::Running;
+    if (name == "finished") return BattleStatus::Finished;
+    return BattleStatus::Idle;
+}
+
+// TeamPolicy names
+const char* teamPolicyName(TeamPolicy policy) {
+    switch (policy) {
+        case TeamPolicy::FocusFire: return "focusFire";
+        case TeamPolicy::Kite: return "kite";
+        case TeamPolicy::HoldFormation: return "holdFormation";
+        case TeamPolicy::Flank: return "flank";
+        case TeamPolicy::RetreatAndHeal: return "retreatAndHeal";
+        case TeamPolicy::None:
+        default: return "none";
+    }
+}
+
+bool parseTeamPolicy(const std::string& name, TeamPolicy& policy) {
+    static const TeamPolicy all[] = {
+        TeamPolicy::None, TeamPolicy::FocusFire, TeamPolicy::Kite,
+        TeamPolicy::HoldFormation, TeamPolicy::Flank, TeamPolicy::RetreatAndHeal
+    };
+    for (TeamPolicy candidate : all) {
+        if (name == teamPolicyName(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// AdvanceStop names
+const char* advanceStopName(AdvanceStop stop) {
+    switch (stop) {
+        case AdvanceStop::Finished: return "finished";
+        case AdvanceStop::Event: return "event";
+        case AdvanceStop::Predicate: return "predicate";
+        case AdvanceStop::TickBudget:
+        default: return "budget";
+    }
+}
+
 // BattleEngine implementation
 BattleEngine::BattleEngine(int width, int height, int maxTicks)
-    : gridWidth_(width), gridHeight_(height), maxTicks_(maxTicks) {
-    state_.terrain.resize(height, std::vector<TerrainCell>(width));
+    : gridWidth_(width), gridHeight_(height), maxTicks_(maxTicks),
+      aiCallbacks_(std::make_shared<std::vector<AIDecisionCallback>>()),
+      teamCallbacks_(std::make_shared<std::vector<TeamDecisionCallback>>()),
+      strategyBudget_(256), seed_(0), teamA_(-1), teamB_(-1), viewBuilt_(true),
+      deltaBaseTick_(0), stateHeader_(), stateGeneration_(0),
+      spatialIndexEnabled_(true), spatialIndexDirty_(true),
+      tickMode_(TickMode::Sequential), logsDirty_(false),
+      counters_(), tickEvents_(0) {
+    state_.terrain = TerrainGrid(width, height);
+    
+    // The win condition is defined in terms of these two teams
+    teamA_ = units_.internTeam("teamA");
+    teamB_ = units_.internTeam("teamB");
+}
+
+BattleEngine::BattleEngine(const BattleEngine& source, ForkTag)
+    : units_(source.units_),
+      gridWidth_(source.gridWidth_), gridHeight_(source.gridHeight_), maxTicks_(source.maxTicks_),
+      aiCallbacks_(source.aiCallbacks_), teamCallbacks_(source.teamCallbacks_),
+      strategies_(source.strategies_),
+      strategyBudget_(source.strategyBudget_), policies_(source.policies_),
+      callbackKeys_(source.callbackKeys_), seed_(source.seed_), teamA_(source.teamA_), teamB_(source.teamB_),
+      staleFlags_(source.staleFlags_.size(), 0), viewBuilt_(false),
+      changedTick_(source.changedTick_), deltaBaseTick_(source.deltaBaseTick_),
+      stateHeader_(), stateGeneration_(0),
+      spatialIndexEnabled_(source.spatialIndexEnabled_), spatialIndexDirty_(true),
+      moveCosts_(source.moveCosts_), pathfinder_(source.pathfinder_), unitPaths_(source.unitPaths_),
+      tickMode_(source.tickMode_), decisionPool_(source.decisionPool_),
+      events_(source.events_), logsDirty_(true),
+      counters_(source.counters_), tickEvents_(source.tickEvents_) {
+    state_.tick = source.state_.tick;
+    state_.status = source.state_.status;
+    state_.winner = source.state_.winner;
+    state_.terrain = source.state_.terrain;
 }
 
 BattleEngine::~BattleEngine() {}
 
-void BattleEngine::setTerrain(const std::vector<std::vector<TerrainCell>>& terrain) {
-    state_.terrain = terrain;
+BattleEngine BattleEngine::fork() const {
+    return BattleEngine(*this, ForkTag());
+}
+
+BattleEngine::Snapshot BattleEngine::snapshot() const {
+    Snapshot snapshot;
+    snapshot.tick = state_.tick;
+    snapshot.status = state_.status;
+    snapshot.winner = state_.winner;
+    snapshot.posX = units_.posX;
+    snapshot.posY = units_.posY;
+    snapshot.health = units_.health;
+    snapshot.cooldown = units_.cooldown;
+    snapshot.alive = units_.alive;
+    snapshot.teamAlive = units_.teamAlive;
+    snapshot.paths = unitPaths_;
+    snapshot.events = events_;
+    snapshot.counters = counters_;
+    return snapshot;
+}
+
+bool BattleEngine::restore(const Snapshot& snapshot) {
+    if (static_cast<int>(snapshot.posX.size()) != units_.size() ||
+        snapshot.teamAlive.size() > units_.teamAlive.size()) {
+        return false;
+    }
+    
+    state_.tick = snapshot.tick;
+    state_.status = snapshot.status;
+    state_.winner = snapshot.winner;
+    units_.posX = snapshot.posX;
+    units_.posY = snapshot.posY;
+    units_.health = snapshot.health;
+    units_.cooldown = snapshot.cooldown;
+    units_.alive = snapshot.alive;
+    std::copy(snapshot.teamAlive.begin(), snapshot.teamAlive.end(), units_.teamAlive.begin());
+    unitPaths_ = snapshot.paths;
+    events_ = snapshot.events;
+    counters_ = snapshot.counters;
+    tickEvents_ = 0;
+    
+    for (int i = 0; i < units_.size(); i++) {
+        markStale(i);
+    }
+    // Change ticks from the abandoned timeline don't apply to this one
+    deltaBaseTick_ = state_.tick;
+    logsDirty_ = true;
+    spatialIndexDirty_ = true;
+    for (TeamFlow& flow : flowFields_) {
+        flow.tick = -1;
+    }
+    return true;
+}
+
+bool BattleEngine::setTerrain(const std::vector<std::vector<TerrainCell>>& terrain) {
+    TerrainGrid grid;
+    if (!TerrainGrid::fromRows(terrain, grid)) return false;
+    setTerrainGrid(std::move(grid));
+    return true;
+}
+
+void BattleEngine::setTerrainGrid(TerrainGrid terrain) {
+    state_.terrain = std::move(terrain);
+    moveCosts_.reset();
 }
 
 void BattleEngine::addUnit(const Unit& unit) {
+    int slot = units_.add(unit);
+    
+    syncUnitView();
     state_.units.push_back(unit);
+    units_.refresh(slot, state_.units.back());
+    staleFlags_.push_back(0);
+    changedTick_.push_back(state_.tick);
+    // A client synced at this tick hasn't seen the unit either
+    deltaBaseTick_ = state_.tick + 1;
+    stateGeneration_++;
+    
+    spatialIndexDirty_ = true;
+}
+
+bool BattleEngine::addUnitsPacked(const std::int32_t* records, int count,
+                                  const std::vector<std::string>& names) {
+    using namespace PackedUnitLayout;
+    const int nameCount = static_cast<int>(names.size());
+    auto validName = [nameCount](std::int32_t index) { return index >= 0 && index < nameCount; };
+    
+    if (count < 0 || (count > 0 && !records)) return false;
+    for (int i = 0; i < count; i++) {
+        const std::int32_t* r = records + i * kPackedUnitWords;
+        if (!validName(r[Id]) || !validName(r[Team]) || !validName(r[Type])) {
+            return false;
+        }
+    }
+    
+    units_.reserve(units_.size() + count);
+    state_.units.reserve(state_.units.size() + count);
+    
+    Unit unit;
+    for (int i = 0; i < count; i++) {
+        const std::int32_t* r = records + i * kPackedUnitWords;
+        unit.id = names[r[Id]];
+        unit.team = names[r[Team]];
+        unit.type = names[r[Type]];
+        unit.position = Position(r[X], r[Y]);
+        unit.health = r[Health];
+        unit.maxHealth = r[MaxHealth] > 0 ? r[MaxHealth] : r[Health];
+        unit.attack = r[Attack];
+        unit.defense = r[Defense];
+        unit.speed = r[Speed];
+        unit.range = r[Range];
+        addUnit(unit);
+    }
+    return true;
+}
+
+bool BattleEngine::setTerrainPacked(const std::uint8_t* cells, int width, int height,
+                                    const std::vector<TerrainCell>& palette) {
+    TerrainGrid terrain;
+    if (!TerrainGrid::fromPacked(cells, width, height, palette, terrain)) return false;
+    setTerrainGrid(std::move(terrain));
+    return true;
 }
 
 void BattleEngine::setAICallback(const std::string& team, AIDecisionCallback callback) {
-    aiCallbacks_[team] = callback;
+    int handle = units_.internTeam(team);
+    if (aiCallbacks_.use_count() > 1) {
+        aiCallbacks_ = std::make_shared<std::vector<AIDecisionCallback>>(*aiCallbacks_);
+    }
+    if (handle >= static_cast<int>(aiCallbacks_->size())) {
+        aiCallbacks_->resize(handle + 1);
+    }
+    (*aiCallbacks_)[handle] = callback;
+}
+
+void BattleEngine::setTeamDecisionCallback(const std::string& team, TeamDecisionCallback callback) {
+    int handle = units_.internTeam(team);
+    if (teamCallbacks_.use_count() > 1) {
+        teamCallbacks_ = std::make_shared<std::vector<TeamDecisionCallback>>(*teamCallbacks_);
+    }
+    if (handle >= static_cast<int>(teamCallbacks_->size())) {
+        teamCallbacks_->resize(handle + 1);
+    }
+    (*teamCallbacks_)[handle] = callback;
+}
+
+bool BattleEngine::setTeamStrategy(const std::string& team, const std::string& source,
+                                   std::string* error) {
+    std::shared_ptr<Strategy> strategy;
+    if (source.find_first_not_of(" \t\r\n") != std::string::npos) {
+        strategy = std::make_shared<Strategy>();
+        std::string message;
+        if (!Strategy::compile(source, *strategy, message)) {
+            if (error) *error = message;
+            return false;
+        }
+    }
+    int handle = units_.internTeam(team);
+    if (handle >= static_cast<int>(strategies_.size())) {
+        strategies_.resize(handle + 1);
+    }
+    strategies_[handle] = strategy;
+    if (strategy && handle < static_cast<int>(policies_.size())) {
+        policies_[handle].policy = TeamPolicy::None;
+    }
+    return true;
+}
+
+void BattleEngine::setTeamPolicy(const std::string& team, TeamPolicy policy,
+                                 const PolicyParams& params) {
+    int handle = units_.internTeam(team);
+    if (handle >= static_cast<int>(policies_.size())) {
+        policies_.resize(handle + 1, TeamPolicySlot{TeamPolicy::None, PolicyParams()});
+    }
+    policies_[handle] = TeamPolicySlot{policy, params};
+    if (policy != TeamPolicy::None && handle < static_cast<int>(strategies_.size())) {
+        strategies_[handle].reset();
+    }
+}
+
+bool BattleEngine::setTeamPolicy(const std::string& team, const std::string& name,
+                                 const PolicyParams& params) {
+    TeamPolicy policy;
+    if (!parseTeamPolicy(name, policy)) return false;
+    setTeamPolicy(team, policy, params);
+    return true;
+}
+
+void BattleEngine::setCallbackKey(const std::string& team, const std::string& key) {
+    int handle = units_.internTeam(team);
+    if (handle >= static_cast<int>(callbackKeys_.size())) {
+        callbackKeys_.resize(handle + 1);
+    }
+    callbackKeys_[handle] = key;
+}
+
+bool BattleEngine::inputHash(Hash128& out) const {
+    Hasher128 hash;
+    hash.add(std::string("BattleEngine inputs v1"));
+    hash.add(gridWidth_);
+    hash.add(gridHeight_);
+    hash.add(maxTicks_);
+    hash.add(static_cast<int>(tickMode_));
+    hash.add(seed_);
+    hash.add(strategyBudget_);
+    hash.add(static_cast<std::uint64_t>(events_.mask()));
+    hash.add(events_.capacity());
+    
+    // Terrain row-major, palette indices renumbered by first appearance
+    const TerrainGrid& terrain = state_.terrain.grid();
+    hash.add(terrain.width());
+    hash.add(terrain.height());
+    int canonical[TerrainGrid::kMaxPalette];
+    std::fill(canonical, canonical + TerrainGrid::kMaxPalette, -1);
+    std::vector<int> order;
+    for (int y = 0; y < terrain.height(); y++) {
+        for (int x = 0; x < terrain.width(); x++) {
+            const int index = terrain.paletteIndex(x, y);
+            if (canonical[index] < 0) {
+                canonical[index] = static_cast<int>(order.size());
+                order.push_back(index);
+            }
+            hash.add(canonical[index]);
+        }
+    }
+    for (int index : order) {
+        hash.add(terrain.palette()[index].type);
+        hash.add(terrain.palette()[index].moveCost);
+    }
+    
+    hash.add(units_.size());
+    for (int i = 0; i < units_.size(); i++) {
+        const UnitStore::ColdData& cold = units_.cold(i);
+        hash.add(cold.id);
+        hash.add(units_.teamName(i));
+        hash.add(units_.typeName(i));
+        hash.add(cold.targetId);
+        hash.add(cold.maxHealth);
+        hash.add(units_.posX[i]);
+        hash.add(units_.posY[i]);
+        hash.add(units_.health[i]);
+        hash.add(units_.attack[i]);
+        hash.add(units_.defense[i]);
+        hash.add(units_.speed[i]);
+        hash.add(units_.range[i]);
+        hash.add(units_.cooldown[i]);
+        hash.add(units_.isAlive(i));
+    }
+
+    // initialize() restarts at tick 0 but keeps the paths units are
+    // following, which steer their next moves (see pathMove)
+    for (size_t i = 0; i < unitPaths_.size(); i++) {
+        const UnitPath& path = unitPaths_[i];
+        if (path.next >= path.cells.size()) continue;
+        hash.add(static_cast<std::uint64_t>(i));
+        hash.add(path.goal);
+        hash.add(path.at);
+        hash.add(static_cast<std::uint64_t>(path.cells.size() - path.next));
+        for (size_t c = path.next; c < path.cells.size(); c++) hash.add(path.cells[c]);
+    }
+    hash.add(-1);
+
+    // Teams by name, so the order they were first mentioned doesn't matter
+    std::vector<std::pair<std::string, int>> teams;
+    for (int t = 0; t < units_.teams.size(); t++) {
+        teams.emplace_back(units_.teams.name(t), t);
+    }
+    std::sort(teams.begin(), teams.end());
+    for (const auto& entry : teams) {
+        const int team = entry.second;
+        const std::string key = team < static_cast<int>(callbackKeys_.size()) ? callbackKeys_[team] : "";
+        const bool callbacks = teamBatchCallback(team) || teamCallback(team);
+        if (callbacks && key.empty() && units_.aliveCount(team) > 0 && !teamStrategy(team) && !teamPolicy(team)) {
+            return false;
+        }
+        hash.add(entry.first);
+        if (const Strategy* strategy = teamStrategy(team)) {
+            hash.add(1);
+            hash.add(static_cast<std::uint64_t>(strategy->code().size()));
+            for (std::uint32_t word : strategy->code()) hash.add(static_cast<std::uint64_t>(word));
+            for (double constant : strategy->constants()) hash.add(constant);
+        } else if (const TeamPolicySlot* policy = teamPolicy(team)) {
+            hash.add(2);
+            hash.add(static_cast<int>(policy->policy));
+            hash.add(policy->params.retreatHealth);
+            hash.add(policy->params.engageRange);
+            hash.add(policy->params.leash);
+            hash.add(policy->params.flankOffset);
+        } else if (callbacks) {
+            hash.add(teamBatchCallback(team) ? 3 : 4);
+            hash.add(key);
+        } else {
+            hash.add(0);
+        }
+    }
+    out = hash.finish();
+    return true;
+}
+
+void BattleEngine::setSpatialIndexEnabled(bool enabled) {
+    spatialIndexEnabled_ = enabled;
+    spatialIndexDirty_ = true;
+}
+
+void BattleEngine::setDecisionThreads(int threads) {
+    if (threads == 1 || threads == 0) {
+        decisionPool_.reset();
+    } else {
+        decisionPool_ = std::make_shared<ThreadPool>(threads < 0 ? -1 : threads - 1);
+    }
+}
+
+void BattleEngine::setEventCapture(bool enabled) {
+    events_.setMask(enabled ? EventLog::kDefaultMask : 0);
+}
+
+void BattleEngine::setEventLogCapacity(int capacity) {
+    events_.setCapacity(capacity);
+    logsDirty_ = true;
+}
+
+void BattleEngine::rebuildSpatialIndex() {
+    int cellSize = SpatialGrid::suggestCellSize(gridWidth_, gridHeight_, units_.size());
+    grid_.reset(gridWidth_, gridHeight_, cellSize);
+    
+    for (int i = 0; i < units_.size(); i++) {
+        if (units_.isAlive(i)) {
+            grid_.insert(i, units_.team[i], units_.posX[i], units_.posY[i]);
+        }
+    }
+    spatialIndexDirty_ = false;
+}
+
+void BattleEngine::markStale(int unit) {
+    changedTick_[unit] = state_.tick;
+    if (!staleFlags_[unit]) {
+        staleFlags_[unit] = 1;
+        staleUnits_.push_back(unit);
+    }
+}
+
+void BattleEngine::syncUnitView() const {
+    if (!viewBuilt_) {
+        state_.units.clear();
+        state_.units.reserve(units_.size());
+        for (int i = 0; i < units_.size(); i++) {
+            state_.units.push_back(units_.materialize(i));
+        }
+        viewBuilt_ = true;
+    }
+    for (int i : staleUnits_) {
+        units_.refresh(i, state_.units[i]);
+        staleFlags_[i] = 0;
+    }
+    staleUnits_.clear();
+}
+
+const BattleState& BattleEngine::getState() const {
+    syncUnitView();
+    if (logsDirty_) {
+        formatLogs();
+    }
+    return state_;
+}
+
+StateDelta BattleEngine::getStateDelta(int sinceTick) const {
+    StateDelta delta;
+    delta.sinceTick = sinceTick;
+    delta.tick = state_.tick;
+    delta.status = state_.status;
+    delta.winner = state_.winner;
+    
+    // Events must be complete too: if the ring has overwritten anything
+    // newer than sinceTick, the client can't be brought up to date
+    bool eventsLost = events_.totalRecorded() > static_cast<std::uint64_t>(events_.size()) &&
+                      (events_.size() == 0 || events_.at(0).tick > sinceTick);
+    
+    delta.full = sinceTick < deltaBaseTick_ || sinceTick > state_.tick || eventsLost;
+    if (delta.full) {
+        syncUnitView();
+        delta.snapshot = state_.units;
+    } else {
+        for (int i = 0; i < units_.size(); i++) {
+            if (changedTick_[i] > sinceTick) {
+                UnitDelta unit;
+                unit.index = i;
+                unit.position = Position(units_.posX[i], units_.posY[i]);
+                unit.health = units_.health[i];
+                unit.alive = units_.isAlive(i);
+                unit.cooldown = units_.cooldown[i];
+                delta.units.push_back(unit);
+            }
+        }
+    }
+    
+    for (int i = 0; i < events_.size(); i++) {
+        const BattleEvent& event = events_.at(i);
+        if (delta.full || event.tick > sinceTick) {
+            delta.logs.push_back(formatEvent(event));
+        }
+    }
+    return delta;
+}
+
+std::uintptr_t BattleEngine::getStateBuffer() const {
+    using namespace StateBufferLayout;
+    auto address = [](const void* p) { return reinterpret_cast<std::intptr_t>(p); };
+    
+    stateHeader_[Magic] = kMagic;
+    stateHeader_[Version] = kVersion;
+    stateHeader_[Generation] = stateGeneration_;
+    stateHeader_[Tick] = state_.tick;
+    stateHeader_[Status] = static_cast<std::intptr_t>(state_.status);
+    stateHeader_[UnitCount] = units_.size();
+    stateHeader_[PosXColumn] = address(units_.posX.data());
+    stateHeader_[PosYColumn] = address(units_.posY.data());
+    stateHeader_[HealthColumn] = address(units_.health.data());
+    stateHeader_[CooldownColumn] = address(units_.cooldown.data());
+    stateHeader_[TeamColumn] = address(units_.team.data());
+    stateHeader_[AliveColumn] = address(units_.alive.data());
+    return reinterpret_cast<std::uintptr_t>(stateHeader_);
 }
 
 bool BattleEngine::initialize() {
-    state_.status = "initialized";
+    state_.status = BattleStatus::Initialized;
     state_.tick = 0;
     state_.winner = "";
     state_.logs.clear();
+    events_.clear();
+    counters_ = Counters();
+    
+    // Ticks restart at 0, so earlier change ticks are meaningless
+    std::fill(changedTick_.begin(), changedTick_.end(), 0);
+    deltaBaseTick_ = 0;
+    
+    if (spatialIndexEnabled_) {
+        rebuildSpatialIndex();
+    }
+    for (TeamFlow& flow : flowFields_) {
+        flow.tick = -1;
+    }
     
-    addLog("Battle initialized");
+    recordEvent(EventType::Initialized, -1, -1, 0);
+    if (recorder_) {
+        recorder_->begin(*this);
+    }
     return true;
 }
 
 void BattleEngine::tick() {
-    if (state_.status != "running" && state_.status != "initialized") {
+    if (state_.status != BattleStatus::Running && state_.status != BattleStatus::Initialized) {
         return;
     }
     
-    state_.status = "running";
+#if BATTLE_PERF_COUNTERS
+    if (perf_.enabled()) perf_.beginTick(state_.tick + 1);
+#endif
+    runTick();
+    if (recorder_) {
+        PERF_PHASE(perf_, TickPhase::Logging);
+        recorder_->record(*this);
+    }
+#if BATTLE_PERF_COUNTERS
+    if (perf_.enabled()) perf_.endTick();
+#endif
+}
+
+void BattleEngine::runTick() {
+    state_.status = BattleStatus::Running;
     state_.tick++;
+    tickEvents_ = 0;
     
-    // Check win condition
-    if (checkWinCondition()) {
-        state_.status = "finished";
-        return;
+    if (spatialIndexEnabled_ && spatialIndexDirty_) {
+        PERF_PHASE(perf_, TickPhase::Index);
+        rebuildSpatialIndex();
     }
     
-    // Check max ticks
-    if (state_.tick >= maxTicks_) {
-        state_.status = "finished";
-        state_.winner = "draw";
-        addLog("Battle ended in draw - max ticks reached");
-        return;
+    {
+        PERF_PHASE(perf_, TickPhase::WinCheck);
+        // Check win condition
+        if (checkWinCondition()) {
+            state_.status = BattleStatus::Finished;
+            return;
+        }
+        
+        // Check max ticks
+        if (state_.tick >= maxTicks_) {
+            state_.status = BattleStatus::Finished;
+            state_.winner = "draw";
+            recordEnd(BattleOutcome::DrawMaxTicks);
+            return;
+        }
     }
     
-    // Process each alive unit
-    for (auto& unit : state_.units) {
-        if (unit.isAlive()) {
-            processUnit(unit);
+    const int count = units_.size();
+    {
+        PERF_PHASE(perf_, TickPhase::Decide);
+        runTeamCallbacks();
+    }
+    if (tickMode_ == TickMode::TwoPhase) {
+        runTwoPhaseTick();
+    } else {
+        // Process each alive unit
+        for (int i = 0; i < count; i++) {
+            if (units_.isAlive(i)) {
+                processUnit(i);
+            }
         }
     }
     
     // Update cooldowns
-    for (auto& unit : state_.units) {
-        if (unit.cooldown > 0) {
-            unit.cooldown--;
+    PERF_PHASE(perf_, TickPhase::Cooldowns);
+    int* cooldown = units_.cooldown.data();
+    for (int i = 0; i < count; i++) {
+        if (cooldown[i] > 0) {
+            cooldown[i]--;
+            markStale(i);
         }
     }
 }
@@ -102,26 +744,425 @@ void BattleEngine::run() {
     }
 }
 
+AdvanceSummary BattleEngine::advance(int maxTicks, std::uint32_t stopEvents) {
+    return advanceUntil(nullptr, maxTicks, stopEvents);
+}
+
+AdvanceSummary BattleEngine::advanceUntil(const std::function<bool(const BattleEngine&)>& predicate,
+                                          int maxTicks, std::uint32_t stopEvents) {
+    if (state_.status == BattleStatus::Idle) {
+        initialize();
+    }
+    
+    AdvanceSummary summary;
+    summary.startTick = state_.tick;
+    const Counters before = counters_;
+    
+    while (summary.ticks < maxTicks) {
+        if (isFinished()) {
+            summary.stoppedBy = AdvanceStop::Finished;
+            break;
+        }
+        tick();
+        summary.ticks++;
+        
+        if (isFinished()) {
+            summary.stoppedBy = AdvanceStop::Finished;
+            break;
+        }
+        if (tickEvents_ & stopEvents) {
+            summary.stoppedBy = AdvanceStop::Event;
+            break;
+        }
+        if (predicate && predicate(*this)) {
+            summary.stoppedBy = AdvanceStop::Predicate;
+            break;
+        }
+    }
+    
+    summary.endTick = state_.tick;
+    summary.moves = counters_.moves - before.moves;
+    summary.attacks = counters_.attacks - before.attacks;
+    summary.damage = counters_.damage - before.damage;
+    summary.kills = counters_.kills - before.kills;
+    return summary;
+}
+
 void BattleEngine::reset() {
     state_ = BattleState();
-    state_.terrain.resize(gridHeight_, std::vector<TerrainCell>(gridWidth_));
+    state_.terrain = TerrainGrid(gridWidth_, gridHeight_);
+    units_.clear();
+    events_.clear();
+    logsDirty_ = false;
+    counters_ = Counters();
+    staleUnits_.clear();
+    staleFlags_.clear();
+    viewBuilt_ = true;
+    changedTick_.clear();
+    deltaBaseTick_ = 0;
+    stateGeneration_++;
+    grid_.clear();
+    spatialIndexDirty_ = true;
+    moveCosts_.reset();
+    flowFields_.clear();
+    unitPaths_.clear();
 }
 
-void BattleEngine::processUnit(Unit& unit) {
-    if (unit.cooldown > 0) return;
+void BattleEngine::processUnit(int unit) {
+    if (units_.cooldown[unit] > 0) return;
     
-    // Get AI decision
+    // Per-unit callbacks read the unit view; everything else reads the columns
+    const int team = units_.team[unit];
     Action action;
-    auto it = aiCallbacks_.find(unit.team);
-    if (it != aiCallbacks_.end()) {
-        action = it->second(unit, state_);
+    {
+        PERF_PHASE_UNTRACED(perf_, TickPhase::Decide);
+        if (!teamStrategy(team) && !teamPolicy(team) && !teamBatchCallback(team) && teamCallback(team)) {
+            syncUnitView();
+        }
+        action = decide(unit);
     }
-    
-    // Execute action
+    PERF_PHASE_UNTRACED(perf_, action.type == Action::MOVE ? TickPhase::Move : TickPhase::Attack);
     executeAction(unit, action);
 }
 
-void BattleEngine::executeAction(Unit& unit, const Action& action) {
+// Only reads engine state, so the decision phase can run it in parallel;
+// callbacks expect the unit view to be in sync
+Action BattleEngine::decide(int unit) {
+    PERF_COUNT(perf_, Decisions, 1);
+    const int team = units_.team[unit];
+    if (const Strategy* strategy = teamStrategy(team)) {
+        return strategyAction(unit, *strategy);
+    }
+    if (const TeamPolicySlot* policy = teamPolicy(team)) {
+        return policyAction(unit, *policy);
+    }
+    if (teamBatchCallback(team)) {
+        return batchActions_[unit];
+    }
+    if (const AIDecisionCallback* callback = teamCallback(team)) {
+        PERF_COUNT(perf_, CallbackInvocations, 1);
+        return (*callback)(state_.units[unit], state_);
+    }
+    return Action();
+}
+
+Action BattleEngine::strategyAction(int unit, const Strategy& strategy) {
+    int nearest = -2;   // closest enemy, looked up on first use
+    const StrategyDecision decision = strategy.run(
+        [&](StrategySensor sensor, double arg) { return strategySense(unit, sensor, arg, nearest); },
+        strategyBudget_);
+    
+    Action action;
+    switch (decision.action) {
+        case StrategyAction::AttackNearest:
+            action.type = Action::ATTACK;
+            break;
+        case StrategyAction::AttackWeakest: {
+            action.type = Action::ATTACK;
+            const int weakest = weakestEnemyWithin(unit, units_.range[unit]);
+            if (weakest >= 0) {
+                action.targetUnitId = units_.cold(weakest).id;
+            }
+            break;
+        }
+        case StrategyAction::MoveUp: action.type = Action::MOVE; action.direction = "up"; break;
+        case StrategyAction::MoveDown: action.type = Action::MOVE; action.direction = "down"; break;
+        case StrategyAction::MoveLeft: action.type = Action::MOVE; action.direction = "left"; break;
+        case StrategyAction::MoveRight: action.type = Action::MOVE; action.direction = "right"; break;
+        case StrategyAction::MoveForward: action.type = Action::MOVE; action.direction = "forward"; break;
+        case StrategyAction::MoveAdvance: action.type = Action::MOVE; action.direction = "advance"; break;
+        case StrategyAction::MoveToEnemy:
+        case StrategyAction::Retreat: {
+            if (nearest == -2) nearest = findClosestEnemy(unit);
+            if (nearest < 0) break;
+            action.type = Action::MOVE;
+            const int ex = units_.posX[nearest];
+            const int ey = units_.posY[nearest];
+            if (decision.action == StrategyAction::MoveToEnemy) {
+                action.targetPosition = Position(ex, ey);
+            } else {
+                action.direction = directionAway(unit, nearest);
+            }
+            break;
+        }
+        case StrategyAction::Idle:
+        default:
+            break;
+    }
+    return action;
+}
+
+// Gather each batched team's ready units and collect its actions by slot,
+// before any unit acts this tick
+void BattleEngine::runTeamCallbacks() {
+    const auto& callbacks = *teamCallbacks_;
+    if (callbacks.empty()) return;
+    
+    const int teams = static_cast<int>(callbacks.size());
+    if (static_cast<int>(batchScratch_.size()) < teams) {
+        batchScratch_.resize(teams);
+    }
+    for (TeamBatchScratch& scratch : batchScratch_) {
+        scratch.slots.clear();
+        scratch.x.clear();
+        scratch.y.clear();
+        scratch.health.clear();
+        scratch.attack.clear();
+        scratch.range.clear();
+        scratch.speed.clear();
+    }
+    
+    const int count = units_.size();
+    for (int i = 0; i < count; i++) {
+        const int team = units_.team[i];
+        if (team >= teams || !callbacks[team] || !units_.isAlive(i) || units_.cooldown[i] > 0) continue;
+        TeamBatchScratch& scratch = batchScratch_[team];
+        scratch.slots.push_back(i);
+        scratch.x.push_back(units_.posX[i]);
+        scratch.y.push_back(units_.posY[i]);
+        scratch.health.push_back(units_.health[i]);
+        scratch.attack.push_back(units_.attack[i]);
+        scratch.range.push_back(units_.range[i]);
+        scratch.speed.push_back(units_.speed[i]);
+    }
+    
+    if (static_cast<int>(batchActions_.size()) < count) {
+        batchActions_.resize(count);
+    }
+    for (int team = 0; team < teams; team++) {
+        TeamBatchScratch& scratch = batchScratch_[team];
+        // Strategies and policies take precedence
+        if (scratch.slots.empty() || teamStrategy(team) || teamPolicy(team)) continue;
+        
+        TeamBatch batch;
+        batch.tick = state_.tick;
+        batch.count = static_cast<int>(scratch.slots.size());
+        batch.slots = scratch.slots.data();
+        batch.x = scratch.x.data();
+        batch.y = scratch.y.data();
+        batch.health = scratch.health.data();
+        batch.attack = scratch.attack.data();
+        batch.range = scratch.range.data();
+        batch.speed = scratch.speed.data();
+        batch.units = units_.columns();
+        batch.unitHealth = units_.health.data();
+        
+        scratch.actions.assign(batch.count, Action());
+        PERF_COUNT(perf_, CallbackInvocations, 1);
+        callbacks[team](batch, scratch.actions.data());
+        for (int k = 0; k < batch.count; k++) {
+            batchActions_[scratch.slots[k]] = std::move(scratch.actions[k]);
+        }
+    }
+}
+
+// Straight away from `from` along the longer axis
+const char* BattleEngine::directionAway(int unit, int from) const {
+    const int dx = units_.posX[unit] - units_.posX[from];
+    const int dy = units_.posY[unit] - units_.posY[from];
+    if (std::abs(dx) >= std::abs(dy)) {
+        return dx >= 0 ? "right" : "left";
+    }
+    return dy > 0 ? "down" : "up";
+}
+
+// Lowest-health enemy within `radius` (the first in slot order on ties), or -1
+int BattleEngine::weakestEnemyWithin(int unit, int radius) {
+    int weakest = -1;
+    for (int enemy : getEnemiesInRange(unit, radius)) {
+        if (weakest < 0 || units_.health[enemy] < units_.health[weakest]) {
+            weakest = enemy;
+        }
+    }
+    return weakest;
+}
+
+Action BattleEngine::policyAction(int unit, const TeamPolicySlot& slot) {
+    Action action;
+    const int nearest = findClosestEnemy(unit);
+    if (nearest < 0) return action;
+    
+    const PolicyParams& params = slot.params;
+    const Position self(units_.posX[unit], units_.posY[unit]);
+    const Position enemy(units_.posX[nearest], units_.posY[nearest]);
+    const double distance = self.distanceTo(enemy);
+    const int range = units_.range[unit];
+    const int engageRange = static_cast<int>(std::max(0.0, std::min(params.engageRange, 1e6)));
+    
+    auto attack = [&](int target) {
+        action.type = Action::ATTACK;
+        action.targetUnitId = units_.cold(target).id;
+        return action;
+    };
+    // Weakest enemy the unit can hit now (nearest is in range whenever this is called)
+    auto attackInRange = [&]() {
+        const int weakest = weakestEnemyWithin(unit, range);
+        return attack(weakest >= 0 ? weakest : nearest);
+    };
+    auto moveTo = [&](const Position& target) {
+        action.type = Action::MOVE;
+        action.targetPosition = Position(std::max(0, std::min(gridWidth_ - 1, target.x)),
+                                         std::max(0, std::min(gridHeight_ - 1, target.y)));
+        return action;
+    };
+    auto stepAway = [&]() {
+        action.type = Action::MOVE;
+        action.direction = directionAway(unit, nearest);
+        return action;
+    };
+    
+    switch (slot.policy) {
+        case TeamPolicy::FocusFire: {
+            const int inRange = weakestEnemyWithin(unit, range);
+            if (inRange >= 0) return attack(inRange);
+            const int weakest = weakestEnemyWithin(unit, engageRange);
+            if (weakest >= 0) return moveTo(Position(units_.posX[weakest], units_.posY[weakest]));
+            return moveTo(enemy);
+        }
+        case TeamPolicy::Kite: {
+            // Back off only from enemies we outrange, and only while they
+            // could close in and strike next tick
+            const int threat = units_.range[nearest] + units_.speed[nearest];
+            if (range > units_.range[nearest] && distance <= threat) return stepAway();
+            if (distance <= range) return attackInRange();
+            return moveTo(enemy);
+        }
+        case TeamPolicy::HoldFormation: {
+            const UnitStore::ColdData& cold = units_.cold(unit);
+            const Position anchor(cold.startX, cold.startY);
+            if (distance <= range) return attackInRange();
+            if (self.distanceTo(anchor) > params.leash) return moveTo(anchor);
+            if (enemy.distanceTo(anchor) <= params.leash + range) return moveTo(enemy);
+            return action;
+        }
+        case TeamPolicy::Flank: {
+            if (distance <= range) return attackInRange();
+            if (distance <= params.flankOffset) return moveTo(enemy);
+            // Aim beside the enemy, across the axis of approach, on the side
+            // the unit is already on
+            const int offset = static_cast<int>(std::max(0.0, std::min(params.flankOffset, 1e6)));
+            const int dx = enemy.x - self.x;
+            const int dy = enemy.y - self.y;
+            if (std::abs(dx) >= std::abs(dy)) {
+                const int side = dy > 0 ? -1 : dy < 0 ? 1 : (unit % 2 ? 1 : -1);
+                return moveTo(Position(enemy.x, enemy.y + side * offset));
+            }
+            const int side = dx > 0 ? -1 : dx < 0 ? 1 : (unit % 2 ? 1 : -1);
+            return moveTo(Position(enemy.x + side * offset, enemy.y));
+        }
+        case TeamPolicy::RetreatAndHeal: {
+            const int health = units_.health[unit];
+            const int maxHealth = units_.cold(unit).maxHealth;
+            if (distance > params.engageRange && health < maxHealth) {
+                action.type = Action::HEAL;
+                return action;
+            }
+            if (health < params.retreatHealth * maxHealth) return stepAway();
+            if (distance <= range) return attackInRange();
+            return moveTo(enemy);
+        }
+        case TeamPolicy::None:
+        default:
+            return action;
+    }
+}
+
+double BattleEngine::strategySense(int unit, StrategySensor sensor, double arg, int& nearest) {
+    const bool needsEnemy = sensor == StrategySensor::EnemyDistance || sensor == StrategySensor::EnemyHealth ||
+                            sensor == StrategySensor::EnemyX || sensor == StrategySensor::EnemyY;
+    if (needsEnemy && nearest == -2) {
+        nearest = findClosestEnemy(unit);
+    }
+    const int team = units_.team[unit];
+    const int x = units_.posX[unit];
+    const int y = units_.posY[unit];
+    const int radius = static_cast<int>(std::max(0.0, std::min(arg, 1e6)));
+    
+    switch (sensor) {
+        case StrategySensor::Health: return units_.health[unit];
+        case StrategySensor::MaxHealth: return units_.cold(unit).maxHealth;
+        case StrategySensor::Attack: return units_.attack[unit];
+        case StrategySensor::Defense: return units_.defense[unit];
+        case StrategySensor::Speed: return units_.speed[unit];
+        case StrategySensor::Range: return units_.range[unit];
+        case StrategySensor::Cooldown: return units_.cooldown[unit];
+        case StrategySensor::X: return x;
+        case StrategySensor::Y: return y;
+        case StrategySensor::Tick: return state_.tick;
+        case StrategySensor::EnemyDistance:
+            return nearest < 0 ? Strategy::kNoEnemy
+                               : Position(x, y).distanceTo(Position(units_.posX[nearest], units_.posY[nearest]));
+        case StrategySensor::EnemyHealth: return nearest < 0 ? 0 : units_.health[nearest];
+        case StrategySensor::EnemyX: return nearest < 0 ? -1 : units_.posX[nearest];
+        case StrategySensor::EnemyY: return nearest < 0 ? -1 : units_.posY[nearest];
+        case StrategySensor::EnemyCount: {
+            int enemies = 0;
+            for (int t = 0; t < static_cast<int>(units_.teamAlive.size()); t++) {
+                if (t != team) enemies += units_.teamAlive[t];
+            }
+            return enemies;
+        }
+        case StrategySensor::AllyCount: return units_.aliveCount(team) - 1;
+        case StrategySensor::TerrainCost: {
+            const TerrainGrid& terrain = state_.terrain.grid();
+            return terrain.inBounds(x, y) ? terrain.moveCost(x, y) : 1.0;
+        }
+        case StrategySensor::AlliesWithin: return static_cast<double>(getAlliesInRange(unit, radius).size());
+        case StrategySensor::EnemiesWithin: return static_cast<double>(getEnemiesInRange(unit, radius).size());
+    }
+    return 0.0;
+}
+
+void BattleEngine::runTwoPhaseTick() {
+    // Phase 1: decide every ready unit's action against the same snapshot
+    const int ready = decideReadyUnits();
+    
+    // Phase 2: resolve moves, then attacks and heals, both in slot order
+    {
+        PERF_PHASE(perf_, TickPhase::Move);
+        for (int k = 0; k < ready; k++) {
+            if (decisions_[k].type == Action::MOVE) {
+                handleMove(readyUnits_[k], decisions_[k]);
+            }
+        }
+    }
+    PERF_PHASE(perf_, TickPhase::Attack);
+    for (int k = 0; k < ready; k++) {
+        if (decisions_[k].type == Action::ATTACK) {
+            handleAttack(readyUnits_[k], decisions_[k]);
+        } else if (decisions_[k].type == Action::HEAL) {
+            handleHeal(readyUnits_[k], decisions_[k]);
+        }
+    }
+}
+
+int BattleEngine::decideReadyUnits() {
+    PERF_PHASE(perf_, TickPhase::Decide);
+    syncUnitView();
+    readyUnits_.clear();
+    for (int i = 0; i < units_.size(); i++) {
+        if (units_.isAlive(i) && units_.cooldown[i] == 0 && hasDecisionMaker(units_.team[i])) {
+            readyUnits_.push_back(i);
+        }
+    }
+    decisions_.assign(readyUnits_.size(), Action());
+    
+    auto decideRange = [&](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            decisions_[k] = decide(readyUnits_[k]);
+        }
+    };
+    
+    const int ready = static_cast<int>(readyUnits_.size());
+    if (decisionPool_) {
+        decisionPool_->parallelFor(ready, kDecisionGrain, decideRange);
+    } else {
+        decideRange(0, ready);
+    }
+    return ready;
+}
+
+void BattleEngine::executeAction(int unit, const Action& action) {
     switch (action.type) {
         case Action::MOVE:
             handleMove(unit, action);
@@ -129,33 +1170,40 @@ void BattleEngine::executeAction(Unit& unit, const Action& action) {
         case Action::ATTACK:
             handleAttack(unit, action);
             break;
+        case Action::HEAL:
+            handleHeal(unit, action);
+            break;
         case Action::IDLE:
         default:
             break;
     }
 }
 
-void BattleEngine::handleMove(Unit& unit, const Action& action) {
-    Position newPos = unit.position;
+void BattleEngine::handleMove(int unit, const Action& action) {
+    const Position current(units_.posX[unit], units_.posY[unit]);
+    const int speed = units_.speed[unit];
+    Position newPos = current;
     
     if (action.targetPosition.x >= 0 && action.targetPosition.y >= 0) {
         // Move towards target
-        int dx = action.targetPosition.x - unit.position.x;
-        int dy = action.targetPosition.y - unit.position.y;
-        double distance = std::sqrt(dx * dx + dy * dy);
-        
-        if (distance > 0) {
-            newPos.x = unit.position.x + static_cast<int>((dx / distance) * unit.speed);
-            newPos.y = unit.position.y + static_cast<int>((dy / distance) * unit.speed);
-        }
+        pathMove(unit, action.targetPosition, newPos);
     } else if (!action.direction.empty()) {
         // Move in direction
-        if (action.direction == "up") newPos.y -= unit.speed;
-        else if (action.direction == "down") newPos.y += unit.speed;
-        else if (action.direction == "left") newPos.x -= unit.speed;
-        else if (action.direction == "right") newPos.x += unit.speed;
+        if (action.direction == "up") newPos.y -= speed;
+        else if (action.direction == "down") newPos.y += speed;
+        else if (action.direction == "left") newPos.x -= speed;
+        else if (action.direction == "right") newPos.x += speed;
         else if (action.direction == "forward") {
-            newPos.x += (unit.team == "teamA") ? unit.speed : -unit.speed;
+            newPos.x += (units_.team[unit] == teamA_) ? speed : -speed;
+        }
+        else if (action.direction == "advance") {
+            flowMove(unit, newPos);
+        }
+    } else if (!action.targetUnitId.empty()) {
+        // Chase a unit
+        int target = findUnitById(action.targetUnitId);
+        if (target >= 0) {
+            pathMove(unit, Position(units_.posX[target], units_.posY[target]), newPos);
         }
     }
     
@@ -163,16 +1211,120 @@ void BattleEngine::handleMove(Unit& unit, const Action& action) {
     newPos.x = std::max(0, std::min(gridWidth_ - 1, newPos.x));
     newPos.y = std::max(0, std::min(gridHeight_ - 1, newPos.y));
     
-    // Check collision
-    if (!checkCollision(newPos, unit.id)) {
-        unit.position = newPos;
+    // Check collision; a blocked or waiting unit hasn't changed
+    if (!(newPos == current) && !checkCollision(newPos, unit)) {
+        units_.posX[unit] = newPos.x;
+        units_.posY[unit] = newPos.y;
+        markStale(unit);
+        if (spatialIndexEnabled_) {
+            grid_.move(unit, newPos.x, newPos.y);
+        }
+        counters_.moves++;
+        recordEvent(EventType::Move, unit, -1, 0);
     }
 }
 
-void BattleEngine::handleAttack(Unit& unit, const Action& action) {
-    if (unit.cooldown > 0) return;
+void BattleEngine::flowMove(int unit, Position& newPos) {
+    const FlowField& field = teamFlowField(units_.team[unit]);
+    auto blocked = [this, unit](int x, int y) {
+        return checkCollision(Position(x, y), unit);
+    };
     
-    Unit* target = nullptr;
+    // One cell per point of speed, checking each cell on the way
+    for (int step = 0; step < units_.speed[unit]; step++) {
+        int nx, ny;
+        if (!field.nextStep(newPos.x, newPos.y, blocked, nx, ny)) break;
+        newPos = Position(nx, ny);
+    }
+}
+
+void BattleEngine::pathMove(int unit, const Position& target, Position& newPos) {
+    const int x = newPos.x;
+    const int y = newPos.y;
+    if (x < 0 || y < 0 || x >= gridWidth_ || y >= gridHeight_) return;
+    const int from = y * gridWidth_ + x;
+    const int goal = std::max(0, std::min(gridHeight_ - 1, target.y)) * gridWidth_ +
+                     std::max(0, std::min(gridWidth_ - 1, target.x));
+    
+    const Pathfinder& paths = pathfinder();
+    if (static_cast<int>(unitPaths_.size()) < units_.size()) {
+        unitPaths_.resize(units_.size(), UnitPath{-1, -1, 0, std::vector<int>()});
+    }
+    UnitPath& path = unitPaths_[unit];
+    
+    // A far-away goal that moved within its cluster keeps the old path
+    const bool reusable = path.at == from && path.next < path.cells.size() &&
+        (path.goal == goal ||
+         (paths.clusterOf(path.goal) == paths.clusterOf(goal) &&
+          paths.clusterOf(from) != paths.clusterOf(goal)));
+    if (!reusable) {
+        path.goal = goal;
+        path.next = 0;
+        if (!paths.findPath(from, goal, path.cells)) {
+            path.cells.clear();
+        }
+    }
+    
+    // One cell per point of speed; wait if the next cell is occupied
+    for (int step = 0; step < units_.speed[unit] && path.next < path.cells.size(); step++) {
+        const int cell = path.cells[path.next];
+        const Position pos(cell % gridWidth_, cell / gridWidth_);
+        if (checkCollision(pos, unit)) break;
+        newPos = pos;
+        path.next++;
+    }
+    path.at = newPos.y * gridWidth_ + newPos.x;
+}
+
+const std::shared_ptr<const CostGrid>& BattleEngine::moveCosts() {
+    if (!moveCosts_) {
+        moveCosts_ = sharedMoveCosts(state_.terrain.grid(), gridWidth_, gridHeight_);
+    }
+    return moveCosts_;
+}
+
+const Pathfinder& BattleEngine::pathfinder() {
+    const auto& costs = moveCosts();
+    if (!pathfinder_) {
+        pathfinder_ = std::make_shared<Pathfinder>(costs);
+    } else if (pathfinder_->costs() != costs) {
+        // Forks may still be using the old one
+        if (pathfinder_.use_count() > 1) {
+            pathfinder_ = std::make_shared<Pathfinder>(*pathfinder_);
+        }
+        pathfinder_->update(costs);
+    }
+    return *pathfinder_;
+}
+
+const FlowField& BattleEngine::teamFlowField(int team) {
+    moveCosts();
+    
+    if (team >= static_cast<int>(flowFields_.size())) {
+        flowFields_.resize(team + 1, TeamFlow{FlowField(), -1});
+    }
+    TeamFlow& flow = flowFields_[team];
+    if (flow.tick != state_.tick || flow.field.empty()) {
+        // Every alive unit of another team is a goal
+        std::vector<int> goals;
+        for (int i = 0; i < units_.size(); i++) {
+            const int x = units_.posX[i];
+            const int y = units_.posY[i];
+            if (units_.isAlive(i) && units_.team[i] != team &&
+                x >= 0 && y >= 0 && x < gridWidth_ && y < gridHeight_) {
+                goals.push_back(y * gridWidth_ + x);
+            }
+        }
+        flow.field.update(moveCosts_, std::move(goals));
+        flow.tick = state_.tick;
+    }
+    return flow.field;
+}
+
+void BattleEngine::handleAttack(int unit, const Action& action) {
+    if (units_.cooldown[unit] > 0) return;
+    
+    int target = -1;
     
     if (!action.targetUnitId.empty()) {
         target = findUnitById(action.targetUnitId);
@@ -180,91 +1332,149 @@ void BattleEngine::handleAttack(Unit& unit, const Action& action) {
         target = findClosestEnemy(unit);
     }
     
-    if (target && target->isAlive()) {
-        double distance = unit.position.distanceTo(target->position);
+    if (target >= 0 && units_.isAlive(target)) {
+        Position from(units_.posX[unit], units_.posY[unit]);
+        double distance = from.distanceTo(Position(units_.posX[target], units_.posY[target]));
         
-        if (distance <= unit.range) {
+        if (distance <= units_.range[unit]) {
             // Calculate damage
-            int baseDamage = unit.attack;
-            int damageReduction = static_cast<int>(target->defense * 0.5);
+            int baseDamage = units_.attack[unit];
+            int damageReduction = static_cast<int>(units_.defense[target] * 0.5);
             int finalDamage = std::max(1, baseDamage - damageReduction);
             
-            target->takeDamage(finalDamage);
-            unit.cooldown = 3;
+            bool killed = units_.takeDamage(target, finalDamage);
+            units_.cooldown[unit] = 3;
+            markStale(unit);
+            markStale(target);
+            counters_.attacks++;
+            counters_.damage += finalDamage;
+            recordEvent(EventType::Attack, unit, target, finalDamage);
             
-            std::ostringstream log;
-            log << unit.team << " unit attacked " << target->team 
-                << " unit for " << finalDamage << " damage";
-            addLog(log.str());
-            
-            if (!target->isAlive()) {
-                std::ostringstream elimLog;
-                elimLog << target->team << " unit eliminated!";
-                addLog(elimLog.str());
+            if (killed) {
+                counters_.kills++;
+                if (spatialIndexEnabled_) {
+                    grid_.remove(target);
+                }
+                recordEvent(EventType::Kill, unit, target, 0);
             }
         }
     }
 }
 
-Unit* BattleEngine::findUnitById(const std::string& id) {
-    for (auto& unit : state_.units) {
-        if (unit.id == id && unit.isAlive()) {
-            return &unit;
-        }
+void BattleEngine::handleHeal(int unit, const Action& action) {
+    if (units_.cooldown[unit] > 0) return;
+    
+    int target = unit;
+    if (!action.targetUnitId.empty()) {
+        target = findUnitById(action.targetUnitId);
+        if (target < 0 || !units_.isAlive(target) || units_.team[target] != units_.team[unit]) return;
+        Position from(units_.posX[unit], units_.posY[unit]);
+        if (from.distanceTo(Position(units_.posX[target], units_.posY[target])) > units_.range[unit]) return;
     }
-    return nullptr;
+    
+    const int before = units_.health[target];
+    units_.heal(target, std::max(1, units_.attack[unit] / 2));
+    units_.cooldown[unit] = 3;
+    markStale(unit);
+    markStale(target);
+    recordEvent(EventType::Heal, unit, target, units_.health[target] - before);
 }
 
-Unit* BattleEngine::findClosestEnemy(const Unit& unit) {
-    Unit* closest = nullptr;
-    double minDistance = std::numeric_limits<double>::max();
+int BattleEngine::findClosestEnemy(int unit) {
+    const int team = units_.team[unit];
+    const int x = units_.posX[unit];
+    const int y = units_.posY[unit];
     
-    for (auto& enemy : state_.units) {
-        if (enemy.isAlive() && enemy.team != unit.team) {
-            double distance = unit.position.distanceTo(enemy.position);
-            if (distance < minDistance) {
-                minDistance = distance;
-                closest = &enemy;
-            }
+    if (spatialIndexEnabled_ && units_.size() > kDenseScanLimit) {
+        int best = -1;
+        std::int64_t bestDist = std::numeric_limits<std::int64_t>::max();
+        int scanned = 0;
+        for (int layer = 0; layer < grid_.layerCount(); layer++) {
+            if (layer == team) continue;
+            grid_.nearest(x, y, layer, [&scanned](int) { scanned++; return true; }, best, bestDist);
         }
+        PERF_COUNT(perf_, UnitsScanned, scanned);
+        return best;
     }
     
-    return closest;
+    PERF_COUNT(perf_, UnitsScanned, units_.size());
+    return nearestEnemy(units_.columns(), x, y, team);
 }
 
-std::vector<Unit*> BattleEngine::getEnemiesInRange(const Unit& unit, int range) {
-    std::vector<Unit*> enemies;
+std::vector<int> BattleEngine::getEnemiesInRange(int unit, int range) {
+    std::vector<int> enemies;
+    const int team = units_.team[unit];
+    const int x = units_.posX[unit];
+    const int y = units_.posY[unit];
     
-    for (auto& enemy : state_.units) {
-        if (enemy.isAlive() && enemy.team != unit.team) {
-            double distance = unit.position.distanceTo(enemy.position);
-            if (distance <= range) {
-                enemies.push_back(&enemy);
-            }
+    if (spatialIndexEnabled_ && units_.size() > kDenseScanLimit) {
+        for (int layer = 0; layer < grid_.layerCount(); layer++) {
+            if (layer == team) continue;
+            grid_.forEachInRadius(x, y, range, layer, [&](int i) {
+                enemies.push_back(i);
+            });
         }
+        // Keep the unit order a linear scan would produce
+        std::sort(enemies.begin(), enemies.end());
+        PERF_COUNT(perf_, UnitsScanned, enemies.size());
+        PERF_COUNT(perf_, Allocations, !enemies.empty());
+        return enemies;
     }
     
+    enemiesInRange(units_.columns(), x, y, team, range, enemies);
+    PERF_COUNT(perf_, UnitsScanned, units_.size());
+    PERF_COUNT(perf_, Allocations, !enemies.empty());
     return enemies;
 }
 
-std::vector<Unit*> BattleEngine::getAlliesInRange(const Unit& unit, int range) {
-    std::vector<Unit*> allies;
+std::vector<int> BattleEngine::getAlliesInRange(int unit, int range) {
+    std::vector<int> allies;
+    const int team = units_.team[unit];
+    const int x = units_.posX[unit];
+    const int y = units_.posY[unit];
     
-    for (auto& ally : state_.units) {
-        if (ally.isAlive() && ally.team == unit.team && ally.id != unit.id) {
-            double distance = unit.position.distanceTo(ally.position);
+    if (spatialIndexEnabled_) {
+        grid_.forEachInRadius(x, y, range, team, [&](int i) {
+            if (i != unit) {
+                allies.push_back(i);
+            }
+        });
+        std::sort(allies.begin(), allies.end());
+        PERF_COUNT(perf_, UnitsScanned, allies.size());
+        PERF_COUNT(perf_, Allocations, !allies.empty());
+        return allies;
+    }
+    PERF_COUNT(perf_, UnitsScanned, units_.size());
+    
+    const Position from(x, y);
+    for (int i = 0; i < units_.size(); i++) {
+        if (i != unit && units_.isAlive(i) && units_.team[i] == team) {
+            double distance = from.distanceTo(Position(units_.posX[i], units_.posY[i]));
             if (distance <= range) {
-                allies.push_back(&ally);
+                allies.push_back(i);
             }
         }
     }
     
+    PERF_COUNT(perf_, Allocations, !allies.empty());
     return allies;
 }
 
-bool BattleEngine::checkCollision(const Position& pos, const std::string& excludeUnitId) {
-    for (const auto& unit : state_.units) {
-        if (unit.isAlive() && unit.id != excludeUnitId && unit.position == pos) {
+bool BattleEngine::checkCollision(const Position& pos, int excludeUnit) {
+    PERF_COUNT(perf_, CollisionChecks, 1);
+    if (spatialIndexEnabled_) {
+        bool hit = false;
+        grid_.forEachAt(pos.x, pos.y, [&](int i) {
+            if (i != excludeUnit) {
+                hit = true;
+            }
+        });
+        return hit;
+    }
+    
+    for (int i = 0; i < units_.size(); i++) {
+        if (i != excludeUnit && units_.isAlive(i) &&
+            units_.posX[i] == pos.x && units_.posY[i] == pos.y) {
             return true;
         }
     }
@@ -272,74 +1482,157 @@ bool BattleEngine::checkCollision(const Position& pos, const std::string& exclud
 }
 
 bool BattleEngine::checkWinCondition() {
-    int teamAAlive = getTeamAliveCount("teamA");
-    int teamBAlive = getTeamAliveCount("teamB");
+    int teamAAlive = units_.aliveCount(teamA_);
+    int teamBAlive = units_.aliveCount(teamB_);
     
     if (teamAAlive == 0 && teamBAlive == 0) {
         state_.winner = "draw";
-        addLog("Battle ended in draw - all units eliminated");
+        recordEnd(BattleOutcome::DrawEliminated);
         return true;
     } else if (teamAAlive == 0) {
         state_.winner = "teamB";
-        addLog("Team B wins!");
+        recordEnd(BattleOutcome::TeamBWins);
         return true;
     } else if (teamBAlive == 0) {
         state_.winner = "teamA";
-        addLog("Team A wins!");
+        recordEnd(BattleOutcome::TeamAWins);
         return true;
     }
     
     return false;
 }
 
-void BattleEngine::addLog(const std::string& message) {
+void BattleEngine::recordEvent(EventType type, int actor, int target, int amount) {
+    tickEvents_ |= eventBit(type);
+    if (!events_.wants(type)) return;
+    
+    BattleEvent event;
+    event.tick = state_.tick;
+    event.type = type;
+    event.actor = actor;
+    event.target = target;
+    event.amount = amount;
+    event.x = actor >= 0 ? units_.posX[actor] : -1;
+    event.y = actor >= 0 ? units_.posY[actor] : -1;
+    events_.record(event);
+    logsDirty_ = true;
+}
+
+void BattleEngine::recordEnd(BattleOutcome outcome) {
+    recordEvent(EventType::End, -1, -1, static_cast<int>(outcome));
+}
+
+std::string BattleEngine::formatEvent(const BattleEvent& event) const {
     std::ostringstream log;
-    log << "[Tick " << state_.tick << "] " << message;
-    state_.logs.push_back(log.str());
+    log << "[Tick " << event.tick << "] ";
     
-    // Keep only last 100 logs
-    if (state_.logs.size() > 100) {
-        state_.logs.erase(state_.logs.begin());
+    switch (event.type) {
+        case EventType::Initialized:
+            log << "Battle initialized";
+            break;
+        case EventType::Move:
+            log << units_.teamName(event.actor) << " unit moved to ("
+                << event.x << ", " << event.y << ")";
+            break;
+        case EventType::Attack:
+            log << units_.teamName(event.actor) << " unit attacked "
+                << units_.teamName(event.target) << " unit for " << event.amount << " damage";
+            break;
+        case EventType::Kill:
+            log << units_.teamName(event.target) << " unit eliminated!";
+            break;
+        case EventType::Heal:
+            log << units_.teamName(event.actor) << " unit healed "
+                << units_.teamName(event.target) << " unit for " << event.amount;
+            break;
+        case EventType::End:
+            switch (static_cast<BattleOutcome>(event.amount)) {
+                case BattleOutcome::DrawMaxTicks:
+                    log << "Battle ended in draw - max ticks reached";
+                    break;
+                case BattleOutcome::DrawEliminated:
+                    log << "Battle ended in draw - all units eliminated";
+                    break;
+                case BattleOutcome::TeamAWins:
+                    log << "Team A wins!";
+                    break;
+                case BattleOutcome::TeamBWins:
+                    log << "Team B wins!";
+                    break;
+            }
+            break;
     }
+    return log.str();
+}
+
+void BattleEngine::formatLogs() const {
+    PERF_PHASE_UNTRACED(perf_, TickPhase::Logging);
+    state_.logs.clear();
+    state_.logs.reserve(events_.size());
+    for (int i = 0; i < events_.size(); i++) {
+        state_.logs.push_back(formatEvent(events_.at(i)));
+    }
+    logsDirty_ = false;
 }
 
 std::vector<Unit> BattleEngine::getAliveUnits() const {
     std::vector<Unit> alive;
-    for (const auto& unit : state_.units) {
-        if (unit.isAlive()) {
-            alive.push_back(unit);
+    for (int i = 0; i < units_.size(); i++) {
+        if (units_.isAlive(i)) {
+            alive.push_back(units_.materialize(i));
         }
     }
     return alive;
 }
 
-std::vector<Unit> BattleEngine::getTeamUnits(const std::string& team) const {
+std::vector<Unit> BattleEngine::getTeamUnits(const std::string& teamName) const {
     std::vector<Unit> teamUnits;
-    for (const auto& unit : state_.units) {
-        if (unit.team == team) {
-            teamUnits.push_back(unit);
+    int team = units_.teams.find(teamName);
+    if (team < 0) return teamUnits;
+    
+    for (int i = 0; i < units_.size(); i++) {
+        if (units_.team[i] == team) {
+            teamUnits.push_back(units_.materialize(i));
         }
     }
     return teamUnits;
 }
 
-int BattleEngine::getTeamAliveCount(const std::string& team) const {
-    int count = 0;
-    for (const auto& unit : state_.units) {
-        if (unit.team == team && unit.isAlive()) {
-            count++;
+const FlowField& BattleEngine::getFlowField(const std::string& team) {
+    static const FlowField empty;
+    const int handle = units_.teams.find(team);
+    return handle >= 0 ? teamFlowField(handle) : empty;
+}
+
+std::vector<Position> BattleEngine::findPath(const Position& from, const Position& to) {
+    std::vector<Position> path;
+    auto inside = [this](const Position& p) {
+        return p.x >= 0 && p.y >= 0 && p.x < gridWidth_ && p.y < gridHeight_;
+    };
+    std::vector<int> cells;
+    if (inside(from) && inside(to) &&
+        pathfinder().findPath(from.y * gridWidth_ + from.x, to.y * gridWidth_ + to.x, cells)) {
+        for (int cell : cells) {
+            path.push_back(Position(cell % gridWidth_, cell / gridWidth_));
         }
     }
-    return count;
+    return path;
+}
+
+int BattleEngine::getTeamAliveCount(const std::string& team) const {
+    return units_.aliveCount(units_.teams.find(team));
 }
 
 BattleEngine::BattleStats BattleEngine::getBattleStats() const {
     BattleStats stats;
     stats.totalTicks = state_.tick;
     stats.winner = state_.winner;
-    stats.teamAUnitsRemaining = getTeamAliveCount("teamA");
-    stats.teamBUnitsRemaining = getTeamAliveCount("teamB");
-    stats.totalDamageDealt = 0; // Could track this during battle
+    stats.teamAUnitsRemaining = units_.aliveCount(teamA_);
+    stats.teamBUnitsRemaining = units_.aliveCount(teamB_);
+    stats.totalDamageDealt = counters_.damage;
+    if (logsDirty_) {
+        formatLogs();
+    }
     stats.logs = state_.logs;
     return stats;
 }
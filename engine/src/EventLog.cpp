@@ -0,0 +1,45 @@
+#include "EventLog.h"
+#include <algorithm>
+
+namespace BattleSimulator {
+
+EventLog::EventLog(int capacity)
+    : head_(0), count_(0), total_(0), mask_(kDefaultMask) {
+    setCapacity(capacity);
+}
+
+void EventLog::setCapacity(int capacity) {
+    // Keep the newest events that still fit
+    std::vector<BattleEvent> kept = snapshot();
+    const size_t size = static_cast<size_t>(std::max(0, capacity));
+    if (kept.size() > size) {
+        kept.erase(kept.begin(), kept.end() - size);
+    }
+
+    events_.assign(size, BattleEvent());
+    std::copy(kept.begin(), kept.end(), events_.begin());
+    count_ = kept.size();
+    head_ = size == 0 ? 0 : count_ % size;
+}
+
+void EventLog::clear() {
+    head_ = 0;
+    count_ = 0;
+    total_ = 0;
+}
+
+const BattleEvent& EventLog::at(int i) const {
+    const size_t start = (head_ + events_.size() - count_) % events_.size();
+    return events_[(start + static_cast<size_t>(i)) % events_.size()];
+}
+
+std::vector<BattleEvent> EventLog::snapshot() const {
+    std::vector<BattleEvent> out;
+    out.reserve(count_);
+    for (int i = 0; i < size(); i++) {
+        out.push_back(at(i));
+    }
+    return out;
+}
+
+} // namespace BattleSimulator
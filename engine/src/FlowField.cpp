@@ -0,0 +1,129 @@
+#include "FlowField.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+namespace BattleSimulator {
+
+FlowField::FlowField() : repaired_(false) {}
+
+float FlowField::distance(int x, int y) const {
+    if (!costs_ || x < 0 || y < 0 || x >= costs_->width || y >= costs_->height) {
+        return CostGrid::kInfinity;
+    }
+    return dist_[y * costs_->width + x];
+}
+
+int FlowField::update(const std::shared_ptr<const CostGrid>& costs, std::vector<int> goals) {
+    const int cells = costs->width * costs->height;
+    goals.erase(std::remove_if(goals.begin(), goals.end(),
+                               [cells](int cell) { return cell < 0 || cell >= cells; }),
+                goals.end());
+    std::sort(goals.begin(), goals.end());
+    goals.erase(std::unique(goals.begin(), goals.end()), goals.end());
+
+    std::vector<std::pair<float, int>> heap;
+    auto push = [&heap](float d, int cell) {
+        heap.emplace_back(d, cell);
+        std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<float, int>>());
+    };
+
+    repaired_ = costs_ == costs;
+    if (!repaired_) {
+        // New map: start from scratch
+        costs_ = costs;
+        dist_.assign(cells, CostGrid::kInfinity);
+        source_.assign(cells, -1);
+        isGoal_.assign(cells, 0);
+        goals_.clear();
+    } else if (goals == goals_) {
+        return 0;
+    }
+
+    std::vector<int> removed;
+    std::vector<int> added;
+    std::set_difference(goals_.begin(), goals_.end(), goals.begin(), goals.end(),
+                        std::back_inserter(removed));
+    std::set_difference(goals.begin(), goals.end(), goals_.begin(), goals_.end(),
+                        std::back_inserter(added));
+    goals_ = std::move(goals);
+
+    if (!removed.empty()) {
+        // Clear every cell whose distance came from a removed goal
+        for (int goal : removed) {
+            isGoal_[goal] = 0;
+        }
+        std::vector<int> cleared;
+        for (int cell = 0; cell < cells; cell++) {
+            if (source_[cell] >= 0 && !isGoal_[source_[cell]]) {
+                dist_[cell] = CostGrid::kInfinity;
+                source_[cell] = -1;
+                cleared.push_back(cell);
+            }
+        }
+
+        // Restart from the still-valid cells bordering the cleared area
+        const int width = costs->width;
+        for (int cell : cleared) {
+            const int x = cell % width;
+            const int neighbours[4] = {
+                cell >= width ? cell - width : -1,
+                x > 0 ? cell - 1 : -1,
+                x + 1 < width ? cell + 1 : -1,
+                cell + width < cells ? cell + width : -1
+            };
+            for (int n : neighbours) {
+                if (n >= 0 && source_[n] >= 0) {
+                    push(dist_[n], n);
+                }
+            }
+        }
+    }
+
+    for (int goal : added) {
+        isGoal_[goal] = 1;
+        dist_[goal] = 0.0f;
+        source_[goal] = goal;
+        push(0.0f, goal);
+    }
+
+    return settle(heap);
+}
+
+int FlowField::settle(std::vector<std::pair<float, int>>& heap) {
+    const CostGrid& costs = *costs_;
+    const int width = costs.width;
+    const int cells = width * costs.height;
+    auto order = std::greater<std::pair<float, int>>();
+    int settled = 0;
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), order);
+        const float d = heap.back().first;
+        const int cell = heap.back().second;
+        heap.pop_back();
+        if (d > dist_[cell]) continue;
+        settled++;
+
+        const int x = cell % width;
+        const int neighbours[4] = {
+            cell >= width ? cell - width : -1,
+            x > 0 ? cell - 1 : -1,
+            x + 1 < width ? cell + 1 : -1,
+            cell + width < cells ? cell + width : -1
+        };
+        for (int n : neighbours) {
+            if (n < 0 || !costs.passable(n)) continue;
+            const float next = d + costs.cost[n];
+            if (next < dist_[n]) {
+                dist_[n] = next;
+                source_[n] = source_[cell];
+                heap.emplace_back(next, n);
+                std::push_heap(heap.begin(), heap.end(), order);
+            }
+        }
+    }
+    return settled;
+}
+
+} // namespace BattleSimulator
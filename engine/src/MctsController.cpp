@@ -0,0 +1,332 @@
+#include "MctsController.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace BattleSimulator {
+
+namespace {
+
+std::uint64_t splitMix64(std::uint64_t& state) {
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+double uniform(std::uint64_t& state) {
+    return (splitMix64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int squaredDistance(const Position& a, const Position& b) {
+    int dx = a.x - b.x;
+    int dy = a.y - b.y;
+    return dx * dx + dy * dy;
+}
+
+// Index of the closest alive enemy in state.units, or -1
+int nearestEnemyIndex(const Unit& self, const BattleState& state) {
+    int best = -1;
+    int bestDist = std::numeric_limits<int>::max();
+    for (size_t i = 0; i < state.units.size(); i++) {
+        const Unit& other = state.units[i];
+        if (other.team == self.team || !other.isAlive()) continue;
+        int dist = squaredDistance(self.position, other.position);
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+bool inRange(const Unit& self, const Unit& other) {
+    return self.position.distanceTo(other.position) <= self.range;
+}
+
+// One axis step towards (sign = 1) or away from (sign = -1) a position
+Action stepRelativeTo(const Unit& self, const Position& target, int sign) {
+    Action action;
+    action.type = Action::MOVE;
+    int dx = (target.x - self.position.x) * sign;
+    int dy = (target.y - self.position.y) * sign;
+    if (std::abs(dx) >= std::abs(dy)) {
+        action.direction = dx >= 0 ? "right" : "left";
+    } else {
+        action.direction = dy >= 0 ? "down" : "up";
+    }
+    return action;
+}
+
+Action attackUnit(const Unit& target) {
+    Action action;
+    action.type = Action::ATTACK;
+    action.targetUnitId = target.id;
+    return action;
+}
+
+Action advance(const Unit& self, const BattleState& state, int nearest) {
+    if (nearest < 0) return Action();
+    const Unit& enemy = state.units[nearest];
+    return inRange(self, enemy) ? attackUnit(enemy) : stepRelativeTo(self, enemy.position, 1);
+}
+
+} // namespace
+
+const char* teamMacroName(TeamMacro macro) {
+    switch (macro) {
+        case TeamMacro::Hold: return "hold";
+        case TeamMacro::FocusWeakest: return "focus-weakest";
+        case TeamMacro::Retreat: return "retreat";
+        case TeamMacro::Advance:
+        default: return "advance";
+    }
+}
+
+Action macroAction(TeamMacro macro, const Unit& self, const BattleState& state) {
+    const int nearest = nearestEnemyIndex(self, state);
+    if (nearest < 0) return Action();
+    const Unit& enemy = state.units[nearest];
+
+    switch (macro) {
+        case TeamMacro::Hold:
+            return inRange(self, enemy) ? attackUnit(enemy) : Action();
+
+        case TeamMacro::FocusWeakest: {
+            const Unit* weakest = nullptr;
+            for (const Unit& other : state.units) {
+                if (other.team != self.team && other.isAlive() && inRange(self, other) &&
+                    (!weakest || other.health < weakest->health)) {
+                    weakest = &other;
+                }
+            }
+            return weakest ? attackUnit(*weakest) : advance(self, state, nearest);
+        }
+
+        case TeamMacro::Retreat:
+            if (self.health * 2 < self.maxHealth) {
+                return stepRelativeTo(self, enemy.position, -1);
+            }
+            return advance(self, state, nearest);
+
+        case TeamMacro::Advance:
+        default:
+            return advance(self, state, nearest);
+    }
+}
+
+Action attackClosestPolicy(const Unit& self, const BattleState& state) {
+    return macroAction(TeamMacro::Advance, self, state);
+}
+
+// MctsController implementation
+struct MctsController::Node {
+    int visits;
+    double value;
+    int firstChild;     // index of the first of kTeamMacroCount children, or -1
+};
+
+MctsController::MctsController(const BattleEngine& engine, const std::string& team,
+                               const MctsConfig& config)
+    : engine_(engine), team_(team), opponent_(team == "teamA" ? "teamB" : "teamA"),
+      config_(config), plannedTick_(-1),
+      macro_(TeamMacro::Advance), lastIterations_(0), decisions_(0) {
+    if (!config_.opponentModel) {
+        config_.opponentModel = attackClosestPolicy;
+    }
+    config_.decisionTicks = std::max(1, config_.decisionTicks);
+    config_.treeDepth = std::max(1, config_.treeDepth);
+    if (config_.threads != 1 && config_.threads != 0) {
+        pool_ = std::make_shared<ThreadPool>(config_.threads < 0 ? -1 : config_.threads - 1);
+    }
+}
+
+std::shared_ptr<MctsController> MctsController::attach(BattleEngine& engine, const std::string& team,
+                                                       const MctsConfig& config) {
+    auto controller = std::make_shared<MctsController>(engine, team, config);
+    engine.setAICallback(team, [controller](const Unit& self, const BattleState& state) {
+        return controller->decide(self, state);
+    });
+    return controller;
+}
+
+Action MctsController::decide(const Unit& self, const BattleState& state) {
+    TeamMacro macro;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Replan on the interval, or if the battle was restarted
+        if (plannedTick_ < 0 || state.tick < plannedTick_ ||
+            state.tick - plannedTick_ >= config_.decisionTicks) {
+            macro_ = plan();
+            plannedTick_ = state.tick;
+            decisions_++;
+        }
+        macro = macro_;
+    }
+    return macroAction(macro, self, state);
+}
+
+TeamMacro MctsController::plan() {
+    const int workers = pool_ ? pool_->concurrency() : 1;
+    const int perWorker = std::max(1, (config_.iterations + workers - 1) / workers);
+
+    std::vector<SearchResult> results(workers);
+    auto body = [&](int begin, int end) {
+        for (int w = begin; w < end; w++) {
+            results[w] = search(w, perWorker, config_.timeBudgetMs);
+        }
+    };
+    if (pool_) {
+        pool_->parallelFor(workers, 1, body);
+    } else {
+        body(0, workers);
+    }
+
+    // Sum root statistics over the independent trees
+    std::vector<int> visits(kTeamMacroCount, 0);
+    std::vector<double> value(kTeamMacroCount, 0.0);
+    lastIterations_ = 0;
+    for (const SearchResult& result : results) {
+        for (int m = 0; m < kTeamMacroCount; m++) {
+            visits[m] += result.visits[m];
+            value[m] += result.value[m];
+        }
+        lastIterations_ += result.iterations;
+    }
+
+    int best = 0;
+    for (int m = 1; m < kTeamMacroCount; m++) {
+        if (visits[m] > visits[best] ||
+            (visits[m] == visits[best] && value[m] > value[best])) {
+            best = m;
+        }
+    }
+    return static_cast<TeamMacro>(best);
+}
+
+MctsController::SearchResult MctsController::search(int worker, int iterations,
+                                                    double deadlineMs) const {
+    const auto start = std::chrono::steady_clock::now();
+    std::uint64_t rng = config_.seed ^ (0x9e3779b97f4a7c15ULL * static_cast<std::uint64_t>(worker + 1));
+
+    std::vector<Node> nodes;
+    nodes.push_back(Node{0, 0.0, -1});
+    std::vector<int> pathNodes;
+    std::vector<int> pathMacros;
+
+    int done = 0;
+    for (; done < iterations; done++) {
+        if (deadlineMs > 0.0 && done > 0) {
+            double elapsed = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= deadlineMs) break;
+        }
+
+        // Selection / expansion
+        pathNodes.assign(1, 0);
+        pathMacros.clear();
+        int node = 0;
+        for (int depth = 0; depth < config_.treeDepth; depth++) {
+            if (nodes[node].firstChild < 0) {
+                nodes[node].firstChild = static_cast<int>(nodes.size());
+                for (int m = 0; m < kTeamMacroCount; m++) {
+                    nodes.push_back(Node{0, 0.0, -1});
+                }
+            }
+
+            const int first = nodes[node].firstChild;
+            const double logParent = std::log(std::max(1, nodes[node].visits));
+            int chosen = -1;
+            double bestScore = -1.0;
+            for (int m = 0; m < kTeamMacroCount; m++) {
+                const Node& child = nodes[first + m];
+                if (child.visits == 0) {
+                    chosen = m;
+                    break;
+                }
+                double score = child.value / child.visits +
+                               config_.exploration * std::sqrt(logParent / child.visits);
+                if (score > bestScore) {
+                    bestScore = score;
+                    chosen = m;
+                }
+            }
+
+            const bool fresh = nodes[first + chosen].visits == 0;
+            node = first + chosen;
+            pathNodes.push_back(node);
+            pathMacros.push_back(chosen);
+            if (fresh) break;
+        }
+
+        // Simulation and backpropagation
+        const double reward = rollout(pathMacros, rng);
+        for (int n : pathNodes) {
+            nodes[n].visits++;
+            nodes[n].value += reward;
+        }
+    }
+
+    SearchResult result;
+    result.iterations = done;
+    result.visits.assign(kTeamMacroCount, 0);
+    result.value.assign(kTeamMacroCount, 0.0);
+    if (nodes[0].firstChild >= 0) {
+        for (int m = 0; m < kTeamMacroCount; m++) {
+            result.visits[m] = nodes[nodes[0].firstChild + m].visits;
+            result.value[m] = nodes[nodes[0].firstChild + m].value;
+        }
+    }
+    return result;
+}
+
+double MctsController::rollout(const std::vector<int>& path, std::uint64_t& rng) const {
+    BattleEngine sim = engine_.fork();
+    sim.setEventCapture(false);
+
+    TeamMacro macro = TeamMacro::Advance;
+    sim.setAICallback(team_, [&macro](const Unit& self, const BattleState& state) {
+        return macroAction(macro, self, state);
+    });
+    sim.setAICallback(opponent_, config_.opponentModel);
+
+    auto healthTotals = [this](const BattleEngine& e, int& own, int& enemy) {
+        own = 0;
+        enemy = 0;
+        for (const Unit& unit : e.getState().units) {
+            if (!unit.isAlive()) continue;
+            if (unit.team == team_) own += unit.health;
+            else if (unit.team == opponent_) enemy += unit.health;
+        }
+    };
+    int ownStart = 0, enemyStart = 0;
+    healthTotals(sim, ownStart, enemyStart);
+
+    // Tree part, then the default policy with some random exploration
+    for (int choice : path) {
+        if (sim.isFinished()) break;
+        macro = static_cast<TeamMacro>(choice);
+        sim.advance(config_.decisionTicks);
+    }
+    for (int t = 0; t < config_.rolloutTicks && !sim.isFinished(); t += config_.decisionTicks) {
+        macro = uniform(rng) < config_.randomRollout
+            ? static_cast<TeamMacro>(splitMix64(rng) % kTeamMacroCount)
+            : TeamMacro::Advance;
+        sim.advance(config_.decisionTicks);
+    }
+
+    const std::string winner = sim.getWinner();
+    if (winner == team_) return 1.0;
+    if (winner == opponent_) return 0.0;
+    if (winner == "draw") return 0.5;
+
+    int own = 0, enemy = 0;
+    healthTotals(sim, own, enemy);
+    double ownFraction = ownStart > 0 ? static_cast<double>(own) / ownStart : 0.0;
+    double enemyFraction = enemyStart > 0 ? static_cast<double>(enemy) / enemyStart : 0.0;
+    return 0.5 + 0.5 * (ownFraction - enemyFraction);
+}
+
+} // namespace BattleSimulator
@@ -0,0 +1,768 @@
+#include "Pathfinder.h"
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <tuple>
+#include <iterator>
+
+namespace BattleSimulator {
+
+namespace {
+
+// Runs of open border cells at least this long get a transition at each end
+const int kLongEntrance = 6;
+
+// Route cache keys pack (cluster, component) as cluster * kMaxComponents +
+// component; clusters split into more pieces than this skip the cache
+const int kMaxComponents = 4096;
+
+// Queries spanning at most this many clusters in x and y skip shared routes
+const int kNearClusters = 2;
+
+// Cache sizes at which the route and goal tree caches start over
+const size_t kMaxRoutes = 1 << 16;
+const size_t kMaxGoalTrees = 64;
+
+const float kInfinity = CostGrid::kInfinity;
+
+std::uint64_t pairKey(int a, int b) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(a)) << 32) |
+           static_cast<std::uint32_t>(b);
+}
+
+// Cost of stepping onto `cell`; an impassable goal counts as ordinary ground
+float entryCost(const CostGrid& grid, int cell) {
+    return grid.passable(cell) ? grid.cost[cell] : 1.0f;
+}
+
+// Drop detours that revisit a cell (the path leaves `from`, so a return to
+// it truncates everything before)
+void removeLoops(int from, std::vector<int>& path) {
+    // Most paths have none; a sort finds that out faster than hashing
+    std::vector<int> sorted(path);
+    sorted.push_back(from);
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end()) return;
+
+    std::unordered_map<int, int> seen;
+    seen[from] = -1;
+    std::vector<int> out;
+    out.reserve(path.size());
+    for (int cell : path) {
+        auto it = seen.find(cell);
+        if (it != seen.end()) {
+            const int keep = it->second + 1;
+            for (int k = keep; k < static_cast<int>(out.size()); k++) {
+                seen.erase(out[k]);
+            }
+            out.resize(keep);
+            if (cell == from) continue;
+        }
+        seen[cell] = static_cast<int>(out.size());
+        out.push_back(cell);
+    }
+    path.swap(out);
+}
+
+} // namespace
+
+Pathfinder::Pathfinder(const std::shared_ptr<const CostGrid>& costs, int clusterSize)
+    : costs_(costs), clusterSize_(std::max(2, clusterSize)), clustersX_(0), clustersY_(0),
+      minCost_(1.0f), routeHits_(0), exactSearches_(0) {
+    build();
+}
+
+Pathfinder::Pathfinder(const Pathfinder& other)
+    : costs_(other.costs_), clusterSize_(other.clusterSize_),
+      clustersX_(other.clustersX_), clustersY_(other.clustersY_), minCost_(other.minCost_),
+      clusters_(other.clusters_), nodes_(other.nodes_), freeIds_(other.freeIds_),
+      nodeIds_(other.nodeIds_), component_(other.component_), borders_(other.borders_),
+      routeHits_(other.routeHits_.load()), exactSearches_(other.exactSearches_.load()) {
+    std::lock_guard<std::mutex> lock(other.cacheMutex_);
+    routes_ = other.routes_;
+    trees_ = other.trees_;
+    segments_ = other.segments_;
+}
+
+int Pathfinder::clusterOf(int cell) const {
+    const int width = costs_->width;
+    return (cell / width / clusterSize_) * clustersX_ + (cell % width) / clusterSize_;
+}
+
+void Pathfinder::build() {
+    const int width = costs_->width;
+    const int height = costs_->height;
+    clustersX_ = (width + clusterSize_ - 1) / clusterSize_;
+    clustersY_ = (height + clusterSize_ - 1) / clusterSize_;
+
+    clusters_.assign(clustersX_ * clustersY_, Cluster());
+    for (int cy = 0; cy < clustersY_; cy++) {
+        for (int cx = 0; cx < clustersX_; cx++) {
+            Cluster& cluster = clusters_[cy * clustersX_ + cx];
+            cluster.x0 = cx * clusterSize_;
+            cluster.y0 = cy * clusterSize_;
+            cluster.x1 = std::min(width, cluster.x0 + clusterSize_);
+            cluster.y1 = std::min(height, cluster.y0 + clusterSize_);
+        }
+    }
+
+    nodes_.clear();
+    freeIds_.clear();
+    nodeIds_.clear();
+    component_.assign(width * height, -1);
+    borders_.assign(clusters_.size() * 2, std::vector<std::pair<int, int>>());
+    for (int border = 0; border < static_cast<int>(borders_.size()); border++) {
+        buildBorder(border);
+    }
+    for (int c = 0; c < clusterCount(); c++) {
+        buildCluster(c);
+    }
+    updateMinCost();
+
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    routes_.clear();
+    trees_.clear();
+    segments_.clear();
+}
+
+void Pathfinder::buildBorder(int border) {
+    const int c = border / 2;
+    const bool bottom = border % 2 == 1;
+    const int cx = c % clustersX_;
+    const int cy = c / clustersX_;
+    if ((!bottom && cx + 1 >= clustersX_) || (bottom && cy + 1 >= clustersY_)) {
+        return;
+    }
+
+    const CostGrid& grid = *costs_;
+    const Cluster& cluster = clusters_[c];
+    const int length = bottom ? cluster.x1 - cluster.x0 : cluster.y1 - cluster.y0;
+    auto cellsAt = [&](int k, int& inside, int& across) {
+        if (bottom) {
+            inside = (cluster.y1 - 1) * grid.width + cluster.x0 + k;
+            across = inside + grid.width;
+        } else {
+            inside = (cluster.y0 + k) * grid.width + cluster.x1 - 1;
+            across = inside + 1;
+        }
+    };
+    auto link = [&](int k) {
+        int inside, across;
+        cellsAt(k, inside, across);
+        const int a = nodeId(inside);
+        const int b = nodeId(across);
+        nodes_[a].links.emplace_back(b, grid.cost[across]);
+        nodes_[b].links.emplace_back(a, grid.cost[inside]);
+        borders_[border].emplace_back(inside, across);
+    };
+
+    // One transition per run of cells open on both sides, two for long runs
+    int k = 0;
+    while (k < length) {
+        int inside, across;
+        cellsAt(k, inside, across);
+        if (!grid.passable(inside) || !grid.passable(across)) {
+            k++;
+            continue;
+        }
+        int end = k;
+        while (end < length) {
+            cellsAt(end, inside, across);
+            if (!grid.passable(inside) || !grid.passable(across)) break;
+            end++;
+        }
+        if (end - k >= kLongEntrance) {
+            link(k);
+            link(end - 1);
+        } else {
+            link(k + (end - k - 1) / 2);
+        }
+        k = end;
+    }
+}
+
+int Pathfinder::nodeId(int cell) {
+    auto it = nodeIds_.find(cell);
+    if (it != nodeIds_.end()) return it->second;
+    
+    int id;
+    if (freeIds_.empty()) {
+        id = static_cast<int>(nodes_.size());
+        nodes_.push_back(Node());
+    } else {
+        id = freeIds_.back();
+        freeIds_.pop_back();
+    }
+    nodes_[id].cell = cell;
+    nodes_[id].slot = -1;
+    nodes_[id].links.clear();
+    nodeIds_[cell] = id;
+    return id;
+}
+
+void Pathfinder::clearBorder(int border) {
+    // Nodes left without links are freed
+    auto unlink = [this](int id, int other) {
+        auto& links = nodes_[id].links;
+        links.erase(std::remove_if(links.begin(), links.end(),
+                                   [other](const std::pair<int, float>& l) { return l.first == other; }),
+                    links.end());
+        if (links.empty()) {
+            nodeIds_.erase(nodes_[id].cell);
+            nodes_[id].cell = -1;
+            freeIds_.push_back(id);
+        }
+    };
+    for (const auto& transition : borders_[border]) {
+        const int a = nodeIds_.at(transition.first);
+        const int b = nodeIds_.at(transition.second);
+        unlink(a, b);
+        unlink(b, a);
+    }
+    borders_[border].clear();
+}
+
+void Pathfinder::buildCluster(int c) {
+    Cluster& cluster = clusters_[c];
+    const int clusterX = c % clustersX_;
+    const int clusterY = c / clustersX_;
+
+    // Nodes sit on the cluster's own right/bottom borders and on the
+    // neighbours' borders facing it
+    cluster.nodes.clear();
+    for (const auto& t : borders_[c * 2]) cluster.nodes.push_back(t.first);
+    for (const auto& t : borders_[c * 2 + 1]) cluster.nodes.push_back(t.first);
+    if (clusterX > 0) {
+        for (const auto& t : borders_[(c - 1) * 2]) cluster.nodes.push_back(t.second);
+    }
+    if (clusterY > 0) {
+        for (const auto& t : borders_[(c - clustersX_) * 2 + 1]) cluster.nodes.push_back(t.second);
+    }
+    std::sort(cluster.nodes.begin(), cluster.nodes.end());
+    cluster.nodes.erase(std::unique(cluster.nodes.begin(), cluster.nodes.end()), cluster.nodes.end());
+
+    // Label the cluster's connected pieces
+    const CostGrid& grid = *costs_;
+    const int width = grid.width;
+    std::vector<int> stack;
+    int components = 0;
+    for (int y = cluster.y0; y < cluster.y1; y++) {
+        for (int x = cluster.x0; x < cluster.x1; x++) {
+            component_[y * width + x] = -1;
+        }
+    }
+    for (int y = cluster.y0; y < cluster.y1; y++) {
+        for (int x = cluster.x0; x < cluster.x1; x++) {
+            const int seed = y * width + x;
+            if (component_[seed] >= 0 || !grid.passable(seed)) continue;
+            component_[seed] = components;
+            stack.assign(1, seed);
+            while (!stack.empty()) {
+                const int cell = stack.back();
+                stack.pop_back();
+                const int cx = cell % width;
+                const int cy = cell / width;
+                const int neighbours[4] = {
+                    cy > cluster.y0 ? cell - width : -1,
+                    cx > cluster.x0 ? cell - 1 : -1,
+                    cx + 1 < cluster.x1 ? cell + 1 : -1,
+                    cy + 1 < cluster.y1 ? cell + width : -1
+                };
+                for (int n : neighbours) {
+                    if (n >= 0 && component_[n] < 0 && grid.passable(n)) {
+                        component_[n] = components;
+                        stack.push_back(n);
+                    }
+                }
+            }
+            components++;
+        }
+    }
+
+    const int n = static_cast<int>(cluster.nodes.size());
+    const int localWidth = cluster.x1 - cluster.x0;
+    cluster.ids.clear();
+    for (int cell : cluster.nodes) {
+        cluster.ids.push_back(nodeIds_.at(cell));
+    }
+    cluster.cost.assign(n * n, kInfinity);
+    std::vector<float> dist;
+    for (int i = 0; i < n; i++) {
+        nodes_[cluster.ids[i]].slot = i;
+        clusterDijkstra(c, cluster.nodes[i], false, dist);
+        for (int j = 0; j < n; j++) {
+            const int cell = cluster.nodes[j];
+            cluster.cost[i * n + j] = dist[(cell / width - cluster.y0) * localWidth +
+                                           cell % width - cluster.x0];
+        }
+    }
+}
+
+void Pathfinder::updateMinCost() {
+    minCost_ = kInfinity;
+    const CostGrid& grid = *costs_;
+    for (int cell = 0; cell < static_cast<int>(grid.cost.size()); cell++) {
+        if (grid.passable(cell)) {
+            minCost_ = std::min(minCost_, grid.cost[cell]);
+        }
+    }
+    // An impassable goal is entered at cost 1 (see entryCost)
+    minCost_ = std::min(minCost_, 1.0f);
+}
+
+int Pathfinder::update(const std::shared_ptr<const CostGrid>& costs) {
+    if (costs == costs_) return 0;
+    if (costs->width != costs_->width || costs->height != costs_->height) {
+        costs_ = costs;
+        build();
+        return clusterCount();
+    }
+
+    // Clusters containing a changed cell
+    std::vector<std::uint8_t> dirty(clusters_.size(), 0);
+    bool any = false;
+    for (int cell = 0; cell < static_cast<int>(costs->cost.size()); cell++) {
+        if (costs->cost[cell] != costs_->cost[cell]) {
+            dirty[clusterOf(cell)] = 1;
+            any = true;
+        }
+    }
+    costs_ = costs;
+    if (!any) return 0;
+
+    // Their borders change, so their neighbours' node sets change too
+    std::vector<int> borders;
+    std::vector<std::uint8_t> rebuilt(clusters_.size(), 0);
+    for (int c = 0; c < clusterCount(); c++) {
+        if (!dirty[c]) continue;
+        const int cx = c % clustersX_;
+        const int cy = c / clustersX_;
+        borders.push_back(c * 2);
+        borders.push_back(c * 2 + 1);
+        rebuilt[c] = 1;
+        if (cx > 0) { borders.push_back((c - 1) * 2); rebuilt[c - 1] = 1; }
+        if (cy > 0) { borders.push_back((c - clustersX_) * 2 + 1); rebuilt[c - clustersX_] = 1; }
+        if (cx + 1 < clustersX_) rebuilt[c + 1] = 1;
+        if (cy + 1 < clustersY_) rebuilt[c + clustersX_] = 1;
+    }
+    std::sort(borders.begin(), borders.end());
+    borders.erase(std::unique(borders.begin(), borders.end()), borders.end());
+
+    for (int border : borders) clearBorder(border);
+    for (int border : borders) buildBorder(border);
+    int count = 0;
+    for (int c = 0; c < clusterCount(); c++) {
+        if (rebuilt[c]) {
+            buildCluster(c);
+            count++;
+        }
+    }
+    updateMinCost();
+
+    // Drop all routes and goal trees, since an opened cluster can shorten or
+    // connect a route that never touched it, and segments that lie in a
+    // rebuilt cluster
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    routes_.clear();
+    trees_.clear();
+    for (auto it = segments_.begin(); it != segments_.end();) {
+        it = rebuilt[clusterOf(static_cast<int>(it->first >> 32))] ? segments_.erase(it) : std::next(it);
+    }
+    return count;
+}
+
+void Pathfinder::clusterDijkstra(int c, int origin, bool reverse, std::vector<float>& dist) const {
+    const CostGrid& grid = *costs_;
+    const Cluster& cluster = clusters_[c];
+    const int width = grid.width;
+    const int localWidth = cluster.x1 - cluster.x0;
+    const int localHeight = cluster.y1 - cluster.y0;
+    auto local = [&](int cell) {
+        return (cell / width - cluster.y0) * localWidth + cell % width - cluster.x0;
+    };
+
+    dist.assign(localWidth * localHeight, kInfinity);
+    std::vector<std::pair<float, int>> heap;
+    auto order = std::greater<std::pair<float, int>>();
+    dist[local(origin)] = 0.0f;
+    heap.emplace_back(0.0f, origin);
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), order);
+        const float d = heap.back().first;
+        const int cell = heap.back().second;
+        heap.pop_back();
+        if (d > dist[local(cell)]) continue;
+
+        const int x = cell % width;
+        const int y = cell / width;
+        const int neighbours[4] = {
+            y > cluster.y0 ? cell - width : -1,
+            x > cluster.x0 ? cell - 1 : -1,
+            x + 1 < cluster.x1 ? cell + 1 : -1,
+            y + 1 < cluster.y1 ? cell + width : -1
+        };
+        for (int n : neighbours) {
+            if (n < 0 || !grid.passable(n)) continue;
+            // Forward: pay for entering n. Reverse: n steps into `cell`.
+            const float next = d + (reverse ? entryCost(grid, cell) : grid.cost[n]);
+            if (next < dist[local(n)]) {
+                dist[local(n)] = next;
+                heap.emplace_back(next, n);
+                std::push_heap(heap.begin(), heap.end(), order);
+            }
+        }
+    }
+}
+
+bool Pathfinder::localPath(const Bounds& cluster, int from, int to, std::vector<int>& path) const {
+    const CostGrid& grid = *costs_;
+    const int width = grid.width;
+    const int localWidth = cluster.x1 - cluster.x0;
+    const int localHeight = cluster.y1 - cluster.y0;
+    auto local = [&](int cell) {
+        return (cell / width - cluster.y0) * localWidth + cell % width - cluster.x0;
+    };
+    const int tx = to % width;
+    const int ty = to / width;
+    auto heuristic = [&](int cell) {
+        return minCost_ * (std::abs(cell % width - tx) + std::abs(cell / width - ty));
+    };
+
+    std::vector<float> g(localWidth * localHeight, kInfinity);
+    std::vector<int> parent(localWidth * localHeight, -1);
+    std::vector<std::tuple<float, float, int>> open;
+    auto order = std::greater<std::tuple<float, float, int>>();
+    g[local(from)] = 0.0f;
+    open.emplace_back(heuristic(from), 0.0f, from);
+
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), order);
+        const float d = std::get<1>(open.back());
+        const int cell = std::get<2>(open.back());
+        open.pop_back();
+        if (d > g[local(cell)]) continue;
+
+        if (cell == to) {
+            const size_t start = path.size();
+            for (int at = to; at != from; at = parent[local(at)]) {
+                path.push_back(at);
+            }
+            std::reverse(path.begin() + start, path.end());
+            return true;
+        }
+
+        const int x = cell % width;
+        const int y = cell / width;
+        const int neighbours[4] = {
+            y > cluster.y0 ? cell - width : -1,
+            x > cluster.x0 ? cell - 1 : -1,
+            x + 1 < cluster.x1 ? cell + 1 : -1,
+            y + 1 < cluster.y1 ? cell + width : -1
+        };
+        for (int n : neighbours) {
+            if (n < 0 || (n != to && !grid.passable(n))) continue;
+            const float next = d + entryCost(grid, n);
+            if (next < g[local(n)]) {
+                g[local(n)] = next;
+                parent[local(n)] = cell;
+                open.emplace_back(next + heuristic(n), next, n);
+                std::push_heap(open.begin(), open.end(), order);
+            }
+        }
+    }
+    return false;
+}
+
+bool Pathfinder::abstractSearch(const std::vector<std::pair<int, float>>& starts,
+                                const std::vector<std::pair<int, float>>& goals, int goalCluster,
+                                std::vector<int>& route) const {
+    const int width = costs_->width;
+    const Cluster& target = clusters_[goalCluster];
+    // Admissible: cheapest possible cost of reaching the goal cluster
+    auto heuristic = [&](int id) {
+        const int x = nodes_[id].cell % width;
+        const int y = nodes_[id].cell / width;
+        const int dx = x < target.x0 ? target.x0 - x : (x >= target.x1 ? x - target.x1 + 1 : 0);
+        const int dy = y < target.y0 ? target.y0 - y : (y >= target.y1 ? y - target.y1 + 1 : 0);
+        return minCost_ * (dx + dy);
+    };
+
+    const size_t count = nodes_.size();
+    std::vector<float> g(count, kInfinity);
+    std::vector<float> goalCost(count, kInfinity);
+    std::vector<int> parent(count, -1);
+    // Ties break on the node's cell, not its id, since update() reuses ids
+    // in a different order than a fresh build
+    std::vector<std::tuple<float, float, int, int>> open;
+    auto order = std::greater<std::tuple<float, float, int, int>>();
+    auto relax = [&](int id, float cost, int from) {
+        if (cost >= g[id]) return;
+        g[id] = cost;
+        parent[id] = from;
+        open.emplace_back(cost + heuristic(id), cost, nodes_[id].cell, id);
+        std::push_heap(open.begin(), open.end(), order);
+    };
+    for (const auto& goal : goals) {
+        goalCost[goal.first] = std::min(goalCost[goal.first], goal.second);
+    }
+    for (const auto& start : starts) {
+        relax(start.first, start.second, -1);
+    }
+
+    float best = kInfinity;
+    int bestNode = -1;
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), order);
+        const float f = std::get<0>(open.back());
+        const float d = std::get<1>(open.back());
+        const int id = std::get<3>(open.back());
+        open.pop_back();
+        if (f >= best) break;
+        if (d > g[id]) continue;
+
+        if (d + goalCost[id] < best) {
+            best = d + goalCost[id];
+            bestNode = id;
+        }
+
+        const Node& node = nodes_[id];
+        const Cluster& cluster = clusters_[clusterOf(node.cell)];
+        const int n = static_cast<int>(cluster.ids.size());
+        const float* row = cluster.cost.data() + node.slot * n;
+        for (int j = 0; j < n; j++) {
+            if (j != node.slot && row[j] < kInfinity) {
+                relax(cluster.ids[j], d + row[j], id);
+            }
+        }
+        for (const auto& link : node.links) {
+            relax(link.first, d + link.second, id);
+        }
+    }
+
+    route.clear();
+    if (bestNode < 0) return false;
+    for (int id = bestNode; id >= 0; id = parent[id]) {
+        route.push_back(nodes_[id].cell);
+    }
+    std::reverse(route.begin(), route.end());
+    return true;
+}
+
+bool Pathfinder::routeFor(int from, int to, std::vector<int>& route) const {
+    const int startCluster = clusterOf(from);
+    const int goalCluster = clusterOf(to);
+    const int startPiece = component_[from];
+    const int goalPiece = component_[to];
+    const std::uint64_t key = pairKey(startCluster * kMaxComponents + startPiece,
+                                      goalCluster * kMaxComponents + goalPiece);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        auto it = routes_.find(key);
+        if (it != routes_.end()) {
+            route = it->second;
+            return !route.empty();
+        }
+    }
+
+    // Walk down the goal's tree from the cheapest node of the start piece
+    std::shared_ptr<const GoalTree> tree = goalTree(goalCluster, goalPiece);
+    const Cluster& start = clusters_[startCluster];
+    int best = -1;
+    for (size_t i = 0; i < start.nodes.size(); i++) {
+        const int id = start.ids[i];
+        if (component_[start.nodes[i]] == startPiece && tree->dist[id] < kInfinity &&
+            (best < 0 || tree->dist[id] < tree->dist[best])) {
+            best = id;
+        }
+    }
+    route.clear();
+    for (int id = best; id >= 0; id = tree->next[id]) {
+        route.push_back(nodes_[id].cell);
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    if (routes_.size() >= kMaxRoutes) {
+        routes_.clear();
+    }
+    routes_[key] = route;
+    return !route.empty();
+}
+
+std::shared_ptr<const Pathfinder::GoalTree> Pathfinder::goalTree(int goalCluster, int goalPiece) const {
+    const int key = goalCluster * kMaxComponents + goalPiece;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        auto it = trees_.find(key);
+        if (it != trees_.end()) return it->second;
+    }
+
+    // Dijkstra from the goal piece's nodes along reversed edges
+    auto tree = std::make_shared<GoalTree>();
+    tree->dist.assign(nodes_.size(), kInfinity);
+    tree->next.assign(nodes_.size(), -1);
+    std::vector<std::tuple<float, int, int>> heap;
+    auto order = std::greater<std::tuple<float, int, int>>();
+    auto relax = [&](int id, float cost, int next) {
+        if (cost >= tree->dist[id]) return;
+        tree->dist[id] = cost;
+        tree->next[id] = next;
+        // Ties break on cell, as in abstractSearch
+        heap.emplace_back(cost, nodes_[id].cell, id);
+        std::push_heap(heap.begin(), heap.end(), order);
+    };
+    const Cluster& goal = clusters_[goalCluster];
+    for (size_t i = 0; i < goal.nodes.size(); i++) {
+        if (component_[goal.nodes[i]] == goalPiece) {
+            relax(goal.ids[i], 0.0f, -1);
+        }
+    }
+
+    const CostGrid& grid = *costs_;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), order);
+        const float d = std::get<0>(heap.back());
+        const int id = std::get<2>(heap.back());
+        heap.pop_back();
+        if (d > tree->dist[id]) continue;
+
+        // Every node j that can step to this one: same-cluster nodes via
+        // the crossing matrix, linked nodes by entering this cell
+        const Node& node = nodes_[id];
+        const Cluster& cluster = clusters_[clusterOf(node.cell)];
+        const int n = static_cast<int>(cluster.ids.size());
+        for (int j = 0; j < n; j++) {
+            const float cost = cluster.cost[j * n + node.slot];
+            if (j != node.slot && cost < kInfinity) {
+                relax(cluster.ids[j], d + cost, id);
+            }
+        }
+        for (const auto& link : node.links) {
+            relax(link.first, d + grid.cost[node.cell], id);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    if (trees_.size() >= kMaxGoalTrees) {
+        trees_.clear();
+    }
+    trees_[key] = tree;
+    return tree;
+}
+
+bool Pathfinder::segment(int c, int from, int to, std::vector<int>& path) const {
+    const std::uint64_t key = pairKey(from, to);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        auto it = segments_.find(key);
+        if (it != segments_.end()) {
+            path.insert(path.end(), it->second.begin(), it->second.end());
+            return true;
+        }
+    }
+
+    std::vector<int> cells;
+    if (!localPath(clusters_[c], from, to, cells)) return false;
+    path.insert(path.end(), cells.begin(), cells.end());
+
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    segments_[key] = std::move(cells);
+    return true;
+}
+
+bool Pathfinder::assemble(int from, int to, const std::vector<int>& route,
+                          std::vector<int>& path) const {
+    // Head straight for the last route node in the start cluster, and from
+    // the first one in the goal cluster (consecutive nodes in one cluster
+    // are in the same piece)
+    size_t first = 0;
+    while (first + 1 < route.size() && clusterOf(route[first + 1]) == clusterOf(route[first])) {
+        first++;
+    }
+    size_t last = route.size() - 1;
+    while (last > first && clusterOf(route[last - 1]) == clusterOf(route[last])) {
+        last--;
+    }
+
+    path.clear();
+    if (route[first] != from && !localPath(clusters_[clusterOf(from)], from, route[first], path)) {
+        return false;
+    }
+    for (size_t i = first + 1; i <= last; i++) {
+        const int c = clusterOf(route[i - 1]);
+        if (c != clusterOf(route[i])) {
+            path.push_back(route[i]);
+        } else if (!segment(c, route[i - 1], route[i], path)) {
+            return false;
+        }
+    }
+    if (route[last] != to && !localPath(clusters_[clusterOf(to)], route[last], to, path)) {
+        return false;
+    }
+    removeLoops(from, path);
+    return true;
+}
+
+bool Pathfinder::exactPath(int from, int to, std::vector<int>& path) const {
+    const int width = costs_->width;
+    auto nodeCosts = [&](int c, int origin, bool reverse) {
+        const Cluster& cluster = clusters_[c];
+        const int localWidth = cluster.x1 - cluster.x0;
+        std::vector<float> dist;
+        clusterDijkstra(c, origin, reverse, dist);
+        std::vector<std::pair<int, float>> costs;
+        for (size_t i = 0; i < cluster.nodes.size(); i++) {
+            const int node = cluster.nodes[i];
+            float d = dist[(node / width - cluster.y0) * localWidth + node % width - cluster.x0];
+            if (d < kInfinity) costs.emplace_back(cluster.ids[i], d);
+        }
+        return costs;
+    };
+
+    const int goalCluster = clusterOf(to);
+    std::vector<int> route;
+    return abstractSearch(nodeCosts(clusterOf(from), from, false), nodeCosts(goalCluster, to, true),
+                          goalCluster, route) &&
+           assemble(from, to, route, path);
+}
+
+bool Pathfinder::findPath(int from, int to, std::vector<int>& path) const {
+    path.clear();
+    const int cells = static_cast<int>(costs_->cost.size());
+    if (from < 0 || to < 0 || from >= cells || to >= cells) return false;
+    if (from == to) return true;
+
+    const int startCluster = clusterOf(from);
+    const int goalCluster = clusterOf(to);
+    const int dx = std::abs(startCluster % clustersX_ - goalCluster % clustersX_);
+    const int dy = std::abs(startCluster / clustersX_ - goalCluster / clustersX_);
+    if (dx <= 1 && dy <= 1) {
+        // Close by: plain A* over the one or two clusters involved
+        const Cluster& a = clusters_[startCluster];
+        const Cluster& b = clusters_[goalCluster];
+        const Bounds area = {std::min(a.x0, b.x0), std::min(a.y0, b.y0),
+                             std::max(a.x1, b.x1), std::max(a.y1, b.y1)};
+        if (localPath(area, from, to, path)) return true;
+        path.clear();
+    }
+
+    // Far apart with both ends on open ground: use the shared route for
+    // their pieces (complete, so no route means no path). Nearer pairs get
+    // an exact search, since a route planned for a whole piece can be a
+    // long detour over a short distance.
+    if (std::max(dx, dy) > kNearClusters &&
+        component_[from] >= 0 && component_[from] < kMaxComponents &&
+        component_[to] >= 0 && component_[to] < kMaxComponents) {
+        std::vector<int> route;
+        if (!routeFor(from, to, route)) return false;
+        if (assemble(from, to, route, path)) {
+            routeHits_++;
+            return true;
+        }
+    }
+
+    exactSearches_++;
+    return exactPath(from, to, path);
+}
+
+} // namespace BattleSimulator
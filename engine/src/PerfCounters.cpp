@@ -0,0 +1,167 @@
+#include "PerfCounters.h"
+#include <sstream>
+
+namespace BattleSimulator {
+
+const char* tickPhaseName(TickPhase phase) {
+    switch (phase) {
+        case TickPhase::Index: return "index";
+        case TickPhase::WinCheck: return "winCheck";
+        case TickPhase::Decide: return "decide";
+        case TickPhase::Move: return "move";
+        case TickPhase::Attack: return "attack";
+        case TickPhase::Cooldowns: return "cooldowns";
+        case TickPhase::Logging:
+        default: return "logging";
+    }
+}
+
+PerfRecorder::PerfRecorder()
+    : enabled_(false), tracing_(false), origin_(Clock::now()), ticks_(0),
+      tick_(0), tickStart_(origin_), traceTruncated_(false) {
+    clear();
+}
+
+PerfRecorder::PerfRecorder(const PerfRecorder& other)
+    : enabled_(false), tracing_(false), origin_(Clock::now()), ticks_(0),
+      tick_(0), tickStart_(origin_), traceTruncated_(false) {
+    *this = other;
+}
+
+PerfRecorder& PerfRecorder::operator=(const PerfRecorder& other) {
+    if (this == &other) return *this;
+    enabled_ = other.enabled_;
+    tracing_ = other.tracing_;
+    origin_ = other.origin_;
+    for (int i = 0; i < kPerfCounterCount; i++) {
+        counts_[i].store(other.counts_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    for (int i = 0; i < kTickPhaseCount; i++) {
+        phaseMs_[i] = other.phaseMs_[i];
+        tickPhaseMs_[i] = other.tickPhaseMs_[i];
+    }
+    ticks_ = other.ticks_;
+    tick_ = other.tick_;
+    tickStart_ = other.tickStart_;
+    trace_ = other.trace_;
+    traceTruncated_ = other.traceTruncated_;
+    return *this;
+}
+
+void PerfRecorder::setEnabled(bool enabled) {
+    if (enabled && !enabled_) clear();
+    enabled_ = enabled;
+    if (!enabled) tracing_ = false;
+}
+
+void PerfRecorder::setTracing(bool tracing) {
+    if (tracing) setEnabled(true);
+    tracing_ = tracing;
+}
+
+void PerfRecorder::clear() {
+    origin_ = Clock::now();
+    for (int i = 0; i < kPerfCounterCount; i++) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < kTickPhaseCount; i++) {
+        phaseMs_[i] = 0.0;
+        tickPhaseMs_[i] = 0.0;
+    }
+    ticks_ = 0;
+    trace_.clear();
+    traceTruncated_ = false;
+}
+
+void PerfRecorder::addPhase(TickPhase phase, Clock::time_point start, Clock::time_point end,
+                            bool traced) {
+    const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    phaseMs_[static_cast<int>(phase)] += ms;
+    tickPhaseMs_[static_cast<int>(phase)] += ms;
+    if (!tracing_ || !traced) return;
+    if (trace_.size() >= kMaxTraceEvents) {
+        traceTruncated_ = true;
+        return;
+    }
+    TraceEvent event = TraceEvent();
+    event.phase = phase;
+    event.isTick = false;
+    event.tick = tick_;
+    event.startUs = sinceOriginUs(start);
+    event.durationUs = ms * 1000.0;
+    trace_.push_back(event);
+}
+
+void PerfRecorder::beginTick(int tick) {
+    tick_ = tick;
+    tickStart_ = Clock::now();
+    for (int i = 0; i < kTickPhaseCount; i++) {
+        tickPhaseMs_[i] = 0.0;
+    }
+}
+
+void PerfRecorder::endTick() {
+    ticks_++;
+    if (!tracing_) return;
+    if (trace_.size() >= kMaxTraceEvents) {
+        traceTruncated_ = true;
+        return;
+    }
+    const Clock::time_point end = Clock::now();
+    TraceEvent event = TraceEvent();
+    event.isTick = true;
+    event.tick = tick_;
+    event.startUs = sinceOriginUs(tickStart_);
+    event.durationUs = std::chrono::duration<double, std::micro>(end - tickStart_).count();
+    for (int i = 0; i < kTickPhaseCount; i++) {
+        event.phaseMs[i] = tickPhaseMs_[i];
+    }
+    trace_.push_back(event);
+}
+
+PerfCounters PerfRecorder::snapshot() const {
+    PerfCounters out;
+    out.ticks = ticks_;
+    out.indexMs = phaseMs_[static_cast<int>(TickPhase::Index)];
+    out.winCheckMs = phaseMs_[static_cast<int>(TickPhase::WinCheck)];
+    out.decideMs = phaseMs_[static_cast<int>(TickPhase::Decide)];
+    out.moveMs = phaseMs_[static_cast<int>(TickPhase::Move)];
+    out.attackMs = phaseMs_[static_cast<int>(TickPhase::Attack)];
+    out.cooldownsMs = phaseMs_[static_cast<int>(TickPhase::Cooldowns)];
+    out.loggingMs = phaseMs_[static_cast<int>(TickPhase::Logging)];
+    auto count = [this](PerfCounter counter) {
+        return static_cast<double>(counts_[static_cast<int>(counter)].load(std::memory_order_relaxed));
+    };
+    out.unitsScanned = count(PerfCounter::UnitsScanned);
+    out.collisionChecks = count(PerfCounter::CollisionChecks);
+    out.callbackInvocations = count(PerfCounter::CallbackInvocations);
+    out.decisions = count(PerfCounter::Decisions);
+    out.allocations = count(PerfCounter::Allocations);
+    return out;
+}
+
+std::string PerfRecorder::traceJson() const {
+    std::ostringstream json;
+    json << std::fixed;
+    json.precision(3);
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    json << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+         << "\"args\":{\"name\":\"BattleEngine\"}}";
+    for (const TraceEvent& event : trace_) {
+        json << ",{\"name\":\"" << (event.isTick ? "tick" : tickPhaseName(event.phase)) << "\""
+             << ",\"cat\":\"" << (event.isTick ? "tick" : "phase") << "\""
+             << ",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+             << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs
+             << ",\"args\":{\"tick\":" << event.tick;
+        if (event.isTick) {
+            for (int i = 0; i < kTickPhaseCount; i++) {
+                json << ",\"" << tickPhaseName(static_cast<TickPhase>(i)) << "Ms\":" << event.phaseMs[i];
+            }
+        }
+        json << "}}";
+    }
+    json << "],\"otherData\":{\"truncated\":" << (traceTruncated_ ? "true" : "false") << "}}";
+    return json.str();
+}
+
+} // namespace BattleSimulator
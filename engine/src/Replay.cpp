@@ -0,0 +1,436 @@
+#include "Replay.h"
+#include <algorithm>
+#include <cstring>
+
+namespace BattleSimulator {
+
+namespace {
+
+const char kReplayMagic[4] = {'B', 'R', 'P', 'L'};
+const std::uint8_t kReplayVersion = 1;
+
+enum FrameKind : std::uint8_t {
+    DeltaFrame = 0,
+    KeyFrame = 1
+};
+
+// Field mask bits in a delta record
+enum FieldBit : std::uint8_t {
+    FieldX = 1 << 0,
+    FieldY = 1 << 1,
+    FieldHealth = 1 << 2,
+    FieldCooldown = 1 << 3,
+    FieldAlive = 1 << 4      // alive flag flipped
+};
+
+void putVarint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+void putSigned(std::vector<std::uint8_t>& out, std::int64_t value) {
+    putVarint(out, (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+void putString(std::vector<std::uint8_t>& out, const std::string& s) {
+    putVarint(out, s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+void putDouble(std::vector<std::uint8_t>& out, double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<std::uint8_t>(bits >> (8 * i)));
+    }
+}
+
+// Bounds-checked cursor over replay bytes; any overrun sets `ok` to false
+// and makes every later read return zero
+struct ByteReader {
+    const std::vector<std::uint8_t>& data;
+    size_t pos;
+    size_t end;
+    bool ok;
+
+    ByteReader(const std::vector<std::uint8_t>& d, size_t p, size_t e)
+        : data(d), pos(p), end(e), ok(true) {}
+
+    std::uint8_t byte() {
+        if (pos >= end) {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    std::uint64_t varint() {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            std::uint8_t b = byte();
+            value |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int integer() { return static_cast<int>(varint()); }
+
+    int signedInt() {
+        std::uint64_t v = varint();
+        return static_cast<int>(static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1));
+    }
+
+    std::string string() {
+        std::uint64_t length = varint();
+        if (!ok || length > end - pos) {
+            ok = false;
+            return std::string();
+        }
+        std::string s(data.begin() + pos, data.begin() + pos + length);
+        pos += length;
+        return s;
+    }
+
+    double real() {
+        std::uint64_t bits = 0;
+        for (int i = 0; i < 8; i++) {
+            bits |= static_cast<std::uint64_t>(byte()) << (8 * i);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+} // namespace
+
+// ReplayRecorder implementation
+ReplayRecorder::ReplayRecorder(int keyframeInterval)
+    : keyframeInterval_(std::max(1, keyframeInterval)), lastTick_(-1), finished_(false) {}
+
+void ReplayRecorder::begin(const BattleEngine& engine) {
+    out_.clear();
+    keyframes_.clear();
+    finished_ = false;
+    lastTick_ = -1;
+
+    const BattleState& state = engine.getState();
+    const TerrainGrid& terrain = state.terrain.grid();
+    const int height = terrain.height();
+    const int width = terrain.width();
+
+    out_.insert(out_.end(), kReplayMagic, kReplayMagic + 4);
+    out_.push_back(kReplayVersion);
+    putVarint(out_, width);
+    putVarint(out_, height);
+    putVarint(out_, keyframeInterval_);
+
+    // Roster: everything that never changes during a battle
+    putVarint(out_, state.units.size());
+    for (const Unit& unit : state.units) {
+        putString(out_, unit.id);
+        putString(out_, unit.team);
+        putString(out_, unit.type);
+        putSigned(out_, unit.maxHealth);
+        putSigned(out_, unit.attack);
+        putSigned(out_, unit.defense);
+        putSigned(out_, unit.speed);
+        putSigned(out_, unit.range);
+    }
+
+    // Terrain as its palette plus one index per cell, row-major
+    putVarint(out_, terrain.palette().size());
+    for (const TerrainCell& cell : terrain.palette()) {
+        putString(out_, cell.type);
+        putDouble(out_, cell.moveCost);
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            putVarint(out_, terrain.paletteIndex(x, y));
+        }
+    }
+
+    x_.clear();
+    y_.clear();
+    health_.clear();
+    cooldown_.clear();
+    alive_.clear();
+    for (const Unit& unit : state.units) {
+        x_.push_back(unit.position.x);
+        y_.push_back(unit.position.y);
+        health_.push_back(unit.health);
+        cooldown_.push_back(unit.cooldown);
+        alive_.push_back(unit.isAlive() ? 1 : 0);
+    }
+
+    writeFrame(engine, true);
+}
+
+bool ReplayRecorder::record(const BattleEngine& engine) {
+    if (finished_ || out_.empty() || engine.getCurrentTick() <= lastTick_) {
+        return false;
+    }
+
+    using namespace StateBufferLayout;
+    const std::intptr_t* header = reinterpret_cast<const std::intptr_t*>(engine.getStateBuffer());
+    if (header[UnitCount] != static_cast<std::intptr_t>(x_.size())) {
+        return false;
+    }
+
+    const bool keyframe = engine.getCurrentTick() - keyframes_.back().tick >= keyframeInterval_;
+    writeFrame(engine, keyframe);
+    return true;
+}
+
+void ReplayRecorder::writeFrame(const BattleEngine& engine, bool keyframe) {
+    using namespace StateBufferLayout;
+    const std::intptr_t* header = reinterpret_cast<const std::intptr_t*>(engine.getStateBuffer());
+    const int count = static_cast<int>(header[UnitCount]);
+    const int* x = reinterpret_cast<const int*>(header[PosXColumn]);
+    const int* y = reinterpret_cast<const int*>(header[PosYColumn]);
+    const int* health = reinterpret_cast<const int*>(header[HealthColumn]);
+    const int* cooldown = reinterpret_cast<const int*>(header[CooldownColumn]);
+    const std::uint8_t* alive = reinterpret_cast<const std::uint8_t*>(header[AliveColumn]);
+
+    const int tick = engine.getCurrentTick();
+    if (keyframe) {
+        keyframes_.push_back(Keyframe{tick, out_.size()});
+    }
+
+    out_.push_back(keyframe ? KeyFrame : DeltaFrame);
+    putVarint(out_, tick);
+    out_.push_back(static_cast<std::uint8_t>(engine.getStatus()));
+    if (engine.isFinished()) {
+        putString(out_, engine.getWinner());
+    }
+
+    if (keyframe) {
+        for (int i = 0; i < count; i++) {
+            putSigned(out_, x[i]);
+            putSigned(out_, y[i]);
+            putSigned(out_, health[i]);
+            putVarint(out_, cooldown[i]);
+            out_.push_back(alive[i]);
+        }
+    } else {
+        // Count first, so the changed records can follow in one pass
+        int changed = 0;
+        for (int i = 0; i < count; i++) {
+            if (x[i] != x_[i] || y[i] != y_[i] || health[i] != health_[i] ||
+                cooldown[i] != cooldown_[i] || alive[i] != alive_[i]) {
+                changed++;
+            }
+        }
+        putVarint(out_, changed);
+
+        int previous = -1;
+        for (int i = 0; i < count && changed > 0; i++) {
+            std::uint8_t mask = 0;
+            if (x[i] != x_[i]) mask |= FieldX;
+            if (y[i] != y_[i]) mask |= FieldY;
+            if (health[i] != health_[i]) mask |= FieldHealth;
+            if (cooldown[i] != cooldown_[i]) mask |= FieldCooldown;
+            if (alive[i] != alive_[i]) mask |= FieldAlive;
+            if (!mask) continue;
+
+            putVarint(out_, i - previous - 1);
+            out_.push_back(mask);
+            if (mask & FieldX) putSigned(out_, x[i] - x_[i]);
+            if (mask & FieldY) putSigned(out_, y[i] - y_[i]);
+            if (mask & FieldHealth) putSigned(out_, health[i] - health_[i]);
+            if (mask & FieldCooldown) putVarint(out_, cooldown[i]);
+            previous = i;
+            changed--;
+        }
+    }
+
+    std::copy(x, x + count, x_.begin());
+    std::copy(y, y + count, y_.begin());
+    std::copy(health, health + count, health_.begin());
+    std::copy(cooldown, cooldown + count, cooldown_.begin());
+    std::copy(alive, alive + count, alive_.begin());
+    lastTick_ = tick;
+}
+
+std::vector<std::uint8_t> ReplayRecorder::finish() {
+    if (!finished_ && !out_.empty()) {
+        const size_t footer = out_.size();
+        putVarint(out_, keyframes_.size());
+        for (const Keyframe& keyframe : keyframes_) {
+            putVarint(out_, keyframe.tick);
+            putVarint(out_, keyframe.offset);
+        }
+        putVarint(out_, lastTick_);
+        for (int i = 0; i < 4; i++) {
+            out_.push_back(static_cast<std::uint8_t>(footer >> (8 * i)));
+        }
+        finished_ = true;
+    }
+    return out_;
+}
+
+// ReplayReader implementation
+ReplayReader::ReplayReader()
+    : cursor_(0), framesEnd_(0), width_(0), height_(0), keyframeInterval_(0),
+      lastTick_(0), positioned_(false) {}
+
+bool ReplayReader::open(const std::vector<std::uint8_t>& data) {
+    data_ = data;
+    roster_.clear();
+    terrain_ = TerrainGrid();
+    keyframes_.clear();
+    positioned_ = false;
+
+    if (data_.size() < 9 || !std::equal(kReplayMagic, kReplayMagic + 4, data_.begin())) {
+        return false;
+    }
+
+    // Footer first: it bounds the frame section
+    const size_t tail = data_.size() - 4;
+    size_t footer = 0;
+    for (int i = 0; i < 4; i++) {
+        footer |= static_cast<size_t>(data_[tail + i]) << (8 * i);
+    }
+    if (footer >= tail) return false;
+
+    ByteReader index(data_, footer, tail);
+    const std::uint64_t keyframeCount = index.varint();
+    for (std::uint64_t k = 0; k < keyframeCount && index.ok; k++) {
+        Keyframe keyframe;
+        keyframe.tick = index.integer();
+        keyframe.offset = static_cast<size_t>(index.varint());
+        if (keyframe.offset >= footer) return false;
+        keyframes_.push_back(keyframe);
+    }
+    lastTick_ = index.integer();
+    if (!index.ok || keyframes_.empty()) return false;
+    framesEnd_ = footer;
+
+    ByteReader in(data_, 4, footer);
+    if (in.byte() != kReplayVersion) return false;
+    width_ = in.integer();
+    height_ = in.integer();
+    keyframeInterval_ = in.integer();
+
+    const std::uint64_t unitCount = in.varint();
+    for (std::uint64_t i = 0; i < unitCount && in.ok; i++) {
+        Unit unit;
+        unit.id = in.string();
+        unit.team = in.string();
+        unit.type = in.string();
+        unit.maxHealth = in.signedInt();
+        unit.attack = in.signedInt();
+        unit.defense = in.signedInt();
+        unit.speed = in.signedInt();
+        unit.range = in.signedInt();
+        roster_.push_back(unit);
+    }
+
+    // Sizes are checked before allocating: at most kMaxPalette entries, and
+    // one byte or more per cell (0 x 0 is an empty terrain)
+    const std::uint64_t paletteSize = in.varint();
+    if (!in.ok || paletteSize > static_cast<std::uint64_t>(TerrainGrid::kMaxPalette)) return false;
+    if (width_ < 0 || height_ < 0 || (width_ == 0) != (height_ == 0)) return false;
+    std::vector<TerrainCell> palette(static_cast<size_t>(paletteSize));
+    for (auto& cell : palette) {
+        if (!in.ok) break;
+        cell.type = in.string();
+        cell.moveCost = in.real();
+    }
+    const std::uint64_t cellCount = static_cast<std::uint64_t>(width_) * static_cast<std::uint64_t>(height_);
+    if (!in.ok || cellCount > in.end - in.pos) return false;
+    std::vector<std::uint8_t> cells(static_cast<size_t>(cellCount));
+    for (std::uint8_t& cell : cells) {
+        std::uint64_t entry = in.varint();
+        if (entry >= palette.size()) return false;
+        cell = static_cast<std::uint8_t>(entry);
+    }
+    if (!cells.empty() && !TerrainGrid::fromPacked(cells.data(), width_, height_, palette, terrain_)) {
+        return false;
+    }
+    if (!in.ok) return false;
+
+    // Roster fields double as the initial dynamic state
+    const size_t count = roster_.size();
+    frame_ = ReplayFrame();
+    frame_.x.assign(count, 0);
+    frame_.y.assign(count, 0);
+    frame_.health.assign(count, 0);
+    frame_.cooldown.assign(count, 0);
+    frame_.alive.assign(count, 0);
+    return seek(keyframes_.front().tick);
+}
+
+bool ReplayReader::readFrame() {
+    ByteReader in(data_, cursor_, framesEnd_);
+    const std::uint8_t kind = in.byte();
+    frame_.tick = in.integer();
+    frame_.status = static_cast<BattleStatus>(in.byte());
+    frame_.winner = frame_.status == BattleStatus::Finished ? in.string() : std::string();
+
+    const int count = static_cast<int>(roster_.size());
+    if (kind == KeyFrame) {
+        for (int i = 0; i < count; i++) {
+            frame_.x[i] = in.signedInt();
+            frame_.y[i] = in.signedInt();
+            frame_.health[i] = in.signedInt();
+            frame_.cooldown[i] = in.integer();
+            frame_.alive[i] = in.byte();
+        }
+    } else if (kind == DeltaFrame) {
+        const int changed = in.integer();
+        int slot = -1;
+        for (int k = 0; k < changed && in.ok; k++) {
+            slot += in.integer() + 1;
+            if (slot >= count) return false;
+            const std::uint8_t mask = in.byte();
+            if (mask & FieldX) frame_.x[slot] += in.signedInt();
+            if (mask & FieldY) frame_.y[slot] += in.signedInt();
+            if (mask & FieldHealth) frame_.health[slot] += in.signedInt();
+            if (mask & FieldCooldown) frame_.cooldown[slot] = in.integer();
+            if (mask & FieldAlive) frame_.alive[slot] ^= 1;
+        }
+    } else {
+        return false;
+    }
+
+    if (!in.ok) return false;
+    cursor_ = in.pos;
+    return true;
+}
+
+bool ReplayReader::seek(int tick) {
+    if (keyframes_.empty() || tick < keyframes_.front().tick || tick > lastTick_) {
+        return false;
+    }
+
+    // Skip the keyframe decode when stepping forward within reach
+    const bool forward = positioned_ && frame_.tick <= tick && tick - frame_.tick < keyframeInterval_;
+    if (!forward) {
+        auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), tick,
+                                   [](int t, const Keyframe& k) { return t < k.tick; });
+        cursor_ = std::prev(it)->offset;
+        positioned_ = readFrame();
+        if (!positioned_) return false;
+    }
+
+    while (frame_.tick < tick) {
+        if (!next()) return false;
+    }
+    return frame_.tick == tick;
+}
+
+bool ReplayReader::next() {
+    if (!positioned_ || cursor_ >= framesEnd_) {
+        return false;
+    }
+    positioned_ = readFrame();
+    return positioned_;
+}
+
+} // namespace BattleSimulator
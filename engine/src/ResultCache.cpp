@@ -0,0 +1,124 @@
+#include "ResultCache.h"
+
+namespace BattleSimulator {
+
+BattleResultCache::BattleResultCache(size_t maxBytes)
+    : maxBytes_(maxBytes), bytes_(0), hits_(0), misses_(0), evictions_(0), uncacheable_(0) {}
+
+size_t BattleResultCache::footprint(const BattleEngine::BattleStats& stats) {
+    // List node, index bucket entry and the strings' heap buffers
+    size_t bytes = sizeof(Entry) + 2 * sizeof(void*) + sizeof(Hash128) + 4 * sizeof(void*);
+    bytes += stats.winner.capacity();
+    bytes += stats.logs.capacity() * sizeof(std::string);
+    for (const std::string& line : stats.logs) {
+        bytes += line.capacity();
+    }
+    return bytes;
+}
+
+bool BattleResultCache::lookup(const Hash128& key, BattleEngine::BattleStats& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found == index_.end()) {
+        misses_++;
+        return false;
+    }
+    hits_++;
+    entries_.splice(entries_.begin(), entries_, found->second);
+    out = found->second->stats;
+    return true;
+}
+
+void BattleResultCache::insert(const Hash128& key, const BattleEngine::BattleStats& stats) {
+    const size_t bytes = footprint(stats);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found != index_.end()) {
+        bytes_ -= found->second->bytes;
+        entries_.erase(found->second);
+        index_.erase(found);
+    }
+    if (bytes > maxBytes_) return;
+    evictTo(maxBytes_ - bytes);
+    entries_.push_front(Entry{key, stats, bytes});
+    index_[key] = entries_.begin();
+    bytes_ += bytes;
+}
+
+BattleEngine::BattleStats BattleResultCache::run(BattleEngine& engine) {
+    Hash128 key;
+    if (!engine.inputHash(key)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            uncacheable_++;
+        }
+        engine.run();
+        return engine.getBattleStats();
+    }
+    BattleEngine::BattleStats stats;
+    if (lookup(key, stats)) return stats;
+    engine.run();
+    stats = engine.getBattleStats();
+    insert(key, stats);
+    return stats;
+}
+
+void BattleResultCache::evictTo(size_t limit) {
+    while (bytes_ > limit && !entries_.empty()) {
+        const Entry& last = entries_.back();
+        bytes_ -= last.bytes;
+        index_.erase(last.key);
+        entries_.pop_back();
+        evictions_++;
+    }
+}
+
+void BattleResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    bytes_ = 0;
+}
+
+void BattleResultCache::setMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxBytes_ = maxBytes;
+    evictTo(maxBytes_);
+}
+
+size_t BattleResultCache::maxBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return maxBytes_;
+}
+
+size_t BattleResultCache::memoryBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+size_t BattleResultCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+std::uint64_t BattleResultCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+std::uint64_t BattleResultCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+std::uint64_t BattleResultCache::evictions() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return evictions_;
+}
+
+std::uint64_t BattleResultCache::uncacheable() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return uncacheable_;
+}
+
+} // namespace BattleSimulator
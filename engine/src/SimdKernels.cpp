@@ -0,0 +1,303 @@
+#include "SimdKernels.h"
+#include <atomic>
+#include <climits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATTLE_HAVE_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__wasm_simd128__)
+#define BATTLE_HAVE_SIMD128_KERNELS 1
+#include <wasm_simd128.h>
+#endif
+
+namespace BattleSimulator {
+
+namespace {
+
+// Squared range threshold; ranges past sqrt(INT_MAX) accept every valid distance
+int squaredRange(int range) {
+    return range >= 46341 ? INT_MAX : range * range;
+}
+
+// Scalar reference kernels (also handle the tails of the vector loops)
+int nearestEnemyScalar(const UnitColumns& u, int x, int y, int team,
+                       int begin, int best, int bestDist) {
+    for (int i = begin; i < u.count; i++) {
+        if (!u.alive[i] || u.team[i] == team) continue;
+        int dx = u.x[i] - x;
+        int dy = u.y[i] - y;
+        int d = dx * dx + dy * dy;
+        if (d < bestDist) {
+            bestDist = d;
+            best = i;
+        }
+    }
+    return best;
+}
+
+void enemiesInRangeScalar(const UnitColumns& u, int x, int y, int team, int r2,
+                          int begin, std::vector<int>& out) {
+    for (int i = begin; i < u.count; i++) {
+        if (!u.alive[i] || u.team[i] == team) continue;
+        int dx = u.x[i] - x;
+        int dy = u.y[i] - y;
+        if (dx * dx + dy * dy <= r2) {
+            out.push_back(i);
+        }
+    }
+}
+
+int nearestEnemyPortable(const UnitColumns& u, int x, int y, int team) {
+    return nearestEnemyScalar(u, x, y, team, 0, -1, INT_MAX);
+}
+
+void enemiesInRangePortable(const UnitColumns& u, int x, int y, int team, int range,
+                            std::vector<int>& out) {
+    if (range < 0) return;
+    enemiesInRangeScalar(u, x, y, team, squaredRange(range), 0, out);
+}
+
+// Merge per-lane winners: smallest distance, then lowest slot
+int reduceLanes(const int* dist, const int* slot, int lanes, int& bestDist) {
+    int best = -1;
+    bestDist = INT_MAX;
+    for (int l = 0; l < lanes; l++) {
+        if (slot[l] < 0) continue;
+        if (dist[l] < bestDist || (dist[l] == bestDist && slot[l] < best)) {
+            bestDist = dist[l];
+            best = slot[l];
+        }
+    }
+    return best;
+}
+
+#ifdef BATTLE_HAVE_AVX2_KERNELS
+
+__attribute__((target("avx2")))
+int nearestEnemyAvx2(const UnitColumns& u, int x, int y, int team) {
+    const __m256i vx = _mm256_set1_epi32(x);
+    const __m256i vy = _mm256_set1_epi32(y);
+    const __m256i vteam = _mm256_set1_epi32(team);
+    const __m256i vmax = _mm256_set1_epi32(INT_MAX);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i step = _mm256_set1_epi32(8);
+
+    __m256i slot = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i bestDist = vmax;
+    __m256i bestSlot = _mm256_set1_epi32(-1);
+
+    int i = 0;
+    for (; i + 8 <= u.count; i += 8) {
+        __m256i dx = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(u.x + i)), vx);
+        __m256i dy = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(u.y + i)), vy);
+        __m256i d = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+
+        __m256i alive = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u.alive + i)));
+        __m256i teams = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u.team + i));
+        __m256i reject = _mm256_or_si256(_mm256_cmpeq_epi32(alive, zero),
+                                         _mm256_cmpeq_epi32(teams, vteam));
+        d = _mm256_blendv_epi8(d, vmax, reject);
+
+        // Strictly closer only, so each lane keeps its earliest slot on ties
+        __m256i better = _mm256_cmpgt_epi32(bestDist, d);
+        bestDist = _mm256_blendv_epi8(bestDist, d, better);
+        bestSlot = _mm256_blendv_epi8(bestSlot, slot, better);
+        slot = _mm256_add_epi32(slot, step);
+    }
+
+    alignas(32) int dist[8];
+    alignas(32) int slots[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(dist), bestDist);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(slots), bestSlot);
+
+    int laneDist = INT_MAX;
+    int best = reduceLanes(dist, slots, 8, laneDist);
+    return nearestEnemyScalar(u, x, y, team, i, best, laneDist);
+}
+
+__attribute__((target("avx2")))
+void enemiesInRangeAvx2(const UnitColumns& u, int x, int y, int team, int range,
+                        std::vector<int>& out) {
+    if (range < 0) return;
+    const int r2 = squaredRange(range);
+
+    const __m256i vx = _mm256_set1_epi32(x);
+    const __m256i vy = _mm256_set1_epi32(y);
+    const __m256i vteam = _mm256_set1_epi32(team);
+    const __m256i vr2 = _mm256_set1_epi32(r2);
+    const __m256i zero = _mm256_setzero_si256();
+
+    int i = 0;
+    for (; i + 8 <= u.count; i += 8) {
+        __m256i dx = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(u.x + i)), vx);
+        __m256i dy = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(u.y + i)), vy);
+        __m256i d = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+
+        __m256i alive = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u.alive + i)));
+        __m256i teams = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u.team + i));
+        __m256i reject = _mm256_or_si256(_mm256_cmpeq_epi32(alive, zero),
+                                         _mm256_cmpeq_epi32(teams, vteam));
+        reject = _mm256_or_si256(reject, _mm256_cmpgt_epi32(d, vr2));
+
+        unsigned bits = ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(reject))) & 0xffu;
+        while (bits) {
+            out.push_back(i + __builtin_ctz(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    enemiesInRangeScalar(u, x, y, team, r2, i, out);
+}
+
+#endif // BATTLE_HAVE_AVX2_KERNELS
+
+#ifdef BATTLE_HAVE_SIMD128_KERNELS
+
+int nearestEnemySimd128(const UnitColumns& u, int x, int y, int team) {
+    const v128_t vx = wasm_i32x4_splat(x);
+    const v128_t vy = wasm_i32x4_splat(y);
+    const v128_t vteam = wasm_i32x4_splat(team);
+    const v128_t vmax = wasm_i32x4_splat(INT_MAX);
+    const v128_t zero = wasm_i32x4_splat(0);
+    const v128_t step = wasm_i32x4_splat(4);
+
+    v128_t slot = wasm_i32x4_make(0, 1, 2, 3);
+    v128_t bestDist = vmax;
+    v128_t bestSlot = wasm_i32x4_splat(-1);
+
+    int i = 0;
+    for (; i + 4 <= u.count; i += 4) {
+        v128_t dx = wasm_i32x4_sub(wasm_v128_load(u.x + i), vx);
+        v128_t dy = wasm_i32x4_sub(wasm_v128_load(u.y + i), vy);
+        v128_t d = wasm_i32x4_add(wasm_i32x4_mul(dx, dx), wasm_i32x4_mul(dy, dy));
+
+        v128_t alive = wasm_i32x4_make(u.alive[i], u.alive[i + 1], u.alive[i + 2], u.alive[i + 3]);
+        v128_t reject = wasm_v128_or(wasm_i32x4_eq(alive, zero),
+                                     wasm_i32x4_eq(wasm_v128_load(u.team + i), vteam));
+        d = wasm_v128_bitselect(vmax, d, reject);
+
+        v128_t better = wasm_i32x4_lt(d, bestDist);
+        bestDist = wasm_v128_bitselect(d, bestDist, better);
+        bestSlot = wasm_v128_bitselect(slot, bestSlot, better);
+        slot = wasm_i32x4_add(slot, step);
+    }
+
+    int dist[4];
+    int slots[4];
+    wasm_v128_store(dist, bestDist);
+    wasm_v128_store(slots, bestSlot);
+
+    int laneDist = INT_MAX;
+    int best = reduceLanes(dist, slots, 4, laneDist);
+    return nearestEnemyScalar(u, x, y, team, i, best, laneDist);
+}
+
+void enemiesInRangeSimd128(const UnitColumns& u, int x, int y, int team, int range,
+                           std::vector<int>& out) {
+    if (range < 0) return;
+    const int r2 = squaredRange(range);
+
+    const v128_t vx = wasm_i32x4_splat(x);
+    const v128_t vy = wasm_i32x4_splat(y);
+    const v128_t vteam = wasm_i32x4_splat(team);
+    const v128_t vr2 = wasm_i32x4_splat(r2);
+    const v128_t zero = wasm_i32x4_splat(0);
+
+    int i = 0;
+    for (; i + 4 <= u.count; i += 4) {
+        v128_t dx = wasm_i32x4_sub(wasm_v128_load(u.x + i), vx);
+        v128_t dy = wasm_i32x4_sub(wasm_v128_load(u.y + i), vy);
+        v128_t d = wasm_i32x4_add(wasm_i32x4_mul(dx, dx), wasm_i32x4_mul(dy, dy));
+
+        v128_t alive = wasm_i32x4_make(u.alive[i], u.alive[i + 1], u.alive[i + 2], u.alive[i + 3]);
+        v128_t reject = wasm_v128_or(wasm_i32x4_eq(alive, zero),
+                                     wasm_i32x4_eq(wasm_v128_load(u.team + i), vteam));
+        v128_t hit = wasm_v128_andnot(wasm_i32x4_le(d, vr2), reject);
+
+        unsigned bits = wasm_i32x4_bitmask(hit);
+        while (bits) {
+            out.push_back(i + __builtin_ctz(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    enemiesInRangeScalar(u, x, y, team, r2, i, out);
+}
+
+#endif // BATTLE_HAVE_SIMD128_KERNELS
+
+using NearestKernel = int (*)(const UnitColumns&, int, int, int);
+using RangeKernel = void (*)(const UnitColumns&, int, int, int, int, std::vector<int>&);
+
+struct KernelTable {
+    SimdLevel level;
+    NearestKernel nearest;
+    RangeKernel inRange;
+};
+
+KernelTable tableFor(SimdLevel level) {
+    switch (level) {
+#ifdef BATTLE_HAVE_AVX2_KERNELS
+        case SimdLevel::AVX2:
+            return KernelTable{SimdLevel::AVX2, nearestEnemyAvx2, enemiesInRangeAvx2};
+#endif
+#ifdef BATTLE_HAVE_SIMD128_KERNELS
+        case SimdLevel::SIMD128:
+            return KernelTable{SimdLevel::SIMD128, nearestEnemySimd128, enemiesInRangeSimd128};
+#endif
+        default:
+            return KernelTable{SimdLevel::Scalar, nearestEnemyPortable, enemiesInRangePortable};
+    }
+}
+
+std::atomic<int>& activeLevel() {
+    static std::atomic<int> level(static_cast<int>(detectSimdLevel()));
+    return level;
+}
+
+} // namespace
+
+SimdLevel detectSimdLevel() {
+#if defined(BATTLE_HAVE_SIMD128_KERNELS)
+    return SimdLevel::SIMD128;
+#elif defined(BATTLE_HAVE_AVX2_KERNELS)
+    return __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 : SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel getSimdLevel() {
+    return static_cast<SimdLevel>(activeLevel().load(std::memory_order_relaxed));
+}
+
+SimdLevel setSimdLevel(SimdLevel level) {
+    SimdLevel best = detectSimdLevel();
+    if (level != SimdLevel::Scalar && level != best) {
+        level = best;
+    }
+    activeLevel().store(static_cast<int>(level), std::memory_order_relaxed);
+    return level;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::SIMD128: return "simd128";
+        case SimdLevel::Scalar:
+        default: return "scalar";
+    }
+}
+
+int nearestEnemy(const UnitColumns& units, int x, int y, int team) {
+    return tableFor(getSimdLevel()).nearest(units, x, y, team);
+}
+
+void enemiesInRange(const UnitColumns& units, int x, int y, int team, int range,
+                    std::vector<int>& out) {
+    tableFor(getSimdLevel()).inRange(units, x, y, team, range, out);
+}
+
+} // namespace BattleSimulator
@@ -0,0 +1,142 @@
+#include "SpatialGrid.h"
+#include <cmath>
+
+namespace BattleSimulator {
+
+SpatialGrid::SpatialGrid()
+    : width_(1), height_(1), cellSize_(1), cellsX_(1), cellsY_(1), count_(0) {}
+
+void SpatialGrid::reset(int width, int height, int cellSize) {
+    width_ = std::max(1, width);
+    height_ = std::max(1, height);
+    cellSize_ = std::max(1, cellSize);
+    cellsX_ = (width_ + cellSize_ - 1) / cellSize_;
+    cellsY_ = (height_ + cellSize_ - 1) / cellSize_;
+
+    layers_.clear();
+    cellOfIndex_.clear();
+    layerOfIndex_.clear();
+    slotInCell_.clear();
+    count_ = 0;
+}
+
+void SpatialGrid::clear() {
+    reset(width_, height_, cellSize_);
+}
+
+int SpatialGrid::suggestCellSize(int width, int height, int unitCount) {
+    if (unitCount <= 0) return std::max(1, std::max(width, height));
+
+    // Aim for roughly four units per cell if the map were evenly covered
+    double area = static_cast<double>(std::max(1, width)) * std::max(1, height);
+    int size = static_cast<int>(std::sqrt(area * 4.0 / unitCount));
+    return std::max(2, std::min(32, size));
+}
+
+SpatialGrid::Layer& SpatialGrid::ensureLayer(int layer) {
+    while (layer >= layerCount()) {
+        Layer l;
+        l.cells.resize(static_cast<size_t>(cellsX_) * cellsY_);
+        l.rowCount.assign(cellsY_, 0);
+        l.colCount.assign(cellsX_, 0);
+        l.count = 0;
+        l.minCol = cellsX_;
+        l.maxCol = -1;
+        l.minRow = cellsY_;
+        l.maxRow = -1;
+        layers_.push_back(std::move(l));
+    }
+    return layers_[layer];
+}
+
+void SpatialGrid::trimBounds(Layer& l) {
+    if (l.count == 0) {
+        l.minCol = cellsX_;
+        l.maxCol = -1;
+        l.minRow = cellsY_;
+        l.maxRow = -1;
+        return;
+    }
+    while (l.colCount[l.minCol] == 0) l.minCol++;
+    while (l.colCount[l.maxCol] == 0) l.maxCol--;
+    while (l.rowCount[l.minRow] == 0) l.minRow++;
+    while (l.rowCount[l.maxRow] == 0) l.maxRow--;
+}
+
+void SpatialGrid::insert(int index, int layer, int x, int y) {
+    if (index < 0 || layer < 0) return;
+    if (index >= static_cast<int>(cellOfIndex_.size())) {
+        cellOfIndex_.resize(index + 1, -1);
+        layerOfIndex_.resize(index + 1, -1);
+        slotInCell_.resize(index + 1, -1);
+    }
+    if (cellOfIndex_[index] >= 0) {
+        remove(index);
+    }
+
+    Layer& l = ensureLayer(layer);
+    int cell = cellOf(x, y);
+    int cx = cell % cellsX_;
+    int cy = cell / cellsX_;
+
+    cellOfIndex_[index] = cell;
+    layerOfIndex_[index] = layer;
+    slotInCell_[index] = static_cast<int>(l.cells[cell].size());
+    l.cells[cell].push_back(Entry{index, x, y});
+
+    l.colCount[cx]++;
+    l.rowCount[cy]++;
+    l.minCol = std::min(l.minCol, cx);
+    l.maxCol = std::max(l.maxCol, cx);
+    l.minRow = std::min(l.minRow, cy);
+    l.maxRow = std::max(l.maxRow, cy);
+    l.count++;
+    count_++;
+}
+
+void SpatialGrid::remove(int index) {
+    if (!contains(index)) return;
+
+    Layer& l = layers_[layerOfIndex_[index]];
+    int cellIndex = cellOfIndex_[index];
+    std::vector<Entry>& cell = l.cells[cellIndex];
+    int slot = slotInCell_[index];
+
+    // Swap-remove and patch the slot of the entry that moved
+    cell[slot] = cell.back();
+    slotInCell_[cell[slot].index] = slot;
+    cell.pop_back();
+
+    l.colCount[cellIndex % cellsX_]--;
+    l.rowCount[cellIndex / cellsX_]--;
+    l.count--;
+    trimBounds(l);
+
+    cellOfIndex_[index] = -1;
+    layerOfIndex_[index] = -1;
+    slotInCell_[index] = -1;
+    count_--;
+}
+
+void SpatialGrid::move(int index, int x, int y) {
+    if (!contains(index)) return;
+
+    int cell = cellOfIndex_[index];
+    if (cell == cellOf(x, y)) {
+        Entry& e = layers_[layerOfIndex_[index]].cells[cell][slotInCell_[index]];
+        e.x = x;
+        e.y = y;
+        return;
+    }
+
+    int layer = layerOfIndex_[index];
+    remove(index);
+    insert(index, layer, x, y);
+}
+
+bool SpatialGrid::contains(int index) const {
+    return index >= 0 && index < static_cast<int>(cellOfIndex_.size()) &&
+           cellOfIndex_[index] >= 0;
+}
+
+} // namespace BattleSimulator
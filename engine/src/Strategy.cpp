@@ -0,0 +1,370 @@
+#include "Strategy.h"
+#include <cctype>
+#include <cstdlib>
+#include <utility>
+
+namespace BattleSimulator {
+
+namespace {
+
+const int kMaxRegister = 255;
+const size_t kMaxCode = 0xffff;
+// Nested ifs, parentheses and chained 'not' / signs; bounds the compiler's
+// recursion, since parentheses reuse a register and never hit kMaxRegister
+const int kMaxNesting = 64;
+
+struct NamedSensor {
+    const char* name;
+    StrategySensor sensor;
+};
+
+const NamedSensor kSensors[] = {
+    {"health", StrategySensor::Health},
+    {"maxHealth", StrategySensor::MaxHealth},
+    {"attack", StrategySensor::Attack},
+    {"defense", StrategySensor::Defense},
+    {"speed", StrategySensor::Speed},
+    {"range", StrategySensor::Range},
+    {"cooldown", StrategySensor::Cooldown},
+    {"x", StrategySensor::X},
+    {"y", StrategySensor::Y},
+    {"tick", StrategySensor::Tick},
+    {"enemyDistance", StrategySensor::EnemyDistance},
+    {"enemyHealth", StrategySensor::EnemyHealth},
+    {"enemyX", StrategySensor::EnemyX},
+    {"enemyY", StrategySensor::EnemyY},
+    {"enemyCount", StrategySensor::EnemyCount},
+    {"allyCount", StrategySensor::AllyCount},
+    {"terrainCost", StrategySensor::TerrainCost}
+};
+
+struct NamedAction {
+    const char* verb;
+    const char* object;
+    StrategyAction action;
+};
+
+const NamedAction kActions[] = {
+    {"attack", "weakest", StrategyAction::AttackWeakest},
+    {"attack", "nearest", StrategyAction::AttackNearest},
+    {"move", "up", StrategyAction::MoveUp},
+    {"move", "down", StrategyAction::MoveDown},
+    {"move", "left", StrategyAction::MoveLeft},
+    {"move", "right", StrategyAction::MoveRight},
+    {"move", "forward", StrategyAction::MoveForward},
+    {"move", "advance", StrategyAction::MoveAdvance},
+    {"move", "enemy", StrategyAction::MoveToEnemy}
+};
+
+} // namespace
+
+// Recursive-descent compiler: each expression is compiled into a target
+// register, with the registers above it free for temporaries
+class StrategyCompiler {
+public:
+    explicit StrategyCompiler(const std::string& source) : source_(source), pos_(0), depth_(0) {}
+
+    bool compile(Strategy& out, std::string& error) {
+        if (!tokenize()) {
+            error = error_;
+            return false;
+        }
+        while (peek().kind != Token::End) {
+            if (peek().kind == Token::Separator) {
+                pos_++;
+                continue;
+            }
+            if (!statement()) break;
+            if (peek().kind != Token::Separator && peek().kind != Token::End) {
+                fail("expected end of statement, found '" + peek().text + "'");
+                break;
+            }
+        }
+        if (!error_.empty()) {
+            error = error_;
+            return false;
+        }
+        out = std::move(program_);
+        return true;
+    }
+
+private:
+    // One level of nesting for the rest of the enclosing block
+    struct Nested {
+        explicit Nested(int& depth) : depth_(depth) { depth_++; }
+        ~Nested() { depth_--; }
+        int& depth_;
+    };
+    bool tooDeep() {
+        if (depth_ <= kMaxNesting) return false;
+        fail("too deeply nested");
+        return true;
+    }
+
+    struct Token {
+        enum Kind { Number, Name, Symbol, Separator, End } kind;
+        std::string text;
+        double value;
+        int line;
+    };
+
+    bool tokenize() {
+        int line = 1;
+        size_t i = 0;
+        while (i < source_.size()) {
+            const char c = source_[i];
+            if (c == '#') {
+                while (i < source_.size() && source_[i] != '\n') i++;
+            } else if (c == '\n' || c == ';') {
+                tokens_.push_back(Token{Token::Separator, c == ';' ? ";" : "end of line", 0.0, line});
+                if (c == '\n') line++;
+                i++;
+            } else if (std::isspace(static_cast<unsigned char>(c))) {
+                i++;
+            } else if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+                char* end = nullptr;
+                const double value = std::strtod(source_.c_str() + i, &end);
+                const size_t length = end - (source_.c_str() + i);
+                if (length == 0) return fail(line, "bad number");
+                tokens_.push_back(Token{Token::Number, source_.substr(i, length), value, line});
+                i += length;
+            } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                size_t end = i;
+                while (end < source_.size() && (std::isalnum(static_cast<unsigned char>(source_[end])) ||
+                                                source_[end] == '_')) {
+                    end++;
+                }
+                tokens_.push_back(Token{Token::Name, source_.substr(i, end - i), 0.0, line});
+                i = end;
+            } else {
+                static const char* const twoChar[] = {"<=", ">=", "==", "!="};
+                std::string symbol(1, c);
+                for (const char* s : twoChar) {
+                    if (source_.compare(i, 2, s) == 0) symbol = s;
+                }
+                if (symbol.size() == 1 && std::string("<>+-*/%(),").find(c) == std::string::npos) {
+                    return fail(line, std::string("unexpected character '") + c + "'");
+                }
+                tokens_.push_back(Token{Token::Symbol, symbol, 0.0, line});
+                i += symbol.size();
+            }
+        }
+        tokens_.push_back(Token{Token::End, "end of program", 0.0, line});
+        return true;
+    }
+
+    const Token& peek() const { return tokens_[pos_]; }
+    bool accept(const char* text) {
+        if (peek().kind == Token::End || peek().text != text) return false;
+        pos_++;
+        return true;
+    }
+
+    bool fail(int line, const std::string& message) {
+        if (error_.empty()) error_ = "line " + std::to_string(line) + ": " + message;
+        return false;
+    }
+    bool fail(const std::string& message) { return fail(peek().line, message); }
+
+    bool emit(Strategy::Op op, int a, int b = 0, int c = 0) {
+        if (program_.code_.size() >= kMaxCode) return fail("program too long");
+        program_.code_.push_back(Strategy::encode(op, a, b, c));
+        return true;
+    }
+    bool emitWide(Strategy::Op op, int a, size_t bc) {
+        return emit(op, a, static_cast<int>(bc & 0xff), static_cast<int>(bc >> 8));
+    }
+    // Point the jump at `at` to the next instruction
+    void patch(size_t at) {
+        const size_t target = program_.code_.size();
+        std::uint32_t& word = program_.code_[at];
+        word = (word & 0xffff) | static_cast<std::uint32_t>(target) << 16;
+    }
+
+    bool statement() {
+        if (!accept("if")) return action();
+        Nested nested(depth_);
+        if (tooDeep()) return false;
+
+        if (!expression(0)) return false;
+        if (!accept("then")) return fail("expected 'then'");
+        const size_t skipThen = program_.code_.size();
+        if (!emitWide(Strategy::JumpIfFalse, 0, 0)) return false;
+        while (peek().kind == Token::Separator) pos_++;
+        if (!statement()) return false;
+
+        // 'else' may follow on the next line
+        const size_t before = pos_;
+        while (peek().kind == Token::Separator) pos_++;
+        if (!accept("else")) {
+            pos_ = before;
+            patch(skipThen);
+            return true;
+        }
+        const size_t skipElse = program_.code_.size();
+        if (!emitWide(Strategy::Jump, 0, 0)) return false;
+        patch(skipThen);
+        while (peek().kind == Token::Separator) pos_++;
+        if (!statement()) return false;
+        patch(skipElse);
+        return true;
+    }
+
+    bool action() {
+        const Token verb = peek();
+        if (verb.kind != Token::Name) return fail("expected an action, found '" + verb.text + "'");
+        pos_++;
+        if (verb.text == "idle") return emit(Strategy::Act, static_cast<int>(StrategyAction::Idle));
+        if (verb.text == "retreat") return emit(Strategy::Act, static_cast<int>(StrategyAction::Retreat));
+        for (const NamedAction& named : kActions) {
+            if (verb.text == named.verb && accept(named.object)) {
+                return emit(Strategy::Act, static_cast<int>(named.action));
+            }
+        }
+        if (verb.text == "attack") {
+            return emit(Strategy::Act, static_cast<int>(StrategyAction::AttackNearest));
+        }
+        if (verb.text == "move") return fail("unknown move target '" + peek().text + "'");
+        return fail("unknown action '" + verb.text + "'");
+    }
+
+    // expression := and ('or' and)*
+    bool expression(int reg) {
+        Nested nested(depth_);
+        if (tooDeep() || !conjunction(reg)) return false;
+        while (accept("or")) {
+            const size_t skip = program_.code_.size();
+            if (!emitWide(Strategy::JumpIfTrue, reg, 0) || !conjunction(reg)) return false;
+            patch(skip);
+        }
+        return true;
+    }
+
+    // and := not ('and' not)*
+    bool conjunction(int reg) {
+        if (!negation(reg)) return false;
+        while (accept("and")) {
+            const size_t skip = program_.code_.size();
+            if (!emitWide(Strategy::JumpIfFalse, reg, 0) || !negation(reg)) return false;
+            patch(skip);
+        }
+        return true;
+    }
+
+    // not := 'not' not | comparison
+    bool negation(int reg) {
+        if (accept("not")) {
+            Nested nested(depth_);
+            return !tooDeep() && negation(reg) && emit(Strategy::Not, reg, reg);
+        }
+        return comparison(reg);
+    }
+
+    // comparison := sum (op sum)*
+    bool comparison(int reg) {
+        static const std::pair<const char*, Strategy::Op> ops[] = {
+            {"<", Strategy::Lt}, {"<=", Strategy::Le}, {">", Strategy::Gt},
+            {">=", Strategy::Ge}, {"==", Strategy::Eq}, {"!=", Strategy::Ne}
+        };
+        return binary(reg, ops, 6, &StrategyCompiler::sum);
+    }
+
+    bool sum(int reg) {
+        static const std::pair<const char*, Strategy::Op> ops[] = {
+            {"+", Strategy::Add}, {"-", Strategy::Sub}
+        };
+        return binary(reg, ops, 2, &StrategyCompiler::product);
+    }
+
+    bool product(int reg) {
+        static const std::pair<const char*, Strategy::Op> ops[] = {
+            {"*", Strategy::Mul}, {"/", Strategy::Div}, {"%", Strategy::Mod}
+        };
+        return binary(reg, ops, 3, &StrategyCompiler::unary);
+    }
+
+    // Left-associative chain of `ops` over operands parsed by `operand`
+    bool binary(int reg, const std::pair<const char*, Strategy::Op>* ops, int count,
+                bool (StrategyCompiler::*operand)(int)) {
+        if (!(this->*operand)(reg)) return false;
+        for (;;) {
+            int found = -1;
+            for (int i = 0; i < count && found < 0; i++) {
+                if (peek().kind == Token::Symbol && peek().text == ops[i].first) found = i;
+            }
+            if (found < 0) return true;
+            pos_++;
+            if (reg + 1 > kMaxRegister) return fail("expression too deeply nested");
+            if (!(this->*operand)(reg + 1) || !emit(ops[found].second, reg, reg, reg + 1)) return false;
+        }
+    }
+
+    bool unary(int reg) {
+        const Token sign = peek();
+        if (sign.kind != Token::Symbol || (sign.text != "-" && sign.text != "+")) return primary(reg);
+        pos_++;
+        const bool negate = sign.text == "-";
+        Nested nested(depth_);
+        if (tooDeep() || !unary(reg)) return false;
+        return !negate || emit(Strategy::Neg, reg, reg);
+    }
+
+    bool primary(int reg) {
+        const Token token = peek();
+        if (token.kind == Token::Number) {
+            pos_++;
+            return loadConstant(reg, token.value);
+        }
+        if (accept("(")) {
+            if (!expression(reg)) return false;
+            return accept(")") || fail("expected ')'");
+        }
+        if (token.kind != Token::Name) return fail("expected a value, found '" + token.text + "'");
+        pos_++;
+        if (token.text == "true" || token.text == "false") {
+            return loadConstant(reg, token.text == "true" ? 1.0 : 0.0);
+        }
+        if (token.text == "allies" || token.text == "enemies") {
+            if (!accept("(")) return fail("expected '(' after " + token.text);
+            if (reg + 1 > kMaxRegister) return fail("expression too deeply nested");
+            if (!expression(reg + 1)) return false;
+            if (!accept(")")) return fail("expected ')'");
+            const StrategySensor sensor = token.text == "allies" ? StrategySensor::AlliesWithin
+                                                                 : StrategySensor::EnemiesWithin;
+            return emit(Strategy::ReadArg, reg, static_cast<int>(sensor), reg + 1);
+        }
+        for (const NamedSensor& named : kSensors) {
+            if (token.text == named.name) {
+                return emit(Strategy::Read, reg, static_cast<int>(named.sensor));
+            }
+        }
+        return fail(token.line, "unknown sensor '" + token.text + "'");
+    }
+
+    bool loadConstant(int reg, double value) {
+        auto& constants = program_.constants_;
+        size_t index = 0;
+        while (index < constants.size() && constants[index] != value) index++;
+        if (index == constants.size()) {
+            if (index > kMaxCode) return fail("too many constants");
+            constants.push_back(value);
+        }
+        return emitWide(Strategy::LoadK, reg, index);
+    }
+
+    const std::string& source_;
+    std::vector<Token> tokens_;
+    size_t pos_;
+    int depth_;
+    Strategy program_;
+    std::string error_;
+};
+
+Strategy::Strategy() {}
+
+bool Strategy::compile(const std::string& source, Strategy& out, std::string& error) {
+    StrategyCompiler compiler(source);
+    return compiler.compile(out, error);
+}
+
+} // namespace BattleSimulator
@@ -0,0 +1,26 @@
+#include "SymbolTable.h"
+
+namespace BattleSimulator {
+
+int SymbolTable::intern(const std::string& name) {
+    auto it = handles_.find(name);
+    if (it != handles_.end()) {
+        return it->second;
+    }
+    int handle = static_cast<int>(names_.size());
+    names_.push_back(name);
+    handles_.emplace(name, handle);
+    return handle;
+}
+
+int SymbolTable::find(const std::string& name) const {
+    auto it = handles_.find(name);
+    return it != handles_.end() ? it->second : -1;
+}
+
+void SymbolTable::clear() {
+    names_.clear();
+    handles_.clear();
+}
+
+} // namespace BattleSimulator
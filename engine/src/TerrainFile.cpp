@@ -0,0 +1,513 @@
+#include "TerrainFile.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <utility>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#define BATTLE_TERRAIN_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace BattleSimulator {
+
+namespace {
+
+const char kTerrainMagic[4] = {'B', 'T', 'E', 'R'};
+const std::uint8_t kTerrainVersion = 1;
+const size_t kHeaderBytes = 16;
+const size_t kDirectoryEntryBytes = 16;
+const size_t kTileAlignment = 4096;
+const int kMinTileShift = 3;
+const int kMaxTileShift = 10;
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+std::uint64_t readLe(const std::uint8_t* p, int bytes) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+void putLe(std::vector<std::uint8_t>& out, std::uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+
+void storeLe(std::uint8_t* p, std::uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+}
+
+// Zeroed buffer freed when the last grid using it goes away
+std::shared_ptr<std::uint8_t> allocateCells(size_t size) {
+    std::uint8_t* cells = static_cast<std::uint8_t*>(std::calloc(std::max<size_t>(size, 1), 1));
+    if (!cells) throw std::bad_alloc();
+    return std::shared_ptr<std::uint8_t>(cells, std::free);
+}
+
+// Minimal JSON reader for terrain arrays: strings, numbers, literals, and
+// skipping any value that isn't needed
+struct JsonCursor {
+    const std::string& text;
+    size_t pos;
+
+    explicit JsonCursor(const std::string& t) : text(t), pos(0) {}
+
+    char peek() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' ||
+                                     text[pos] == '\n' || text[pos] == '\r')) {
+            pos++;
+        }
+        return pos < text.size() ? text[pos] : '\0';
+    }
+
+    bool consume(char c) {
+        if (peek() != c) return false;
+        pos++;
+        return true;
+    }
+
+    bool literal(const char* word) {
+        peek();
+        const size_t length = std::strlen(word);
+        if (text.compare(pos, length, word) != 0) return false;
+        pos += length;
+        return true;
+    }
+
+    // Escapes other than \uXXXX below 0x80 are kept; others become '?'
+    bool string(std::string& out) {
+        if (!consume('"')) return false;
+        out.clear();
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c == '\\') {
+                if (pos >= text.size()) return false;
+                c = text[pos++];
+                switch (c) {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'r': c = '\r'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'u': {
+                        if (pos + 4 > text.size()) return false;
+                        const unsigned long code = std::strtoul(text.substr(pos, 4).c_str(), nullptr, 16);
+                        pos += 4;
+                        c = code < 0x80 ? static_cast<char>(code) : '?';
+                        break;
+                    }
+                    default: break;    // \" \\ \/
+                }
+            }
+            out.push_back(c);
+        }
+        return consume('"');
+    }
+
+    bool number(double& out) {
+        peek();
+        const char* start = text.c_str() + pos;
+        char* end = nullptr;
+        out = std::strtod(start, &end);
+        if (end == start) return false;
+        pos += end - start;
+        return true;
+    }
+
+    bool skipValue(int depth = 0) {
+        if (depth > 64) return false;
+        std::string ignored;
+        double value;
+        switch (peek()) {
+            case '"': return string(ignored);
+            case 't': return literal("true");
+            case 'f': return literal("false");
+            case 'n': return literal("null");
+            case '[':
+                pos++;
+                if (consume(']')) return true;
+                do {
+                    if (!skipValue(depth + 1)) return false;
+                } while (consume(','));
+                return consume(']');
+            case '{':
+                pos++;
+                if (consume('}')) return true;
+                do {
+                    if (!string(ignored) || !consume(':') || !skipValue(depth + 1)) return false;
+                } while (consume(','));
+                return consume('}');
+            default: return number(value);
+        }
+    }
+};
+
+// Reads one cell and returns its palette index, or -1
+int parseCell(JsonCursor& json, std::map<std::pair<std::string, double>, int>& interned,
+              std::vector<TerrainCell>& palette) {
+    TerrainCell cell;
+    const char c = json.peek();
+    if (c == '"') {
+        if (!json.string(cell.type)) return -1;
+    } else if (c == '{') {
+        json.pos++;
+        if (!json.consume('}')) {
+            std::string key;
+            do {
+                if (!json.string(key) || !json.consume(':')) return -1;
+                if (key == "type" && json.peek() == '"') {
+                    if (!json.string(cell.type)) return -1;
+                } else if (key == "moveCost" && json.peek() != 'n') {
+                    if (!json.number(cell.moveCost)) return -1;
+                } else if (!json.skipValue()) {
+                    return -1;
+                }
+            } while (json.consume(','));
+            if (!json.consume('}')) return -1;
+        }
+    } else if (!json.literal("null")) {
+        return -1;
+    }
+
+    auto inserted = interned.emplace(std::make_pair(cell.type, cell.moveCost),
+                                     static_cast<int>(palette.size()));
+    if (inserted.second) {
+        if (palette.size() == static_cast<size_t>(TerrainGrid::kMaxPalette)) return -1;
+        palette.push_back(cell);
+    }
+    return inserted.first->second;
+}
+
+} // namespace
+
+TerrainFile::TerrainFile()
+    : data_(nullptr), size_(0), mapped_(false), width_(0), height_(0), tileShift_(0),
+      tilesX_(0), tilesY_(0), contiguous_(false) {}
+
+bool TerrainFile::write(const std::string& path, const TerrainGrid& grid, int tileShift,
+                        bool compress) {
+    if (tileShift < kMinTileShift || tileShift > kMaxTileShift || grid.empty()) return false;
+    TerrainGrid retiled;
+    if (grid.tileShift() != tileShift) {
+        retiled = grid.retiled(tileShift);
+    }
+    const TerrainGrid& tiled = grid.tileShift() == tileShift ? grid : retiled;
+    const size_t tileCells = static_cast<size_t>(1) << (2 * tileShift);
+    const size_t tileCount = static_cast<size_t>(tiled.tilesX()) * tiled.tilesY();
+
+    std::vector<std::uint8_t> head(kTerrainMagic, kTerrainMagic + 4);
+    head.push_back(kTerrainVersion);
+    head.push_back(static_cast<std::uint8_t>(tileShift));
+    putLe(head, tiled.palette().size(), 2);
+    putLe(head, tiled.width(), 4);
+    putLe(head, tiled.height(), 4);
+    for (const TerrainCell& cell : tiled.palette()) {
+        const size_t length = std::min<size_t>(cell.type.size(), 0xffff);
+        putLe(head, length, 2);
+        head.insert(head.end(), cell.type.begin(), cell.type.begin() + length);
+        std::uint64_t bits;
+        std::memcpy(&bits, &cell.moveCost, sizeof(bits));
+        putLe(head, bits, 8);
+    }
+    head.resize(alignUp(head.size(), 8), 0);
+    const size_t directory = head.size();
+    head.resize(alignUp(directory + tileCount * kDirectoryEntryBytes, kTileAlignment), 0);
+
+    // Encode tiles; raw ones are written straight from the grid
+    std::vector<std::vector<std::uint8_t>> encoded(compress ? tileCount : 0);
+    size_t offset = head.size();
+    for (size_t t = 0; t < tileCount; t++) {
+        const std::uint8_t* cells = tiled.data() + t * tileCells;
+        std::uint8_t encoding = RawTile;
+        std::uint8_t fill = 0;
+        size_t size = tileCells;
+        if (compress) {
+            std::vector<std::uint8_t>& runs = encoded[t];
+            for (size_t i = 0; i < tileCells;) {
+                size_t run = 1;
+                while (i + run < tileCells && run < 255 && cells[i + run] == cells[i]) run++;
+                runs.push_back(static_cast<std::uint8_t>(run));
+                runs.push_back(cells[i]);
+                i += run;
+            }
+            if (std::all_of(cells, cells + tileCells, [cells](std::uint8_t c) { return c == cells[0]; })) {
+                encoding = FillTile;
+                fill = cells[0];
+                size = 0;
+            } else if (runs.size() < tileCells) {
+                encoding = RleTile;
+                size = runs.size();
+            }
+            if (encoding != RleTile) runs.clear();
+        }
+        std::uint8_t* entry = head.data() + directory + t * kDirectoryEntryBytes;
+        storeLe(entry, offset, 8);
+        storeLe(entry + 8, size, 4);
+        entry[12] = encoding;
+        entry[13] = fill;
+        offset += size;
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write(reinterpret_cast<const char*>(head.data()), head.size());
+    for (size_t t = 0; t < tileCount && out; t++) {
+        const std::uint8_t encoding = head[directory + t * kDirectoryEntryBytes + 12];
+        if (encoding == RawTile) {
+            out.write(reinterpret_cast<const char*>(tiled.data() + t * tileCells), tileCells);
+        } else if (encoding == RleTile) {
+            out.write(reinterpret_cast<const char*>(encoded[t].data()), encoded[t].size());
+        }
+    }
+    return static_cast<bool>(out.flush());
+}
+
+bool TerrainFile::parseJson(const std::string& text, TerrainGrid& out) {
+    JsonCursor json(text);
+    if (json.consume('{')) {
+        // Battle configuration object: find its "terrain" member
+        std::string key;
+        bool found = false;
+        do {
+            if (!json.string(key) || !json.consume(':')) return false;
+            if (key == "terrain") {
+                found = true;
+                break;
+            }
+            if (!json.skipValue()) return false;
+        } while (json.consume(','));
+        if (!found) return false;
+    }
+
+    std::map<std::pair<std::string, double>, int> interned;
+    std::vector<TerrainCell> palette;
+    std::vector<std::vector<std::uint8_t>> rows;
+    size_t width = 0;
+    if (!json.consume('[')) return false;
+    if (!json.consume(']')) {
+        do {
+            if (!json.consume('[')) return false;
+            rows.emplace_back();
+            std::vector<std::uint8_t>& row = rows.back();
+            if (!json.consume(']')) {
+                do {
+                    const int entry = parseCell(json, interned, palette);
+                    if (entry < 0) return false;
+                    row.push_back(static_cast<std::uint8_t>(entry));
+                } while (json.consume(','));
+                if (!json.consume(']')) return false;
+            }
+            width = std::max(width, row.size());
+        } while (json.consume(','));
+        if (!json.consume(']')) return false;
+    }
+    if (rows.empty() || width == 0) return false;
+
+    // Short rows are padded with ground, as setTerrain does
+    std::vector<std::uint8_t> cells(rows.size() * width);
+    for (size_t y = 0; y < rows.size(); y++) {
+        if (rows[y].size() < width) {
+            TerrainCell cell;
+            auto inserted = interned.emplace(std::make_pair(cell.type, cell.moveCost),
+                                             static_cast<int>(palette.size()));
+            if (inserted.second) {
+                if (palette.size() == static_cast<size_t>(TerrainGrid::kMaxPalette)) return false;
+                palette.push_back(cell);
+            }
+            rows[y].resize(width, static_cast<std::uint8_t>(inserted.first->second));
+        }
+        std::copy(rows[y].begin(), rows[y].end(), cells.begin() + y * width);
+    }
+    return TerrainGrid::fromPacked(cells.data(), static_cast<int>(width), static_cast<int>(rows.size()),
+                                   palette, out);
+}
+
+bool TerrainFile::open(const std::string& path) {
+    close();
+
+#ifdef BATTLE_TERRAIN_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+    storage_ = std::shared_ptr<const void>(mapping, [size](const void* p) {
+        ::munmap(const_cast<void*>(p), size);
+    });
+    data_ = static_cast<const std::uint8_t*>(mapping);
+    size_ = size;
+    mapped_ = true;
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    const std::streamsize length = in.tellg();
+    if (length <= 0) return false;
+    auto buffer = std::make_shared<std::vector<std::uint8_t>>(static_cast<size_t>(length));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(buffer->data()), length)) return false;
+    data_ = buffer->data();
+    size_ = buffer->size();
+    storage_ = buffer;
+    mapped_ = false;
+#endif
+
+    const std::uint8_t* p = data_;
+    if (size_ < kHeaderBytes || std::memcmp(p, kTerrainMagic, 4) != 0 || p[4] != kTerrainVersion) {
+        close();
+        return false;
+    }
+    tileShift_ = p[5];
+    const size_t paletteSize = static_cast<size_t>(readLe(p + 6, 2));
+    const std::uint64_t width = readLe(p + 8, 4);
+    const std::uint64_t height = readLe(p + 12, 4);
+    if (tileShift_ < kMinTileShift || tileShift_ > kMaxTileShift || paletteSize == 0 ||
+        paletteSize > static_cast<size_t>(TerrainGrid::kMaxPalette) ||
+        width == 0 || height == 0 || width > 0x7fffffff || height > 0x7fffffff) {
+        close();
+        return false;
+    }
+    width_ = static_cast<int>(width);
+    height_ = static_cast<int>(height);
+    const std::uint64_t tileSize = 1u << tileShift_;
+    tilesX_ = static_cast<int>((width + tileSize - 1) >> tileShift_);
+    tilesY_ = static_cast<int>((height + tileSize - 1) >> tileShift_);
+
+    size_t pos = kHeaderBytes;
+    palette_.resize(paletteSize);
+    for (TerrainCell& cell : palette_) {
+        if (size_ - pos < 2) { close(); return false; }
+        const size_t length = static_cast<size_t>(readLe(p + pos, 2));
+        pos += 2;
+        if (size_ - pos < length + 8) { close(); return false; }
+        cell.type.assign(reinterpret_cast<const char*>(p + pos), length);
+        pos += length;
+        const std::uint64_t bits = readLe(p + pos, 8);
+        std::memcpy(&cell.moveCost, &bits, sizeof(bits));
+        pos += 8;
+    }
+
+    const std::uint64_t tileCount = static_cast<std::uint64_t>(tilesX_) * tilesY_;
+    const size_t directory = alignUp(pos, 8);
+    if (directory > size_ || tileCount > (size_ - directory) / kDirectoryEntryBytes) {
+        close();
+        return false;
+    }
+    const size_t tileCells = static_cast<size_t>(tileSize * tileSize);
+    tiles_.resize(static_cast<size_t>(tileCount));
+    contiguous_ = true;
+    for (size_t t = 0; t < tiles_.size(); t++) {
+        const std::uint8_t* e = p + directory + t * kDirectoryEntryBytes;
+        TileEntry& entry = tiles_[t];
+        entry.offset = readLe(e, 8);
+        entry.size = static_cast<std::uint32_t>(readLe(e + 8, 4));
+        entry.encoding = e[12];
+        entry.fill = e[13];
+
+        bool valid = entry.offset <= size_ && entry.size <= size_ - entry.offset;
+        if (entry.encoding == RawTile) {
+            valid = valid && entry.size == tileCells;
+        } else if (entry.encoding == FillTile) {
+            valid = valid && entry.fill < paletteSize;
+        } else if (entry.encoding == RleTile && valid && entry.size % 2 == 0) {
+            // Runs are small next to raw tiles; check them up front
+            size_t cells = 0;
+            for (size_t i = 0; i < entry.size && valid; i += 2) {
+                const std::uint8_t run = p[entry.offset + i];
+                valid = run > 0 && p[entry.offset + i + 1] < paletteSize;
+                cells += run;
+            }
+            valid = valid && cells == tileCells;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            close();
+            return false;
+        }
+        contiguous_ = contiguous_ && entry.encoding == RawTile &&
+                      entry.offset == tiles_[0].offset + t * tileCells;
+    }
+    if (!contiguous_) {
+        decoded_.resize(tiles_.size());
+    }
+    return true;
+}
+
+void TerrainFile::close() {
+    storage_.reset();
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    width_ = height_ = tileShift_ = tilesX_ = tilesY_ = 0;
+    palette_.clear();
+    tiles_.clear();
+    contiguous_ = false;
+    std::lock_guard<std::mutex> lock(decodeMutex_);
+    decoded_.clear();
+}
+
+void TerrainFile::decode(const TileEntry& entry, std::uint8_t* out) const {
+    const size_t tileCells = static_cast<size_t>(1) << (2 * tileShift_);
+    const std::uint8_t* in = data_ + entry.offset;
+    if (entry.encoding == RawTile) {
+        std::memcpy(out, in, tileCells);
+    } else if (entry.encoding == FillTile) {
+        std::memset(out, entry.fill, tileCells);
+    } else {
+        for (size_t i = 0; i < entry.size; i += 2) {
+            std::memset(out, in[i + 1], in[i]);
+            out += in[i];
+        }
+    }
+}
+
+const std::uint8_t* TerrainFile::tile(int tx, int ty) const {
+    if (tx < 0 || ty < 0 || tx >= tilesX_ || ty >= tilesY_) return nullptr;
+    const size_t t = static_cast<size_t>(ty) * tilesX_ + tx;
+    const TileEntry& entry = tiles_[t];
+    if (entry.encoding == RawTile) {
+        return data_ + entry.offset;
+    }
+    std::lock_guard<std::mutex> lock(decodeMutex_);
+    if (!decoded_[t]) {
+        decoded_[t].reset(new std::uint8_t[static_cast<size_t>(1) << (2 * tileShift_)]);
+        decode(entry, decoded_[t].get());
+    }
+    return decoded_[t].get();
+}
+
+TerrainGrid TerrainFile::grid() const {
+    if (!isOpen()) return TerrainGrid();
+    if (contiguous_) {
+        return TerrainGrid::wrap(width_, height_, tileShift_, palette_,
+                                 data_ + tiles_[0].offset, storage_);
+    }
+    const size_t tileCells = static_cast<size_t>(1) << (2 * tileShift_);
+    std::shared_ptr<std::uint8_t> cells = allocateCells(tiles_.size() * tileCells);
+    for (size_t t = 0; t < tiles_.size(); t++) {
+        decode(tiles_[t], cells.get() + t * tileCells);
+    }
+    return TerrainGrid::wrap(width_, height_, tileShift_, palette_, cells.get(), cells);
+}
+
+} // namespace BattleSimulator
@@ -0,0 +1,136 @@
+#include "TerrainGrid.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <map>
+#include <utility>
+
+namespace BattleSimulator {
+
+TerrainGrid::TerrainGrid()
+    : width_(0), height_(0), tileShift_(0), tilesX_(0), tilesY_(0), cells_(nullptr) {}
+
+TerrainGrid::TerrainGrid(int width, int height, const TerrainCell& fill, int tileShift)
+    : palette_(1, fill) {
+    allocate(width, height, tileShift);
+}
+
+std::uint8_t* TerrainGrid::allocate(int width, int height, int tileShift) {
+    width_ = width > 0 ? width : 0;
+    height_ = height > 0 ? height : 0;
+    tileShift_ = tileShift > 0 ? tileShift : 0;
+    const int size = 1 << tileShift_;
+    tilesX_ = (width_ + size - 1) >> tileShift_;
+    tilesY_ = (height_ + size - 1) >> tileShift_;
+    // calloc rather than a vector: large blocks come from fresh zero pages
+    // that stay unmapped until a cell is written
+    std::uint8_t* cells = static_cast<std::uint8_t*>(std::calloc(std::max<size_t>(dataSize(), 1), 1));
+    if (!cells) throw std::bad_alloc();
+    storage_ = std::shared_ptr<const void>(cells, std::free);
+    cells_ = cells;
+    return cells;
+}
+
+TerrainGrid TerrainGrid::wrap(int width, int height, int tileShift, std::vector<TerrainCell> palette,
+                              const std::uint8_t* cells, std::shared_ptr<const void> storage) {
+    TerrainGrid grid;
+    grid.width_ = width;
+    grid.height_ = height;
+    grid.tileShift_ = tileShift;
+    const int size = 1 << tileShift;
+    grid.tilesX_ = (width + size - 1) >> tileShift;
+    grid.tilesY_ = (height + size - 1) >> tileShift;
+    grid.palette_ = std::move(palette);
+    grid.palette_.resize(kMaxPalette, TerrainCell("void", 0.0));
+    grid.cells_ = cells;
+    grid.storage_ = std::move(storage);
+    return grid;
+}
+
+bool TerrainGrid::fromRows(const std::vector<std::vector<TerrainCell>>& rows, TerrainGrid& out,
+                           int tileShift) {
+    int width = 0;
+    for (const auto& row : rows) {
+        width = std::max(width, static_cast<int>(row.size()));
+    }
+
+    TerrainGrid grid;
+    std::uint8_t* cells = grid.allocate(width, static_cast<int>(rows.size()), tileShift);
+    std::map<std::pair<std::string, double>, int> interned;
+    auto intern = [&](const TerrainCell& cell) {
+        auto inserted = interned.emplace(std::make_pair(cell.type, cell.moveCost),
+                                         static_cast<int>(grid.palette_.size()));
+        if (inserted.second) {
+            grid.palette_.push_back(cell);
+        }
+        return inserted.first->second;
+    };
+
+    for (int y = 0; y < grid.height_; y++) {
+        const auto& row = rows[y];
+        for (int x = 0; x < width; x++) {
+            const int entry = x < static_cast<int>(row.size()) ? intern(row[x]) : intern(TerrainCell());
+            if (entry >= kMaxPalette) return false;
+            cells[grid.index(x, y)] = static_cast<std::uint8_t>(entry);
+        }
+    }
+    if (grid.palette_.empty()) {
+        grid.palette_.push_back(TerrainCell());
+    }
+    out = std::move(grid);
+    return true;
+}
+
+bool TerrainGrid::fromPacked(const std::uint8_t* cells, int width, int height,
+                             const std::vector<TerrainCell>& palette, TerrainGrid& out,
+                             int tileShift) {
+    if (width <= 0 || height <= 0 || !cells) return false;
+
+    // Indices are bytes, so entries past kMaxPalette can't be referenced
+    TerrainGrid grid;
+    std::uint8_t* data = grid.allocate(width, height, tileShift);
+    grid.palette_.assign(palette.begin(),
+                         palette.begin() + std::min<size_t>(palette.size(), kMaxPalette));
+    for (int y = 0; y < height; y++) {
+        const std::uint8_t* row = cells + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++) {
+            if (row[x] >= grid.palette_.size()) return false;
+            data[grid.index(x, y)] = row[x];
+        }
+    }
+    out = std::move(grid);
+    return true;
+}
+
+std::vector<std::vector<TerrainCell>> TerrainGrid::toRows() const {
+    std::vector<std::vector<TerrainCell>> rows(height_);
+    for (int y = 0; y < height_; y++) {
+        rows[y].reserve(width_);
+        for (int x = 0; x < width_; x++) {
+            rows[y].push_back(at(x, y));
+        }
+    }
+    return rows;
+}
+
+TerrainGrid TerrainGrid::retiled(int tileShift) const {
+    TerrainGrid grid;
+    std::uint8_t* cells = grid.allocate(width_, height_, tileShift);
+    grid.palette_ = palette_;
+    for (int y = 0; y < height_; y++) {
+        for (int x = 0; x < width_; x++) {
+            cells[grid.index(x, y)] = cells_[index(x, y)];
+        }
+    }
+    return grid;
+}
+
+size_t TerrainGrid::memoryBytes() const {
+    size_t bytes = sizeof(TerrainGrid) + dataSize();
+    for (const TerrainCell& cell : palette_) {
+        bytes += sizeof(TerrainCell) + cell.type.capacity();
+    }
+    return bytes;
+}
+
+} // namespace BattleSimulator
@@ -0,0 +1,168 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace BattleSimulator {
+
+namespace {
+
+// Set while a thread is executing pool chunks; nested parallelFor calls
+// made from inside a chunk run inline instead of waiting on the pool
+thread_local bool insideTask = false;
+
+} // namespace
+
+int ThreadPool::hardwareThreads() {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    return 1;
+#else
+    return std::max(1u, std::thread::hardware_concurrency());
+#endif
+}
+
+ThreadPool::ThreadPool(int threads)
+    : body_(nullptr), generation_(0), pending_(0), activeWorkers_(0), stopping_(false) {
+    if (threads < 0) {
+        threads = hardwareThreads() - 1;
+    }
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    threads = 0;
+#endif
+
+    // Queue 0 belongs to the calling thread
+    for (int i = 0; i <= threads; i++) {
+        queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for (int i = 0; i < threads; i++) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i + 1);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex_);
+        stopping_ = true;
+    }
+    jobReady_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)>& body) {
+    if (count <= 0) return;
+    grain = std::max(1, grain);
+
+    if (workers_.empty() || insideTask) {
+        for (int begin = 0; begin < count; begin += grain) {
+            body(begin, std::min(count, begin + grain));
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> run(runMutex_);
+
+    // Deal chunks round-robin so every worker starts with local work
+    int chunks = 0;
+    for (int begin = 0; begin < count; begin += grain) {
+        Queue& queue = *queues_[chunks % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.chunks.push_back(Chunk{begin, std::min(count, begin + grain)});
+        chunks++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex_);
+        body_ = &body;
+        error_ = nullptr;
+        pending_.store(chunks);
+        activeWorkers_ = workerCount();
+        generation_++;
+    }
+    jobReady_.notify_all();
+
+    runChunks(0);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(jobMutex_);
+        jobDone_.wait(lock, [this] { return pending_.load() == 0 && activeWorkers_ == 0; });
+        body_ = nullptr;
+        error = error_;
+        error_ = nullptr;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop(int worker) {
+    std::uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex_);
+            jobReady_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_) return;
+            seen = generation_;
+        }
+
+        runChunks(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(jobMutex_);
+            activeWorkers_--;
+        }
+        jobDone_.notify_all();
+    }
+}
+
+bool ThreadPool::popOrSteal(int worker, Chunk& chunk) {
+    // Own queue first, newest chunk (still warm in cache)
+    {
+        Queue& own = *queues_[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            return true;
+        }
+    }
+
+    // Then steal the oldest chunk from the other queues
+    const int queues = static_cast<int>(queues_.size());
+    for (int offset = 1; offset < queues; offset++) {
+        Queue& victim = *queues_[(worker + offset) % queues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runChunks(int worker) {
+    insideTask = true;
+
+    Chunk chunk;
+    while (popOrSteal(worker, chunk)) {
+        try {
+            (*body_)(chunk.begin, chunk.end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(jobMutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+
+        if (pending_.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(jobMutex_);
+            jobDone_.notify_all();
+        }
+    }
+
+    insideTask = false;
+}
+
+} // namespace BattleSimulator
@@ -0,0 +1,138 @@
+#include "UnitStore.h"
+#include "BattleEngine.h"
+#include <algorithm>
+
+namespace BattleSimulator {
+
+UnitStore::UnitStore() : roster(std::make_shared<Roster>()) {}
+
+UnitStore::Roster& UnitStore::mutableRoster() {
+    if (roster.use_count() > 1) {
+        roster = std::make_shared<Roster>(*roster);
+    }
+    return *roster;
+}
+
+int UnitStore::internTeam(const std::string& name) {
+    int handle = teams.intern(name);
+    if (handle >= static_cast<int>(teamAlive.size())) {
+        teamAlive.resize(handle + 1, 0);
+    }
+    return handle;
+}
+
+int UnitStore::add(const Unit& unit) {
+    int slot = size();
+    int teamHandle = internTeam(unit.team);
+
+    team.push_back(teamHandle);
+    posX.push_back(unit.position.x);
+    posY.push_back(unit.position.y);
+    health.push_back(unit.health);
+    cooldown.push_back(unit.cooldown);
+    attack.push_back(unit.attack);
+    defense.push_back(unit.defense);
+    range.push_back(unit.range);
+    speed.push_back(unit.speed);
+    alive.push_back(unit.isAlive() ? 1 : 0);
+
+    Roster& r = mutableRoster();
+    r.cold.push_back(ColdData{unit.id, r.types.intern(unit.type), unit.targetId,
+                              unit.maxHealth, unit.position.x, unit.position.y, -1});
+    if (unit.isAlive()) {
+        teamAlive[teamHandle]++;
+    }
+
+    // Chain duplicate ids so lookups still find the first alive match
+    auto inserted = r.firstSlotById.emplace(unit.id, slot);
+    if (!inserted.second) {
+        int last = inserted.first->second;
+        while (r.cold[last].nextWithSameId >= 0) {
+            last = r.cold[last].nextWithSameId;
+        }
+        r.cold[last].nextWithSameId = slot;
+    }
+    return slot;
+}
+
+int UnitStore::findAlive(const std::string& id) const {
+    auto it = roster->firstSlotById.find(id);
+    if (it == roster->firstSlotById.end()) return -1;
+
+    for (int slot = it->second; slot >= 0; slot = roster->cold[slot].nextWithSameId) {
+        if (alive[slot]) return slot;
+    }
+    return -1;
+}
+
+void UnitStore::clear() {
+    team.clear();
+    posX.clear();
+    posY.clear();
+    health.clear();
+    cooldown.clear();
+    attack.clear();
+    defense.clear();
+    range.clear();
+    speed.clear();
+    alive.clear();
+    // Start a fresh roster rather than clearing one a fork may still use
+    roster = std::make_shared<Roster>();
+    // Team handles outlive the units so per-team settings stay valid
+    std::fill(teamAlive.begin(), teamAlive.end(), 0);
+}
+
+void UnitStore::reserve(size_t count) {
+    posX.reserve(count);
+    posY.reserve(count);
+    health.reserve(count);
+    cooldown.reserve(count);
+    attack.reserve(count);
+    defense.reserve(count);
+    range.reserve(count);
+    speed.reserve(count);
+    team.reserve(count);
+    alive.reserve(count);
+    mutableRoster().cold.reserve(count);
+}
+
+bool UnitStore::takeDamage(int i, int damage) {
+    health[i] -= damage;
+    if (health[i] <= 0) {
+        health[i] = 0;
+        if (alive[i]) {
+            alive[i] = 0;
+            teamAlive[team[i]]--;
+        }
+        return true;
+    }
+    return false;
+}
+
+void UnitStore::heal(int i, int amount) {
+    if (!alive[i]) return;
+    health[i] = std::min(roster->cold[i].maxHealth, health[i] + amount);
+}
+
+Unit UnitStore::materialize(int i) const {
+    const ColdData& c = roster->cold[i];
+    Unit unit(c.id, teams.name(team[i]), roster->types.name(c.type));
+    unit.maxHealth = c.maxHealth;
+    unit.targetId = c.targetId;
+    unit.attack = attack[i];
+    unit.defense = defense[i];
+    unit.speed = speed[i];
+    unit.range = range[i];
+    refresh(i, unit);
+    return unit;
+}
+
+void UnitStore::refresh(int i, Unit& view) const {
+    view.position.x = posX[i];
+    view.position.y = posY[i];
+    view.health = health[i];
+    view.cooldown = cooldown[i];
+    view.alive = alive[i] != 0;
+}
+
+} // namespace BattleSimulator
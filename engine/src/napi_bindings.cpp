@@ -0,0 +1,1210 @@
+#include <node_api.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BattleEngine.h"
+#include "ResultCache.h"
+
+using namespace BattleSimulator;
+
+// Native Node.js addon with the JS surface of wasm_bindings.cpp, for
+// servers that can load a .node file. Differences from the WASM module:
+//   - vectors are plain JS arrays (no size()/get()), enums plain numbers
+//   - no getStateBuffer(): there is no shared heap to map views onto
+//   - runAsync()/advanceAsync() and BattleResultCache.runAsync() run the
+//     battle on a libuv worker thread and return a Promise; the engine
+//     throws if used before it settles
+// Battles with JS team callbacks can only run synchronously, since the
+// callbacks need the JS thread.
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// JS -> C++ conversion. Each reader throws a TypeError and returns false on
+// a value of the wrong type; object fields that are missing keep their
+// defaults.
+
+bool throwType(napi_env env, const char* message) {
+    bool pending = false;
+    napi_is_exception_pending(env, &pending);
+    if (!pending) napi_throw_type_error(env, nullptr, message);
+    return false;
+}
+
+bool fromJs(napi_env env, napi_value value, int& out) {
+    if (napi_get_value_int32(env, value, &out) != napi_ok) return throwType(env, "expected a number");
+    return true;
+}
+
+bool fromJs(napi_env env, napi_value value, std::uint32_t& out) {
+    if (napi_get_value_uint32(env, value, &out) != napi_ok) return throwType(env, "expected a number");
+    return true;
+}
+
+bool fromJs(napi_env env, napi_value value, double& out) {
+    if (napi_get_value_double(env, value, &out) != napi_ok) return throwType(env, "expected a number");
+    return true;
+}
+
+bool fromJs(napi_env env, napi_value value, bool& out) {
+    if (napi_get_value_bool(env, value, &out) != napi_ok) return throwType(env, "expected a boolean");
+    return true;
+}
+
+bool fromJs(napi_env env, napi_value value, std::string& out) {
+    size_t length = 0;
+    if (napi_get_value_string_utf8(env, value, nullptr, 0, &length) != napi_ok) {
+        return throwType(env, "expected a string");
+    }
+    out.assign(length, '\0');
+    if (length > 0) napi_get_value_string_utf8(env, value, &out[0], length + 1, &length);
+    return true;
+}
+
+bool isNullish(napi_env env, napi_value value) {
+    napi_valuetype type = napi_undefined;
+    napi_typeof(env, value, &type);
+    return type == napi_undefined || type == napi_null;
+}
+
+bool fromJs(napi_env env, napi_value value, Position& out);
+bool fromJs(napi_env env, napi_value value, Action::Type& out);
+template <typename T>
+bool fromJs(napi_env env, napi_value value, std::vector<T>& out);
+
+template <typename T>
+bool readField(napi_env env, napi_value object, const char* name, T& out) {
+    napi_value value = nullptr;
+    if (napi_get_named_property(env, object, name, &value) != napi_ok) return throwType(env, "expected an object");
+    return isNullish(env, value) || fromJs(env, value, out);
+}
+
+bool fromJs(napi_env env, napi_value value, Position& out) {
+    return readField(env, value, "x", out.x) && readField(env, value, "y", out.y);
+}
+
+bool fromJs(napi_env env, napi_value value, TerrainCell& out) {
+    return readField(env, value, "type", out.type) && readField(env, value, "moveCost", out.moveCost);
+}
+
+// A number, or an embind-style enum object ({ value })
+bool fromJs(napi_env env, napi_value value, Action::Type& out) {
+    napi_valuetype type = napi_undefined;
+    napi_typeof(env, value, &type);
+    int raw = static_cast<int>(out);
+    if (type == napi_object) {
+        if (!readField(env, value, "value", raw)) return false;
+    } else if (!fromJs(env, value, raw)) {
+        return false;
+    }
+    if (raw < Action::IDLE || raw > Action::HEAL) return throwType(env, "unknown action type");
+    out = static_cast<Action::Type>(raw);
+    return true;
+}
+
+bool fromJs(napi_env env, napi_value value, Action& out) {
+    return readField(env, value, "type", out.type) &&
+           readField(env, value, "targetPosition", out.targetPosition) &&
+           readField(env, value, "targetUnitId", out.targetUnitId) &&
+           readField(env, value, "direction", out.direction);
+}
+
+bool fromJs(napi_env env, napi_value value, Unit& out) {
+    return readField(env, value, "id", out.id) &&
+           readField(env, value, "team", out.team) &&
+           readField(env, value, "type", out.type) &&
+           readField(env, value, "position", out.position) &&
+           readField(env, value, "health", out.health) &&
+           readField(env, value, "maxHealth", out.maxHealth) &&
+           readField(env, value, "attack", out.attack) &&
+           readField(env, value, "defense", out.defense) &&
+           readField(env, value, "speed", out.speed) &&
+           readField(env, value, "range", out.range) &&
+           readField(env, value, "alive", out.alive) &&
+           readField(env, value, "cooldown", out.cooldown);
+}
+
+bool fromJs(napi_env env, napi_value value, PolicyParams& out) {
+    return readField(env, value, "retreatHealth", out.retreatHealth) &&
+           readField(env, value, "engageRange", out.engageRange) &&
+           readField(env, value, "leash", out.leash) &&
+           readField(env, value, "flankOffset", out.flankOffset);
+}
+
+template <typename T>
+bool fromJs(napi_env env, napi_value value, std::vector<T>& out) {
+    bool isArray = false;
+    napi_is_array(env, value, &isArray);
+    if (!isArray) return throwType(env, "expected an array");
+    std::uint32_t length = 0;
+    napi_get_array_length(env, value, &length);
+    out.assign(length, T());
+    for (std::uint32_t i = 0; i < length; i++) {
+        napi_value element = nullptr;
+        napi_get_element(env, value, i, &element);
+        if (!fromJs(env, element, out[i])) return false;
+    }
+    return true;
+}
+
+// Typed array of `expected` type (one copy), or a plain array of numbers
+template <typename T>
+bool readNumbers(napi_env env, napi_value value, napi_typedarray_type expected, std::vector<T>& out) {
+    bool isTyped = false;
+    napi_is_typedarray(env, value, &isTyped);
+    if (!isTyped) {
+        std::vector<int> numbers;
+        if (!fromJs(env, value, numbers)) return false;
+        out.assign(numbers.begin(), numbers.end());
+        return true;
+    }
+    napi_typedarray_type type = napi_int8_array;
+    size_t length = 0;
+    void* data = nullptr;
+    napi_get_typedarray_info(env, value, &type, &length, &data, nullptr, nullptr);
+    if (type != expected) return throwType(env, "unexpected typed array type");
+    const T* begin = static_cast<const T*>(data);
+    out.assign(begin, begin + length);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// C++ -> JS conversion
+
+napi_value toJs(napi_env env, const Position& position);
+napi_value toJs(napi_env env, const TerrainCell& cell);
+napi_value toJs(napi_env env, const Unit& unit);
+napi_value toJs(napi_env env, const UnitDelta& delta);
+template <typename T>
+napi_value toJs(napi_env env, const std::vector<T>& values);
+
+napi_value toJs(napi_env env, int value) {
+    napi_value out = nullptr;
+    napi_create_int32(env, value, &out);
+    return out;
+}
+
+napi_value toJs(napi_env env, double value) {
+    napi_value out = nullptr;
+    napi_create_double(env, value, &out);
+    return out;
+}
+
+napi_value toJs(napi_env env, bool value) {
+    napi_value out = nullptr;
+    napi_get_boolean(env, value, &out);
+    return out;
+}
+
+napi_value toJs(napi_env env, const std::string& value) {
+    napi_value out = nullptr;
+    napi_create_string_utf8(env, value.data(), value.size(), &out);
+    return out;
+}
+
+napi_value toJs(napi_env env, const char* value) {
+    napi_value out = nullptr;
+    napi_create_string_utf8(env, value, NAPI_AUTO_LENGTH, &out);
+    return out;
+}
+
+napi_value undefinedValue(napi_env env) {
+    napi_value out = nullptr;
+    napi_get_undefined(env, &out);
+    return out;
+}
+
+napi_value newObject(napi_env env) {
+    napi_value out = nullptr;
+    napi_create_object(env, &out);
+    return out;
+}
+
+template <typename T>
+void setField(napi_env env, napi_value object, const char* name, const T& value) {
+    napi_set_named_property(env, object, name, toJs(env, value));
+}
+
+template <typename T>
+napi_value toJs(napi_env env, const std::vector<T>& values) {
+    napi_value out = nullptr;
+    napi_create_array_with_length(env, values.size(), &out);
+    for (size_t i = 0; i < values.size(); i++) {
+        napi_set_element(env, out, static_cast<std::uint32_t>(i), toJs(env, values[i]));
+    }
+    return out;
+}
+
+napi_value toJs(napi_env env, const Position& position) {
+    napi_value out = newObject(env);
+    setField(env, out, "x", position.x);
+    setField(env, out, "y", position.y);
+    return out;
+}
+
+napi_value toJs(napi_env env, const TerrainCell& cell) {
+    napi_value out = newObject(env);
+    setField(env, out, "type", cell.type);
+    setField(env, out, "moveCost", cell.moveCost);
+    return out;
+}
+
+napi_value toJs(napi_env env, const Unit& unit) {
+    napi_value out = newObject(env);
+    setField(env, out, "id", unit.id);
+    setField(env, out, "team", unit.team);
+    setField(env, out, "type", unit.type);
+    setField(env, out, "position", unit.position);
+    setField(env, out, "health", unit.health);
+    setField(env, out, "maxHealth", unit.maxHealth);
+    setField(env, out, "attack", unit.attack);
+    setField(env, out, "defense", unit.defense);
+    setField(env, out, "speed", unit.speed);
+    setField(env, out, "range", unit.range);
+    setField(env, out, "alive", unit.alive);
+    setField(env, out, "cooldown", unit.cooldown);
+    return out;
+}
+
+napi_value toJs(napi_env env, const UnitDelta& delta) {
+    napi_value out = newObject(env);
+    setField(env, out, "index", delta.index);
+    setField(env, out, "position", delta.position);
+    setField(env, out, "health", delta.health);
+    setField(env, out, "alive", delta.alive);
+    setField(env, out, "cooldown", delta.cooldown);
+    return out;
+}
+
+napi_value toJs(napi_env env, const BattleState& state) {
+    napi_value out = newObject(env);
+    setField(env, out, "tick", state.tick);
+    setField(env, out, "units", state.units);
+    setField(env, out, "status", statusName(state.status));
+    setField(env, out, "winner", state.winner);
+    setField(env, out, "logs", state.logs);
+    return out;
+}
+
+napi_value toJs(napi_env env, const StateDelta& delta) {
+    napi_value out = newObject(env);
+    setField(env, out, "sinceTick", delta.sinceTick);
+    setField(env, out, "tick", delta.tick);
+    setField(env, out, "full", delta.full);
+    setField(env, out, "status", statusName(delta.status));
+    setField(env, out, "winner", delta.winner);
+    setField(env, out, "units", delta.units);
+    setField(env, out, "snapshot", delta.snapshot);
+    setField(env, out, "logs", delta.logs);
+    return out;
+}
+
+napi_value toJs(napi_env env, const AdvanceSummary& summary) {
+    napi_value out = newObject(env);
+    setField(env, out, "startTick", summary.startTick);
+    setField(env, out, "endTick", summary.endTick);
+    setField(env, out, "ticks", summary.ticks);
+    setField(env, out, "stoppedBy", advanceStopName(summary.stoppedBy));
+    setField(env, out, "moves", summary.moves);
+    setField(env, out, "attacks", summary.attacks);
+    setField(env, out, "damage", summary.damage);
+    setField(env, out, "kills", summary.kills);
+    return out;
+}
+
+napi_value toJs(napi_env env, const BattleEngine::BattleStats& stats) {
+    napi_value out = newObject(env);
+    setField(env, out, "totalTicks", stats.totalTicks);
+    setField(env, out, "winner", stats.winner);
+    setField(env, out, "teamAUnitsRemaining", stats.teamAUnitsRemaining);
+    setField(env, out, "teamBUnitsRemaining", stats.teamBUnitsRemaining);
+    setField(env, out, "totalDamageDealt", stats.totalDamageDealt);
+    setField(env, out, "logs", stats.logs);
+    return out;
+}
+
+napi_value toJs(napi_env env, const PerfCounters& perf) {
+    napi_value out = newObject(env);
+    setField(env, out, "ticks", perf.ticks);
+    setField(env, out, "indexMs", perf.indexMs);
+    setField(env, out, "winCheckMs", perf.winCheckMs);
+    setField(env, out, "decideMs", perf.decideMs);
+    setField(env, out, "moveMs", perf.moveMs);
+    setField(env, out, "attackMs", perf.attackMs);
+    setField(env, out, "cooldownsMs", perf.cooldownsMs);
+    setField(env, out, "loggingMs", perf.loggingMs);
+    setField(env, out, "unitsScanned", perf.unitsScanned);
+    setField(env, out, "collisionChecks", perf.collisionChecks);
+    setField(env, out, "callbackInvocations", perf.callbackInvocations);
+    setField(env, out, "decisions", perf.decisions);
+    setField(env, out, "allocations", perf.allocations);
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Wrapped objects
+
+// Tags so a BattleResultCache method can check it was handed an engine
+const napi_type_tag kEngineTag = {0x6261747473696d00ULL, 0x656e67696e650001ULL};
+const napi_type_tag kCacheTag = {0x6261747473696d00ULL, 0x6361636865000001ULL};
+
+// A JS function held for the lifetime of every engine (and fork) using it
+struct JsFunction {
+    napi_env env;
+    napi_ref ref;
+
+    JsFunction(napi_env e, napi_value function) : env(e), ref(nullptr) {
+        napi_create_reference(env, function, 1, &ref);
+    }
+    ~JsFunction() { napi_delete_reference(env, ref); }
+    JsFunction(const JsFunction&) = delete;
+    JsFunction& operator=(const JsFunction&) = delete;
+};
+
+struct EngineHandle {
+    BattleEngine engine;
+    // Set while an async run owns the engine
+    bool busy;
+    // Teams whose decisions call into JS; such battles can't run async
+    std::map<std::string, std::shared_ptr<JsFunction>> callbacks;
+
+    explicit EngineHandle(BattleEngine source) : engine(std::move(source)), busy(false) {}
+};
+
+struct CacheHandle {
+    BattleResultCache cache;
+
+    explicit CacheHandle(size_t maxBytes) : cache(maxBytes) {}
+};
+
+struct AddonData {
+    napi_ref engineConstructor;
+};
+
+void finalizeEngine(napi_env, void* data, void*) {
+    delete static_cast<EngineHandle*>(data);
+}
+
+void finalizeCache(napi_env, void* data, void*) {
+    delete static_cast<CacheHandle*>(data);
+}
+
+void finalizeAddon(napi_env env, void* data, void*) {
+    AddonData* addon = static_cast<AddonData*>(data);
+    napi_delete_reference(env, addon->engineConstructor);
+    delete addon;
+}
+
+bool throwError(napi_env env, const char* message) {
+    napi_throw_error(env, nullptr, message);
+    return false;
+}
+
+// Arguments of a method call on a wrapped object
+struct MethodCall {
+    napi_value self;
+    napi_value args[4];
+    size_t argc;
+};
+
+bool getCall(napi_env env, napi_callback_info info, MethodCall& call, size_t required) {
+    call.argc = 4;
+    call.self = nullptr;
+    if (napi_get_cb_info(env, info, &call.argc, call.args, &call.self, nullptr) != napi_ok) return false;
+    for (size_t i = call.argc; i < 4; i++) {
+        napi_get_undefined(env, &call.args[i]);
+    }
+    if (call.argc < required) return throwType(env, "missing arguments");
+    return true;
+}
+
+bool isTagged(napi_env env, napi_value object, const napi_type_tag& tag) {
+    napi_valuetype type = napi_undefined;
+    napi_typeof(env, object, &type);
+    bool tagged = false;
+    return type == napi_object && napi_check_object_type_tag(env, object, &tag, &tagged) == napi_ok && tagged;
+}
+
+// The engine behind `object`, or null (having thrown) if it isn't an engine
+// or an async run owns it
+EngineHandle* unwrapEngine(napi_env env, napi_value object) {
+    void* data = nullptr;
+    if (!isTagged(env, object, kEngineTag) || napi_unwrap(env, object, &data) != napi_ok) {
+        throwType(env, "expected a BattleEngine");
+        return nullptr;
+    }
+    EngineHandle* handle = static_cast<EngineHandle*>(data);
+    if (handle->busy) {
+        throwError(env, "BattleEngine is busy with an async run");
+        return nullptr;
+    }
+    return handle;
+}
+
+EngineHandle* engineCall(napi_env env, napi_callback_info info, MethodCall& call, size_t required = 0) {
+    if (!getCall(env, info, call, required)) return nullptr;
+    return unwrapEngine(env, call.self);
+}
+
+CacheHandle* cacheCall(napi_env env, napi_callback_info info, MethodCall& call, size_t required = 0) {
+    if (!getCall(env, info, call, required)) return nullptr;
+    void* data = nullptr;
+    if (!isTagged(env, call.self, kCacheTag) || napi_unwrap(env, call.self, &data) != napi_ok) {
+        throwType(env, "expected a BattleResultCache");
+        return nullptr;
+    }
+    return static_cast<CacheHandle*>(data);
+}
+
+// ---------------------------------------------------------------------------
+// Async runs: the battle runs in libuv's thread pool and settles a Promise
+// back on the JS thread. The wrapping objects are referenced until then so
+// they can't be collected mid-run.
+
+struct AsyncRun {
+    enum Kind { Run, Advance, CachedRun };
+
+    Kind kind;
+    napi_async_work work;
+    napi_deferred deferred;
+    napi_ref engineRef;
+    napi_ref cacheRef;
+    EngineHandle* handle;
+    CacheHandle* cache;
+    int maxTicks;
+    std::uint32_t stopEvents;
+    BattleEngine::BattleStats stats;
+    AdvanceSummary summary;
+
+    AsyncRun()
+        : kind(Run), work(nullptr), deferred(nullptr), engineRef(nullptr), cacheRef(nullptr),
+          handle(nullptr), cache(nullptr), maxTicks(0), stopEvents(0) {}
+};
+
+void executeRun(napi_env, void* data) {
+    AsyncRun* run = static_cast<AsyncRun*>(data);
+    BattleEngine& engine = run->handle->engine;
+    switch (run->kind) {
+        case AsyncRun::Run:
+            engine.run();
+            run->stats = engine.getBattleStats();
+            break;
+        case AsyncRun::Advance:
+            run->summary = engine.advance(run->maxTicks, run->stopEvents);
+            break;
+        case AsyncRun::CachedRun:
+            run->stats = run->cache->cache.run(engine);
+            break;
+    }
+}
+
+void completeRun(napi_env env, napi_status status, void* data) {
+    AsyncRun* run = static_cast<AsyncRun*>(data);
+    run->handle->busy = false;
+    if (status == napi_ok) {
+        napi_value result = run->kind == AsyncRun::Advance ? toJs(env, run->summary) : toJs(env, run->stats);
+        napi_resolve_deferred(env, run->deferred, result);
+    } else {
+        napi_value message = toJs(env, "async battle run was cancelled");
+        napi_value error = nullptr;
+        napi_create_error(env, nullptr, message, &error);
+        napi_reject_deferred(env, run->deferred, error);
+    }
+    napi_delete_reference(env, run->engineRef);
+    if (run->cacheRef) napi_delete_reference(env, run->cacheRef);
+    napi_delete_async_work(env, run->work);
+    delete run;
+}
+
+// Takes ownership of `run`; returns its Promise, or null having thrown
+napi_value queueRun(napi_env env, napi_value engineObject, napi_value cacheObject, AsyncRun* run) {
+    if (!run->handle->callbacks.empty()) {
+        delete run;
+        throwError(env, "battles with JS decision callbacks can't run async; use run()");
+        return nullptr;
+    }
+    napi_value promise = nullptr;
+    napi_value name = toJs(env, "BattleEngine.runAsync");
+    if (napi_create_promise(env, &run->deferred, &promise) != napi_ok ||
+        napi_create_async_work(env, nullptr, name, executeRun, completeRun, run, &run->work) != napi_ok) {
+        delete run;
+        throwError(env, "could not queue the async run");
+        return nullptr;
+    }
+    napi_create_reference(env, engineObject, 1, &run->engineRef);
+    if (cacheObject) napi_create_reference(env, cacheObject, 1, &run->cacheRef);
+    run->handle->busy = true;
+    napi_queue_async_work(env, run->work);
+    return promise;
+}
+
+// ---------------------------------------------------------------------------
+// BattleEngine
+
+// new BattleEngine(width, height, maxTicks), or internally with an External
+// holding the EngineHandle of a fork
+napi_value engineConstruct(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    if (!getCall(env, info, call, 1)) return nullptr;
+    EngineHandle* handle = nullptr;
+    napi_valuetype type = napi_undefined;
+    napi_typeof(env, call.args[0], &type);
+    if (type == napi_external) {
+        void* data = nullptr;
+        napi_get_value_external(env, call.args[0], &data);
+        handle = static_cast<EngineHandle*>(data);
+    } else {
+        int width = 0;
+        int height = 0;
+        int maxTicks = 1000;
+        if (!fromJs(env, call.args[0], width) || !fromJs(env, call.args[1], height)) return nullptr;
+        if (!isNullish(env, call.args[2]) && !fromJs(env, call.args[2], maxTicks)) return nullptr;
+        handle = new EngineHandle(BattleEngine(width, height, maxTicks));
+    }
+    if (napi_wrap(env, call.self, handle, finalizeEngine, nullptr, nullptr) != napi_ok) {
+        delete handle;
+        throwError(env, "could not wrap BattleEngine");
+        return nullptr;
+    }
+    napi_type_tag_object(env, call.self, &kEngineTag);
+    return call.self;
+}
+
+napi_value engineAddUnit(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    Unit unit;
+    if (!handle || !fromJs(env, call.args[0], unit)) return nullptr;
+    handle->engine.addUnit(unit);
+    return undefinedValue(env);
+}
+
+// Bulk setup: each typed array crosses the boundary as one copy
+napi_value engineAddUnitsPacked(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 2);
+    std::vector<std::int32_t> records;
+    std::vector<std::string> names;
+    if (!handle || !readNumbers(env, call.args[0], napi_int32_array, records) ||
+        !fromJs(env, call.args[1], names)) {
+        return nullptr;
+    }
+    return toJs(env, handle->engine.addUnitsPacked(records.data(),
+                                                   static_cast<int>(records.size() / kPackedUnitWords), names));
+}
+
+napi_value engineSetTerrain(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    std::vector<std::vector<TerrainCell>> rows;
+    if (!handle || !fromJs(env, call.args[0], rows)) return nullptr;
+    return toJs(env, handle->engine.setTerrain(rows));
+}
+
+napi_value engineSetTerrainPacked(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 4);
+    std::vector<std::uint8_t> cells;
+    int width = 0;
+    int height = 0;
+    std::vector<TerrainCell> palette;
+    if (!handle || !readNumbers(env, call.args[0], napi_uint8_array, cells) ||
+        !fromJs(env, call.args[1], width) || !fromJs(env, call.args[2], height) ||
+        !fromJs(env, call.args[3], palette)) {
+        return nullptr;
+    }
+    if (width < 0 || height < 0 || static_cast<long long>(cells.size()) < static_cast<long long>(width) * height) {
+        return toJs(env, false);
+    }
+    return toJs(env, handle->engine.setTerrainPacked(cells.data(), width, height, palette));
+}
+
+napi_value engineGetTerrain(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    if (!handle) return nullptr;
+    return toJs(env, handle->engine.getState().terrain->toRows());
+}
+
+// Returns "" on success, otherwise the compile error
+napi_value engineSetTeamStrategy(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 2);
+    std::string team;
+    std::string source;
+    if (!handle || !fromJs(env, call.args[0], team) || !fromJs(env, call.args[1], source)) return nullptr;
+    std::string error;
+    return toJs(env, handle->engine.setTeamStrategy(team, source, &error) ? std::string() : error);
+}
+
+napi_value engineSetStrategyBudget(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    int instructions = 0;
+    if (!handle || !fromJs(env, call.args[0], instructions)) return nullptr;
+    handle->engine.setStrategyBudget(instructions);
+    return undefinedValue(env);
+}
+
+// Policies are selected by name; returns false for an unknown name
+napi_value engineSetTeamPolicy(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 2);
+    std::string team;
+    std::string name;
+    PolicyParams params;
+    if (!handle || !fromJs(env, call.args[0], team) || !fromJs(env, call.args[1], name)) return nullptr;
+    if (!isNullish(env, call.args[2]) && !fromJs(env, call.args[2], params)) return nullptr;
+    return toJs(env, handle->engine.setTeamPolicy(team, name, params));
+}
+
+// Int32Array copies of a TeamBatch's ready columns, sharing one buffer
+// (V8 can't safely alias engine memory from external buffers)
+napi_value batchView(napi_env env, const TeamBatch& batch) {
+    const int* columns[] = {batch.slots, batch.x, batch.y, batch.health, batch.attack, batch.range, batch.speed};
+    const char* names[] = {"slots", "x", "y", "health", "attack", "range", "speed"};
+    const int columnCount = 7;
+    const size_t columnBytes = static_cast<size_t>(batch.count) * sizeof(int);
+    void* data = nullptr;
+    napi_value buffer = nullptr;
+    napi_create_arraybuffer(env, columnBytes * columnCount, &data, &buffer);
+    napi_value view = newObject(env);
+    setField(env, view, "tick", batch.tick);
+    setField(env, view, "count", batch.count);
+    for (int c = 0; c < columnCount; c++) {
+        if (data && columnBytes > 0) {
+            std::memcpy(static_cast<char*>(data) + c * columnBytes, columns[c], columnBytes);
+        }
+        napi_value column = nullptr;
+        napi_create_typedarray(env, napi_int32_array, batch.count, buffer, c * columnBytes, &column);
+        napi_set_named_property(env, view, names[c], column);
+    }
+    return view;
+}
+
+// JS batched AI: `callback(batch)` gets typed arrays of the gathered columns
+// and returns an array of Actions, one per ready unit in order. If it
+// throws, the remaining decisions of the call idle and the exception
+// surfaces when tick()/run()/advance() returns.
+napi_value engineSetTeamDecisionCallback(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 2);
+    std::string team;
+    if (!handle || !fromJs(env, call.args[0], team)) return nullptr;
+    if (isNullish(env, call.args[1])) {
+        handle->engine.setTeamDecisionCallback(team, TeamDecisionCallback());
+        handle->callbacks.erase(team);
+        return undefinedValue(env);
+    }
+    napi_valuetype type = napi_undefined;
+    napi_typeof(env, call.args[1], &type);
+    if (type != napi_function) {
+        throwType(env, "expected a function");
+        return nullptr;
+    }
+    std::shared_ptr<JsFunction> function = std::make_shared<JsFunction>(env, call.args[1]);
+    handle->callbacks[team] = function;
+    handle->engine.setTeamDecisionCallback(team, [function](const TeamBatch& batch, Action* actions) {
+        napi_env env = function->env;
+        bool pending = false;
+        napi_is_exception_pending(env, &pending);
+        if (pending) return;
+        napi_handle_scope scope = nullptr;
+        napi_open_handle_scope(env, &scope);
+        napi_value callback = nullptr;
+        napi_value global = nullptr;
+        napi_get_reference_value(env, function->ref, &callback);
+        napi_get_global(env, &global);
+        napi_value view = batchView(env, batch);
+        napi_value result = nullptr;
+        bool isArray = false;
+        if (napi_call_function(env, global, callback, 1, &view, &result) == napi_ok &&
+            napi_is_array(env, result, &isArray) == napi_ok && isArray) {
+            std::uint32_t length = 0;
+            napi_get_array_length(env, result, &length);
+            const int count = std::min(batch.count, static_cast<int>(length));
+            for (int i = 0; i < count; i++) {
+                napi_value element = nullptr;
+                napi_get_element(env, result, static_cast<std::uint32_t>(i), &element);
+                if (!fromJs(env, element, actions[i])) {
+                    actions[i] = Action();
+                    break;
+                }
+            }
+        }
+        napi_close_handle_scope(env, scope);
+    });
+    return undefinedValue(env);
+}
+
+napi_value engineUnitId(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    int slot = 0;
+    if (!handle || !fromJs(env, call.args[0], slot)) return nullptr;
+    if (slot < 0 || slot >= handle->engine.getUnitCount()) {
+        napi_throw_range_error(env, nullptr, "unit slot out of range");
+        return nullptr;
+    }
+    return toJs(env, handle->engine.unitId(slot));
+}
+
+napi_value engineGetUnitCount(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getUnitCount()) : nullptr;
+}
+
+napi_value engineGetTeamCount(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getTeamCount()) : nullptr;
+}
+
+napi_value engineInitialize(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.initialize()) : nullptr;
+}
+
+napi_value engineTick(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    if (!handle) return nullptr;
+    handle->engine.tick();
+    return undefinedValue(env);
+}
+
+napi_value engineRun(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    if (!handle) return nullptr;
+    handle->engine.run();
+    return undefinedValue(env);
+}
+
+// Promise of the BattleStats once run() finishes on a worker thread
+napi_value engineRunAsync(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    if (!handle) return nullptr;
+    AsyncRun* run = new AsyncRun();
+    run->kind = AsyncRun::Run;
+    run->handle = handle;
+    return queueRun(env, call.self, nullptr, run);
+}
+
+bool readAdvanceArgs(napi_env env, const MethodCall& call, int& maxTicks, std::uint32_t& stopEvents) {
+    if (!fromJs(env, call.args[0], maxTicks)) return false;
+    return isNullish(env, call.args[1]) || fromJs(env, call.args[1], stopEvents);
+}
+
+napi_value engineAdvance(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    int maxTicks = 0;
+    std::uint32_t stopEvents = 0;
+    if (!handle || !readAdvanceArgs(env, call, maxTicks, stopEvents)) return nullptr;
+    return toJs(env, handle->engine.advance(maxTicks, stopEvents));
+}
+
+// Promise of the AdvanceSummary, advancing on a worker thread
+napi_value engineAdvanceAsync(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    int maxTicks = 0;
+    std::uint32_t stopEvents = 0;
+    if (!handle || !readAdvanceArgs(env, call, maxTicks, stopEvents)) return nullptr;
+    AsyncRun* run = new AsyncRun();
+    run->kind = AsyncRun::Advance;
+    run->handle = handle;
+    run->maxTicks = maxTicks;
+    run->stopEvents = stopEvents;
+    return queueRun(env, call.self, nullptr, run);
+}
+
+napi_value engineReset(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    if (!handle) return nullptr;
+    handle->engine.reset();
+    return undefinedValue(env);
+}
+
+napi_value engineFork(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    if (!handle) return nullptr;
+    AddonData* addon = nullptr;
+    napi_get_instance_data(env, reinterpret_cast<void**>(&addon));
+    EngineHandle* fork = new EngineHandle(handle->engine.fork());
+    fork->callbacks = handle->callbacks;
+    napi_value constructor = nullptr;
+    napi_value external = nullptr;
+    napi_value result = nullptr;
+    napi_get_reference_value(env, addon->engineConstructor, &constructor);
+    napi_create_external(env, fork, nullptr, nullptr, &external);
+    if (napi_new_instance(env, constructor, 1, &external, &result) != napi_ok) {
+        delete fork;
+        return nullptr;
+    }
+    return result;
+}
+
+napi_value engineSetEventCapture(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    bool enabled = false;
+    if (!handle || !fromJs(env, call.args[0], enabled)) return nullptr;
+    handle->engine.setEventCapture(enabled);
+    return undefinedValue(env);
+}
+
+napi_value engineSetEventLogCapacity(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    int capacity = 0;
+    if (!handle || !fromJs(env, call.args[0], capacity)) return nullptr;
+    handle->engine.setEventLogCapacity(capacity);
+    return undefinedValue(env);
+}
+
+napi_value engineGetState(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getState()) : nullptr;
+}
+
+napi_value engineGetStateDelta(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    int sinceTick = 0;
+    if (!handle || !fromJs(env, call.args[0], sinceTick)) return nullptr;
+    return toJs(env, handle->engine.getStateDelta(sinceTick));
+}
+
+napi_value engineGetTeamName(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    int team = 0;
+    if (!handle || !fromJs(env, call.args[0], team)) return nullptr;
+    if (team < 0 || team >= handle->engine.getTeamCount()) {
+        napi_throw_range_error(env, nullptr, "team handle out of range");
+        return nullptr;
+    }
+    return toJs(env, handle->engine.getTeamName(team));
+}
+
+napi_value engineIsFinished(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.isFinished()) : nullptr;
+}
+
+napi_value engineGetStatus(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getStatusName()) : nullptr;
+}
+
+napi_value engineGetCurrentTick(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getCurrentTick()) : nullptr;
+}
+
+napi_value engineGetWinner(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getWinner()) : nullptr;
+}
+
+napi_value engineGetAliveUnits(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getAliveUnits()) : nullptr;
+}
+
+napi_value engineGetTeamUnits(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    std::string team;
+    if (!handle || !fromJs(env, call.args[0], team)) return nullptr;
+    return toJs(env, handle->engine.getTeamUnits(team));
+}
+
+napi_value engineGetTeamAliveCount(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    std::string team;
+    if (!handle || !fromJs(env, call.args[0], team)) return nullptr;
+    return toJs(env, handle->engine.getTeamAliveCount(team));
+}
+
+napi_value engineSetPerfCounters(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    bool enabled = false;
+    if (!handle || !fromJs(env, call.args[0], enabled)) return nullptr;
+    handle->engine.setPerfCounters(enabled);
+    return undefinedValue(env);
+}
+
+napi_value engineSetPerfTrace(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    bool enabled = false;
+    if (!handle || !fromJs(env, call.args[0], enabled)) return nullptr;
+    handle->engine.setPerfTrace(enabled);
+    return undefinedValue(env);
+}
+
+napi_value engineClearPerfCounters(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    if (!handle) return nullptr;
+    handle->engine.clearPerfCounters();
+    return undefinedValue(env);
+}
+
+napi_value engineGetPerfCounters(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getPerfCounters()) : nullptr;
+}
+
+napi_value engineGetPerfTrace(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getPerfTrace()) : nullptr;
+}
+
+napi_value engineGetBattleStats(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    return handle ? toJs(env, handle->engine.getBattleStats()) : nullptr;
+}
+
+// Seeds cross as JS numbers (exact up to 2^53) rather than BigInt
+napi_value engineSetSeed(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 1);
+    double seed = 0;
+    if (!handle || !fromJs(env, call.args[0], seed)) return nullptr;
+    handle->engine.setSeed(static_cast<std::uint64_t>(seed));
+    return undefinedValue(env);
+}
+
+napi_value engineSetCallbackKey(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call, 2);
+    std::string team;
+    std::string key;
+    if (!handle || !fromJs(env, call.args[0], team) || !fromJs(env, call.args[1], key)) return nullptr;
+    handle->engine.setCallbackKey(team, key);
+    return undefinedValue(env);
+}
+
+// Hex digest, or "" when a team's callback has no key
+napi_value engineGetInputHash(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    EngineHandle* handle = engineCall(env, info, call);
+    if (!handle) return nullptr;
+    Hash128 hash;
+    return toJs(env, handle->engine.inputHash(hash) ? hash.toHex() : std::string());
+}
+
+// ---------------------------------------------------------------------------
+// BattleResultCache
+
+napi_value cacheConstruct(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    if (!getCall(env, info, call, 0)) return nullptr;
+    double maxBytes = 64 << 20;
+    if (!isNullish(env, call.args[0]) && !fromJs(env, call.args[0], maxBytes)) return nullptr;
+    CacheHandle* handle = new CacheHandle(static_cast<size_t>(std::max(0.0, maxBytes)));
+    if (napi_wrap(env, call.self, handle, finalizeCache, nullptr, nullptr) != napi_ok) {
+        delete handle;
+        throwError(env, "could not wrap BattleResultCache");
+        return nullptr;
+    }
+    napi_type_tag_object(env, call.self, &kCacheTag);
+    return call.self;
+}
+
+napi_value cacheRun(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    CacheHandle* cache = cacheCall(env, info, call, 1);
+    EngineHandle* engine = cache ? unwrapEngine(env, call.args[0]) : nullptr;
+    if (!engine) return nullptr;
+    return toJs(env, cache->cache.run(engine->engine));
+}
+
+// Promise of the BattleStats; a miss runs the battle on a worker thread
+napi_value cacheRunAsync(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    CacheHandle* cache = cacheCall(env, info, call, 1);
+    EngineHandle* engine = cache ? unwrapEngine(env, call.args[0]) : nullptr;
+    if (!engine) return nullptr;
+    AsyncRun* run = new AsyncRun();
+    run->kind = AsyncRun::CachedRun;
+    run->handle = engine;
+    run->cache = cache;
+    return queueRun(env, call.args[0], call.self, run);
+}
+
+napi_value cacheClear(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    CacheHandle* cache = cacheCall(env, info, call);
+    if (!cache) return nullptr;
+    cache->cache.clear();
+    return undefinedValue(env);
+}
+
+napi_value cacheSetMaxBytes(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    CacheHandle* cache = cacheCall(env, info, call, 1);
+    double maxBytes = 0;
+    if (!cache || !fromJs(env, call.args[0], maxBytes)) return nullptr;
+    cache->cache.setMaxBytes(static_cast<size_t>(std::max(0.0, maxBytes)));
+    return undefinedValue(env);
+}
+
+napi_value cacheMemoryBytes(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    CacheHandle* cache = cacheCall(env, info, call);
+    return cache ? toJs(env, static_cast<double>(cache->cache.memoryBytes())) : nullptr;
+}
+
+napi_value cacheSize(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    CacheHandle* cache = cacheCall(env, info, call);
+    return cache ? toJs(env, static_cast<double>(cache->cache.size())) : nullptr;
+}
+
+napi_value cacheHits(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    CacheHandle* cache = cacheCall(env, info, call);
+    return cache ? toJs(env, static_cast<double>(cache->cache.hits())) : nullptr;
+}
+
+napi_value cacheMisses(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    CacheHandle* cache = cacheCall(env, info, call);
+    return cache ? toJs(env, static_cast<double>(cache->cache.misses())) : nullptr;
+}
+
+napi_value cacheEvictions(napi_env env, napi_callback_info info) {
+    MethodCall call;
+    CacheHandle* cache = cacheCall(env, info, call);
+    return cache ? toJs(env, static_cast<double>(cache->cache.evictions())) : nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Module
+
+napi_property_descriptor method(const char* name, napi_callback callback) {
+    napi_property_descriptor descriptor = {name, nullptr, callback, nullptr, nullptr, nullptr, napi_default, nullptr};
+    return descriptor;
+}
+
+void setConstant(napi_env env, napi_value exports, const char* name, std::uint32_t value) {
+    napi_value number = nullptr;
+    napi_create_uint32(env, value, &number);
+    napi_set_named_property(env, exports, name, number);
+}
+
+napi_value init(napi_env env, napi_value exports) {
+    const napi_property_descriptor engineMethods[] = {
+        method("addUnit", engineAddUnit),
+        method("addUnitsPacked", engineAddUnitsPacked),
+        method("setTerrain", engineSetTerrain),
+        method("setTeamStrategy", engineSetTeamStrategy),
+        method("setStrategyBudget", engineSetStrategyBudget),
+        method("setTeamPolicy", engineSetTeamPolicy),
+        method("setTeamDecisionCallback", engineSetTeamDecisionCallback),
+        method("unitId", engineUnitId),
+        method("getUnitCount", engineGetUnitCount),
+        method("getTeamCount", engineGetTeamCount),
+        method("setTerrainPacked", engineSetTerrainPacked),
+        method("getTerrain", engineGetTerrain),
+        method("initialize", engineInitialize),
+        method("tick", engineTick),
+        method("run", engineRun),
+        method("runAsync", engineRunAsync),
+        method("advance", engineAdvance),
+        method("advanceAsync", engineAdvanceAsync),
+        method("reset", engineReset),
+        method("fork", engineFork),
+        method("setEventCapture", engineSetEventCapture),
+        method("setEventLogCapacity", engineSetEventLogCapacity),
+        method("getState", engineGetState),
+        method("getStateDelta", engineGetStateDelta),
+        method("getTeamName", engineGetTeamName),
+        method("isFinished", engineIsFinished),
+        method("getStatus", engineGetStatus),
+        method("getCurrentTick", engineGetCurrentTick),
+        method("getWinner", engineGetWinner),
+        method("getAliveUnits", engineGetAliveUnits),
+        method("getTeamUnits", engineGetTeamUnits),
+        method("getTeamAliveCount", engineGetTeamAliveCount),
+        method("setPerfCounters", engineSetPerfCounters),
+        method("setPerfTrace", engineSetPerfTrace),
+        method("clearPerfCounters", engineClearPerfCounters),
+        method("getPerfCounters", engineGetPerfCounters),
+        method("getPerfTrace", engineGetPerfTrace),
+        method("getBattleStats", engineGetBattleStats),
+        method("setSeed", engineSetSeed),
+        method("setCallbackKey", engineSetCallbackKey),
+        method("getInputHash", engineGetInputHash),
+    };
+    const napi_property_descriptor cacheMethods[] = {
+        method("run", cacheRun),
+        method("runAsync", cacheRunAsync),
+        method("clear", cacheClear),
+        method("setMaxBytes", cacheSetMaxBytes),
+        method("memoryBytes", cacheMemoryBytes),
+        method("size", cacheSize),
+        method("hits", cacheHits),
+        method("misses", cacheMisses),
+        method("evictions", cacheEvictions),
+    };
+
+    napi_value engineClass = nullptr;
+    napi_value cacheClass = nullptr;
+    if (napi_define_class(env, "BattleEngine", NAPI_AUTO_LENGTH, engineConstruct, nullptr,
+                          sizeof(engineMethods) / sizeof(engineMethods[0]), engineMethods,
+                          &engineClass) != napi_ok ||
+        napi_define_class(env, "BattleResultCache", NAPI_AUTO_LENGTH, cacheConstruct, nullptr,
+                          sizeof(cacheMethods) / sizeof(cacheMethods[0]), cacheMethods,
+                          &cacheClass) != napi_ok) {
+        return nullptr;
+    }
+    AddonData* addon = new AddonData();
+    napi_create_reference(env, engineClass, 1, &addon->engineConstructor);
+    napi_set_instance_data(env, addon, finalizeAddon, nullptr);
+    napi_set_named_property(env, exports, "BattleEngine", engineClass);
+    napi_set_named_property(env, exports, "BattleResultCache", cacheClass);
+
+    napi_value actionType = newObject(env);
+    setConstant(env, actionType, "IDLE", Action::IDLE);
+    setConstant(env, actionType, "MOVE", Action::MOVE);
+    setConstant(env, actionType, "ATTACK", Action::ATTACK);
+    setConstant(env, actionType, "HEAL", Action::HEAL);
+    napi_set_named_property(env, exports, "ActionType", actionType);
+
+    // Event masks for advance()
+    setConstant(env, exports, "EVENT_MOVE", eventBit(EventType::Move));
+    setConstant(env, exports, "EVENT_ATTACK", eventBit(EventType::Attack));
+    setConstant(env, exports, "EVENT_KILL", eventBit(EventType::Kill));
+    setConstant(env, exports, "EVENT_END", eventBit(EventType::End));
+    setConstant(env, exports, "EVENT_HEAL", eventBit(EventType::Heal));
+    return exports;
+}
+
+} // namespace
+
+NAPI_MODULE(battle_sim, init)
@@ -1,10 +1,113 @@
 #include <emscripten/bind.h>
 #include <emscripten/val.h>
+#include <algorithm>
 #include "BattleEngine.h"
+#include "ResultCache.h"
 
 using namespace emscripten;
 using namespace BattleSimulator;
 
+// BattleState::status is an enum internally; JS keeps seeing the string name
+static std::string getStateStatus(const BattleState& state) {
+    return statusName(state.status);
+}
+
+static void setStateStatus(BattleState& state, std::string name) {
+    state.status = parseStatus(name);
+}
+
+static std::string getDeltaStatus(const StateDelta& delta) {
+    return statusName(delta.status);
+}
+
+static void setDeltaStatus(StateDelta& delta, std::string name) {
+    delta.status = parseStatus(name);
+}
+
+static std::string getAdvanceStop(const AdvanceSummary& summary) {
+    return advanceStopName(summary.stoppedBy);
+}
+
+static void setAdvanceStop(AdvanceSummary& summary, std::string name) {
+    summary.stoppedBy = name == "finished" ? AdvanceStop::Finished
+                      : name == "event" ? AdvanceStop::Event
+                      : name == "predicate" ? AdvanceStop::Predicate
+                      : AdvanceStop::TickBudget;
+}
+
+// Bulk setup: each typed array crosses the boundary as one copy
+static bool addUnitsPacked(BattleEngine& engine, val records, val names) {
+    std::vector<std::int32_t> data = convertJSArrayToNumberVector<std::int32_t>(records);
+    std::vector<std::string> strings = vecFromJSArray<std::string>(names);
+    return engine.addUnitsPacked(data.data(), static_cast<int>(data.size() / kPackedUnitWords), strings);
+}
+
+static bool setTerrainPacked(BattleEngine& engine, val cells, int width, int height, val palette) {
+    std::vector<std::uint8_t> data = convertJSArrayToNumberVector<std::uint8_t>(cells);
+    if (static_cast<int>(data.size()) < width * height) return false;
+    return engine.setTerrainPacked(data.data(), width, height, vecFromJSArray<TerrainCell>(palette));
+}
+
+// Returns "" on success, otherwise the compile error
+static std::string setTeamStrategy(BattleEngine& engine, std::string team, std::string source) {
+    std::string error;
+    return engine.setTeamStrategy(team, source, &error) ? std::string() : error;
+}
+
+// Policies are selected by name from JS; returns false for an unknown name
+static bool setTeamPolicy(BattleEngine& engine, std::string team, std::string name,
+                          PolicyParams params) {
+    return engine.setTeamPolicy(team, name, params);
+}
+
+// JS batched AI: `callback(batch)` gets typed-array views of the gathered
+// columns (valid only during the call) and returns an array of Actions, one
+// per ready unit in order
+static void setTeamDecisionCallback(BattleEngine& engine, std::string team, val callback) {
+    if (callback.isNull() || callback.isUndefined()) {
+        engine.setTeamDecisionCallback(team, TeamDecisionCallback());
+        return;
+    }
+    engine.setTeamDecisionCallback(team, [callback](const TeamBatch& batch, Action* actions) {
+        val view = val::object();
+        view.set("tick", batch.tick);
+        view.set("count", batch.count);
+        view.set("slots", val(typed_memory_view(batch.count, batch.slots)));
+        view.set("x", val(typed_memory_view(batch.count, batch.x)));
+        view.set("y", val(typed_memory_view(batch.count, batch.y)));
+        view.set("health", val(typed_memory_view(batch.count, batch.health)));
+        view.set("attack", val(typed_memory_view(batch.count, batch.attack)));
+        view.set("range", val(typed_memory_view(batch.count, batch.range)));
+        view.set("speed", val(typed_memory_view(batch.count, batch.speed)));
+        val result = callback(view);
+        if (!result.isArray()) return;
+        const int count = std::min(batch.count, result["length"].as<int>());
+        for (int i = 0; i < count; i++) {
+            actions[i] = result[i].as<Action>();
+        }
+    });
+}
+
+// Seeds and counters cross as JS numbers (exact up to 2^53) rather than BigInt
+static void setSeed(BattleEngine& engine, double seed) {
+    engine.setSeed(static_cast<std::uint64_t>(seed));
+}
+
+// Hex digest, or "" when a team's callback has no key
+static std::string getInputHash(const BattleEngine& engine) {
+    Hash128 hash;
+    return engine.inputHash(hash) ? hash.toHex() : std::string();
+}
+
+static double cacheHits(const BattleResultCache& cache) { return static_cast<double>(cache.hits()); }
+static double cacheMisses(const BattleResultCache& cache) { return static_cast<double>(cache.misses()); }
+static double cacheEvictions(const BattleResultCache& cache) { return static_cast<double>(cache.evictions()); }
+
+// Terrain is palette-indexed internally; JS sees rows of { type, moveCost }
+static std::vector<std::vector<TerrainCell>> getTerrain(const BattleEngine& engine) {
+    return engine.getState().terrain->toRows();
+}
+
 // WASM bindings for JavaScript
 EMSCRIPTEN_BINDINGS(battle_simulator) {
     // Position
@@ -42,16 +145,61 @@ EMSCRIPTEN_BINDINGS(battle_simulator) {
     enum_<Action::Type>("ActionType")
         .value("IDLE", Action::IDLE)
         .value("MOVE", Action::MOVE)
-        .value("ATTACK", Action::ATTACK);
+        .value("ATTACK", Action::ATTACK)
+        .value("HEAL", Action::HEAL);
+    
+    // PolicyParams
+    value_object<PolicyParams>("PolicyParams")
+        .field("retreatHealth", &PolicyParams::retreatHealth)
+        .field("engageRange", &PolicyParams::engageRange)
+        .field("leash", &PolicyParams::leash)
+        .field("flankOffset", &PolicyParams::flankOffset);
     
     // BattleState
     value_object<BattleState>("BattleState")
         .field("tick", &BattleState::tick)
         .field("units", &BattleState::units)
-        .field("status", &BattleState::status)
+        .field("status", &getStateStatus, &setStateStatus)
         .field("winner", &BattleState::winner)
         .field("logs", &BattleState::logs);
     
+    // UnitDelta
+    value_object<UnitDelta>("UnitDelta")
+        .field("index", &UnitDelta::index)
+        .field("position", &UnitDelta::position)
+        .field("health", &UnitDelta::health)
+        .field("alive", &UnitDelta::alive)
+        .field("cooldown", &UnitDelta::cooldown);
+    
+    // StateDelta
+    value_object<StateDelta>("StateDelta")
+        .field("sinceTick", &StateDelta::sinceTick)
+        .field("tick", &StateDelta::tick)
+        .field("full", &StateDelta::full)
+        .field("status", &getDeltaStatus, &setDeltaStatus)
+        .field("winner", &StateDelta::winner)
+        .field("units", &StateDelta::units)
+        .field("snapshot", &StateDelta::snapshot)
+        .field("logs", &StateDelta::logs);
+    
+    // AdvanceSummary
+    value_object<AdvanceSummary>("AdvanceSummary")
+        .field("startTick", &AdvanceSummary::startTick)
+        .field("endTick", &AdvanceSummary::endTick)
+        .field("ticks", &AdvanceSummary::ticks)
+        .field("stoppedBy", &getAdvanceStop, &setAdvanceStop)
+        .field("moves", &AdvanceSummary::moves)
+        .field("attacks", &AdvanceSummary::attacks)
+        .field("damage", &AdvanceSummary::damage)
+        .field("kills", &AdvanceSummary::kills);
+    
+    // Event masks for advance()
+    constant("EVENT_MOVE", eventBit(EventType::Move));
+    constant("EVENT_ATTACK", eventBit(EventType::Attack));
+    constant("EVENT_KILL", eventBit(EventType::Kill));
+    constant("EVENT_END", eventBit(EventType::End));
+    constant("EVENT_HEAL", eventBit(EventType::Heal));
+    
     // BattleStats
     value_object<BattleEngine::BattleStats>("BattleStats")
         .field("totalTicks", &BattleEngine::BattleStats::totalTicks)
@@ -61,25 +209,81 @@ EMSCRIPTEN_BINDINGS(battle_simulator) {
         .field("totalDamageDealt", &BattleEngine::BattleStats::totalDamageDealt)
         .field("logs", &BattleEngine::BattleStats::logs);
     
+    // PerfCounters
+    value_object<PerfCounters>("PerfCounters")
+        .field("ticks", &PerfCounters::ticks)
+        .field("indexMs", &PerfCounters::indexMs)
+        .field("winCheckMs", &PerfCounters::winCheckMs)
+        .field("decideMs", &PerfCounters::decideMs)
+        .field("moveMs", &PerfCounters::moveMs)
+        .field("attackMs", &PerfCounters::attackMs)
+        .field("cooldownsMs", &PerfCounters::cooldownsMs)
+        .field("loggingMs", &PerfCounters::loggingMs)
+        .field("unitsScanned", &PerfCounters::unitsScanned)
+        .field("collisionChecks", &PerfCounters::collisionChecks)
+        .field("callbackInvocations", &PerfCounters::callbackInvocations)
+        .field("decisions", &PerfCounters::decisions)
+        .field("allocations", &PerfCounters::allocations);
+    
     // BattleEngine
     class_<BattleEngine>("BattleEngine")
         .constructor<int, int, int>()
         .function("addUnit", &BattleEngine::addUnit)
+        .function("addUnitsPacked", &addUnitsPacked)
+        .function("setTerrain", &BattleEngine::setTerrain)
+        .function("setTeamStrategy", &setTeamStrategy)
+        .function("setStrategyBudget", &BattleEngine::setStrategyBudget)
+        .function("setTeamPolicy", &setTeamPolicy)
+        .function("setTeamDecisionCallback", &setTeamDecisionCallback)
+        .function("unitId", &BattleEngine::unitId)
+        .function("getUnitCount", &BattleEngine::getUnitCount)
+        .function("getTeamCount", &BattleEngine::getTeamCount)
+        .function("setTerrainPacked", &setTerrainPacked)
+        .function("getTerrain", &getTerrain)
         .function("initialize", &BattleEngine::initialize)
         .function("tick", &BattleEngine::tick)
         .function("run", &BattleEngine::run)
+        .function("advance", &BattleEngine::advance)
         .function("reset", &BattleEngine::reset)
+        .function("fork", &BattleEngine::fork)
+        .function("setEventCapture", &BattleEngine::setEventCapture)
+        .function("setEventLogCapacity", &BattleEngine::setEventLogCapacity)
         .function("getState", &BattleEngine::getState)
+        .function("getStateDelta", &BattleEngine::getStateDelta)
+        .function("getStateBuffer", &BattleEngine::getStateBuffer)
+        .function("getTeamName", &BattleEngine::getTeamName)
         .function("isFinished", &BattleEngine::isFinished)
+        .function("getStatus", &BattleEngine::getStatusName)
         .function("getCurrentTick", &BattleEngine::getCurrentTick)
         .function("getWinner", &BattleEngine::getWinner)
         .function("getAliveUnits", &BattleEngine::getAliveUnits)
         .function("getTeamUnits", &BattleEngine::getTeamUnits)
         .function("getTeamAliveCount", &BattleEngine::getTeamAliveCount)
-        .function("getBattleStats", &BattleEngine::getBattleStats);
+        .function("setPerfCounters", &BattleEngine::setPerfCounters)
+        .function("setPerfTrace", &BattleEngine::setPerfTrace)
+        .function("clearPerfCounters", &BattleEngine::clearPerfCounters)
+        .function("getPerfCounters", &BattleEngine::getPerfCounters)
+        .function("getPerfTrace", &BattleEngine::getPerfTrace)
+        .function("getBattleStats", &BattleEngine::getBattleStats)
+        .function("setSeed", &setSeed)
+        .function("setCallbackKey", &BattleEngine::setCallbackKey)
+        .function("getInputHash", &getInputHash);
+    
+    // Result cache; run() returns cached BattleStats for identical inputs
+    class_<BattleResultCache>("BattleResultCache")
+        .constructor<size_t>()
+        .function("run", &BattleResultCache::run)
+        .function("clear", &BattleResultCache::clear)
+        .function("setMaxBytes", &BattleResultCache::setMaxBytes)
+        .function("memoryBytes", &BattleResultCache::memoryBytes)
+        .function("size", &BattleResultCache::size)
+        .function("hits", &cacheHits)
+        .function("misses", &cacheMisses)
+        .function("evictions", &cacheEvictions);
     
     // Vector bindings
     register_vector<Unit>("UnitVector");
+    register_vector<UnitDelta>("UnitDeltaVector");
     register_vector<TerrainCell>("TerrainCellVector");
     register_vector<std::vector<TerrainCell>>("TerrainGrid");
     register_vector<std::string>("StringVector");
@@ -0,0 +1,158 @@
+#include <iostream>
+#include <cassert>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include "../include/BattleBatchRunner.h"
+
+using namespace BattleSimulator;
+
+// Close in on the nearest enemy and attack it, hesitating at random. The RNG
+// is seeded per battle and team, so runs are reproducible on any thread count.
+static AIDecisionCallback makeSkirmishPolicy(std::uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    return [rng](const Unit& self, const BattleState& state) mutable {
+        Action action;
+        if (rng() % 4 == 0) {
+            return action;
+        }
+        
+        const Unit* nearest = nullptr;
+        double best = 1e9;
+        for (const auto& other : state.units) {
+            if (other.isAlive() && other.team != self.team) {
+                double d = self.position.distanceTo(other.position);
+                if (d < best) {
+                    best = d;
+                    nearest = &other;
+                }
+            }
+        }
+        if (!nearest) return action;
+        
+        if (best <= self.range) {
+            action.type = Action::ATTACK;
+            action.targetUnitId = nearest->id;
+        } else {
+            // Step along the longer axis towards the target
+            int dx = nearest->position.x - self.position.x;
+            int dy = nearest->position.y - self.position.y;
+            action.type = Action::MOVE;
+            if (std::abs(dx) >= std::abs(dy)) {
+                action.direction = dx > 0 ? "right" : "left";
+            } else {
+                action.direction = dy > 0 ? "down" : "up";
+            }
+        }
+        return action;
+    };
+}
+
+static std::vector<BattleConfig> makeConfigs(int count, int unitsPerTeam) {
+    std::vector<BattleConfig> configs;
+    for (int b = 0; b < count; b++) {
+        BattleConfig config;
+        config.width = 30;
+        config.height = 20;
+        config.maxTicks = 300;
+        config.seed = 1000 + b;
+        
+        std::mt19937 rng(b);
+        std::uniform_int_distribution<int> xDist(0, 8);
+        std::uniform_int_distribution<int> yDist(0, 19);
+        std::uniform_int_distribution<int> statDist(0, 10);
+        for (int i = 0; i < unitsPerTeam * 2; i++) {
+            bool teamA = (i % 2) == 0;
+            Unit unit("u" + std::to_string(i), teamA ? "teamA" : "teamB", "soldier");
+            int x = xDist(rng);
+            unit.position = Position(teamA ? x : 29 - x, yDist(rng));
+            unit.attack = 15 + statDist(rng);
+            unit.range = 1 + statDist(rng) % 3;
+            config.units.push_back(unit);
+        }
+        config.policies["teamA"] = makeSkirmishPolicy;
+        config.policies["teamB"] = makeSkirmishPolicy;
+        configs.push_back(config);
+    }
+    return configs;
+}
+
+void testBatchMatchesSequential() {
+    std::vector<BattleConfig> configs = makeConfigs(64, 10);
+    
+    BattleBatchRunner sequential(1);
+    BattleBatchRunner parallel(4);
+    BatchResult a = sequential.run(configs);
+    BatchResult b = parallel.run(configs);
+    
+    assert(a.battles.size() == configs.size());
+    for (size_t i = 0; i < configs.size(); i++) {
+        BattleEngine::BattleStats single = BattleBatchRunner::runOne(configs[i], false);
+        assert(a.battles[i].winner == single.winner);
+        assert(a.battles[i].totalTicks == single.totalTicks);
+        assert(b.battles[i].winner == single.winner);
+        assert(b.battles[i].totalTicks == single.totalTicks);
+        assert(b.battles[i].teamAUnitsRemaining == single.teamAUnitsRemaining);
+        assert(b.battles[i].teamBUnitsRemaining == single.teamBUnitsRemaining);
+    }
+    
+    const BatchSummary& s = b.summary;
+    assert(s.battles == 64);
+    assert(s.teamAWins + s.teamBWins + s.draws == 64);
+    assert(std::abs(s.teamAWinRate + s.teamBWinRate + s.drawRate - 1.0) < 1e-9);
+    assert(s.teamAWins > 0 && s.teamBWins > 0);
+    std::cout << "✓ Batch results match sequential runs test passed\n";
+    std::cout << "  teamA " << s.teamAWinRate << ", teamB " << s.teamBWinRate
+              << ", draw " << s.drawRate << ", avg ticks " << s.averageTicks << "\n";
+}
+
+void testThreadPoolStealsAndPropagatesErrors() {
+    ThreadPool pool(3);
+    std::vector<int> hits(1000, 0);
+    pool.parallelFor(1000, 7, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) hits[i]++;
+        // Nested calls run inline instead of deadlocking
+        pool.parallelFor(2, 1, [](int, int) {});
+    });
+    for (int h : hits) assert(h == 1);
+    
+    bool caught = false;
+    try {
+        pool.parallelFor(10, 1, [](int begin, int) {
+            if (begin == 5) throw std::runtime_error("boom");
+        });
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    assert(caught);
+    std::cout << "✓ Thread pool test passed\n";
+}
+
+void reportThroughput() {
+    std::vector<BattleConfig> configs = makeConfigs(256, 25);
+    int hardware = ThreadPool::hardwareThreads();
+    
+    for (int threads = 1; threads <= hardware; threads *= 2) {
+        BattleBatchRunner runner(threads);
+        BatchResult result = runner.run(configs);
+        std::cout << "  " << threads << " thread(s): "
+                  << static_cast<int>(configs.size() / result.elapsedSeconds) << " battles/s\n";
+    }
+}
+
+int main() {
+    std::cout << "Running Battle Batch Runner Tests...\n\n";
+    
+    try {
+        testThreadPoolStealsAndPropagatesErrors();
+        testBatchMatchesSequential();
+        reportThroughput();
+        
+        std::cout << "\n✅ All tests passed!\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\n❌ Test failed: " << e.what() << "\n";
+        return 1;
+    }
+}
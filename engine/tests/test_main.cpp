@@ -1,6 +1,17 @@
 #include <iostream>
 #include <cassert>
+#include <random>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <cstdio>
 #include "../include/BattleEngine.h"
+#include "../include/Replay.h"
+#include "../include/MctsController.h"
+#include "../include/TerrainFile.h"
+#include "../include/ResultCache.h"
 
 using namespace BattleSimulator;
 
@@ -100,7 +111,12 @@ void testMovement() {
     unit1.position = Position(0, 0);
     unit1.speed = 2;
     
+    // Distant opponent so the win check doesn't end the battle on tick 1
+    Unit unit2("unit2", "teamB", "soldier");
+    unit2.position = Position(19, 19);
+    
     engine.addUnit(unit1);
+    engine.addUnit(unit2);
     engine.initialize();
     
     // Set AI to move right
@@ -141,6 +157,1540 @@ void testTeamCounting() {
     std::cout << "✓ Team counting test passed\n";
 }
 
+// Runs the same skirmish with and without the spatial index
+static BattleEngine runSkirmish(bool useGrid, unsigned seed,
+                                TickMode mode = TickMode::Sequential, int threads = 1) {
+    BattleEngine engine(40, 30, 200);
+    engine.setSpatialIndexEnabled(useGrid);
+    engine.setTickMode(mode);
+    engine.setDecisionThreads(threads);
+    
+    std::mt19937 rng(seed);
+    // More units than the dense-scan cutoff so the grid path is exercised
+    std::uniform_int_distribution<int> xDist(0, 15);
+    std::uniform_int_distribution<int> yDist(0, 29);
+    for (int i = 0; i < 100; i++) {
+        bool teamA = (i % 2) == 0;
+        Unit unit("u" + std::to_string(i), teamA ? "teamA" : "teamB", "soldier");
+        int x = xDist(rng);
+        unit.position = Position(teamA ? x : 39 - x, yDist(rng));
+        unit.range = 1 + (i % 4);
+        unit.attack = 15 + (i % 7);
+        engine.addUnit(unit);
+    }
+    
+    auto policy = [](const Unit& self, const BattleState& state) {
+        Action action;
+        if ((self.position.y + state.tick) % 3 == 0) {
+            action.type = Action::MOVE;
+            action.direction = "forward";
+        } else {
+            action.type = Action::ATTACK;
+        }
+        return action;
+    };
+    engine.setAICallback("teamA", policy);
+    engine.setAICallback("teamB", policy);
+    
+    engine.run();
+    return engine;
+}
+
+void testSpatialIndexMatchesLinearScan() {
+    for (unsigned seed = 1; seed <= 5; seed++) {
+        BattleEngine grid = runSkirmish(true, seed);
+        BattleEngine scan = runSkirmish(false, seed);
+        
+        assert(grid.getCurrentTick() == scan.getCurrentTick());
+        assert(grid.getWinner() == scan.getWinner());
+        
+        const auto& a = grid.getState().units;
+        const auto& b = scan.getState().units;
+        assert(a.size() == b.size());
+        for (size_t i = 0; i < a.size(); i++) {
+            assert(a[i].position == b[i].position);
+            assert(a[i].health == b[i].health);
+            assert(a[i].alive == b[i].alive);
+        }
+    }
+    std::cout << "✓ Spatial index matches linear scan test passed\n";
+}
+
+void testSpatialGridQueries() {
+    SpatialGrid grid;
+    grid.reset(50, 50, 4);
+    grid.insert(0, 0, 10, 10);
+    grid.insert(1, 1, 13, 14);   // distance 5 from (10, 10)
+    grid.insert(2, 1, 7, 6);     // distance 5, higher slot
+    grid.insert(3, 1, 40, 40);
+    
+    auto any = [](int) { return true; };
+    auto nearestIn = [&](int layer) {
+        int best = -1;
+        std::int64_t bestDist = std::numeric_limits<std::int64_t>::max();
+        grid.nearest(10, 10, layer, any, best, bestDist);
+        return best;
+    };
+    
+    assert(nearestIn(1) == 1);
+    assert(nearestIn(0) == 0);
+    
+    int inRange = 0;
+    grid.forEachInRadius(10, 10, 5, 1, [&](int) { inRange++; });
+    assert(inRange == 2);
+    
+    grid.move(1, 40, 41);
+    assert(nearestIn(1) == 2);
+    
+    grid.remove(2);
+    assert(nearestIn(1) == 3);
+    assert(grid.size() == 3);
+    
+    int hits = 0;
+    grid.forEachAt(40, 41, [&](int i) { hits += (i == 1); });
+    assert(hits == 1);
+    std::cout << "✓ Spatial grid query test passed\n";
+}
+
+void testUnitViewTracksStore() {
+    BattleEngine engine(10, 10, 50);
+    
+    Unit attacker("a", "teamA", "soldier");
+    attacker.position = Position(2, 2);
+    attacker.attack = 30;
+    attacker.range = 2;
+    
+    Unit defender("b", "teamB", "soldier");
+    defender.position = Position(3, 3);
+    defender.defense = 0;
+    
+    engine.addUnit(attacker);
+    engine.addUnit(defender);
+    engine.setAICallback("teamA", [](const Unit& self, const BattleState& state) {
+        // The view handed to callbacks must already reflect earlier ticks
+        assert(state.units[0].cooldown == self.cooldown);
+        Action action;
+        action.type = Action::ATTACK;
+        return action;
+    });
+    engine.initialize();
+    
+    engine.tick();
+    const BattleState& state = engine.getState();
+    assert(state.units[1].health == 70);
+    assert(state.units[0].cooldown == 2);
+    
+    std::vector<Unit> teamB = engine.getTeamUnits("teamB");
+    assert(teamB.size() == 1 && teamB[0].health == 70 && teamB[0].id == "b");
+    
+    engine.run();
+    assert(engine.getWinner() == "teamA");
+    assert(!engine.getState().units[1].alive);
+    assert(engine.getAliveUnits().size() == 1);
+    std::cout << "✓ Unit view tracks store test passed\n";
+}
+
+void testInternedLookups() {
+    BattleEngine engine(20, 20, 50);
+    assert(engine.getStatus() == BattleStatus::Idle);
+    assert(engine.getStatusName() == "idle");
+    
+    Unit hunter("hunter", "teamA", "archer");
+    hunter.position = Position(5, 5);
+    hunter.range = 10;
+    hunter.attack = 200;
+    engine.addUnit(hunter);
+    
+    // Two units share an id; targeting resolves to the first alive one
+    Unit first("dup", "teamB", "soldier");
+    first.position = Position(6, 5);
+    Unit second("dup", "teamB", "soldier");
+    second.position = Position(9, 9);
+    engine.addUnit(first);
+    engine.addUnit(second);
+    
+    engine.setAICallback("teamA", [](const Unit& self, const BattleState& state) {
+        Action action;
+        action.type = Action::ATTACK;
+        action.targetUnitId = "dup";
+        return action;
+    });
+    
+    engine.initialize();
+    assert(engine.getStatusName() == "initialized");
+    engine.tick();
+    assert(!engine.getState().units[1].alive);
+    assert(engine.getState().units[2].alive);
+    assert(engine.getTeamAliveCount("teamB") == 1);
+    assert(engine.getTeamAliveCount("nobody") == 0);
+    assert(engine.getTeamUnits("teamA")[0].type == "archer");
+    
+    engine.run();
+    assert(engine.getStatus() == BattleStatus::Finished);
+    assert(engine.getWinner() == "teamA");
+    assert(parseStatus(statusName(BattleStatus::Running)) == BattleStatus::Running);
+    std::cout << "✓ Interned lookup test passed\n";
+}
+
+void testSimdKernelsMatchScalar() {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> coord(0, 63);
+    
+    for (int count : {0, 3, 8, 13, 64, 257}) {
+        std::vector<int> xs(count), ys(count), teams(count);
+        std::vector<std::uint8_t> alive(count);
+        for (int i = 0; i < count; i++) {
+            xs[i] = coord(rng);
+            ys[i] = coord(rng);
+            teams[i] = i % 3;
+            alive[i] = (i % 5) != 0;
+        }
+        UnitColumns columns{xs.data(), ys.data(), teams.data(), alive.data(), count};
+        
+        for (int q = 0; q < 50; q++) {
+            int x = coord(rng), y = coord(rng), team = q % 3, range = q % 9;
+            
+            setSimdLevel(SimdLevel::Scalar);
+            int expected = nearestEnemy(columns, x, y, team);
+            std::vector<int> expectedRange;
+            enemiesInRange(columns, x, y, team, range, expectedRange);
+            
+            setSimdLevel(detectSimdLevel());
+            std::vector<int> actualRange;
+            enemiesInRange(columns, x, y, team, range, actualRange);
+            assert(nearestEnemy(columns, x, y, team) == expected);
+            assert(actualRange == expectedRange);
+        }
+    }
+    std::cout << "✓ SIMD kernels (" << simdLevelName(getSimdLevel())
+              << ") match scalar test passed\n";
+}
+
+void testTwoPhaseConflictPolicy() {
+    BattleEngine engine(20, 20);
+    engine.setTickMode(TickMode::TwoPhase);
+    
+    Unit left("left", "teamA", "soldier");
+    left.position = Position(4, 5);
+    Unit right("right", "teamA", "soldier");
+    right.position = Position(6, 5);
+    Unit enemy("enemy", "teamB", "soldier");
+    enemy.position = Position(19, 19);
+    engine.addUnit(left);
+    engine.addUnit(right);
+    engine.addUnit(enemy);
+    
+    // Both units claim (5, 5); the lower slot wins the cell
+    engine.setAICallback("teamA", [](const Unit& self, const BattleState& state) {
+        Action action;
+        action.type = Action::MOVE;
+        action.direction = self.id == "left" ? "right" : "left";
+        return action;
+    });
+    
+    engine.initialize();
+    engine.tick();
+    assert(engine.getState().units[0].position == Position(5, 5));
+    assert(engine.getState().units[1].position == Position(6, 5));
+    std::cout << "✓ Two-phase conflict policy test passed\n";
+}
+
+void testTwoPhaseSimultaneousAttacks() {
+    for (TickMode mode : {TickMode::Sequential, TickMode::TwoPhase}) {
+        BattleEngine engine(20, 20);
+        engine.setTickMode(mode);
+        
+        Unit a("a", "teamA", "soldier");
+        a.position = Position(5, 5);
+        a.health = 10;
+        a.attack = 30;
+        Unit b("b", "teamB", "soldier");
+        b.position = Position(6, 5);
+        b.health = 10;
+        b.attack = 30;
+        engine.addUnit(a);
+        engine.addUnit(b);
+        
+        auto attack = [](const Unit& self, const BattleState& state) {
+            Action action;
+            action.type = Action::ATTACK;
+            return action;
+        };
+        engine.setAICallback("teamA", attack);
+        engine.setAICallback("teamB", attack);
+        engine.run();
+        
+        // Sequentially the first attacker wins; in two-phase mode both fire
+        assert(engine.getWinner() == (mode == TickMode::Sequential ? "teamA" : "draw"));
+    }
+    std::cout << "✓ Two-phase simultaneous attack test passed\n";
+}
+
+void testTwoPhaseThreadCountInvariant() {
+    for (unsigned seed = 1; seed <= 3; seed++) {
+        BattleEngine single = runSkirmish(true, seed, TickMode::TwoPhase, 1);
+        BattleEngine multi = runSkirmish(true, seed, TickMode::TwoPhase, 4);
+        
+        assert(single.getCurrentTick() == multi.getCurrentTick());
+        assert(single.getWinner() == multi.getWinner());
+        const auto& a = single.getState().units;
+        const auto& b = multi.getState().units;
+        for (size_t i = 0; i < a.size(); i++) {
+            assert(a[i].position == b[i].position);
+            assert(a[i].health == b[i].health);
+        }
+    }
+    std::cout << "✓ Two-phase thread-count invariance test passed\n";
+}
+
+void testEventLog() {
+    // Ring buffer keeps the newest events and never grows
+    EventLog ring(3);
+    for (int i = 0; i < 5; i++) {
+        BattleEvent event = BattleEvent();
+        event.tick = i;
+        event.type = EventType::Attack;
+        ring.record(event);
+    }
+    assert(ring.size() == 3);
+    assert(ring.totalRecorded() == 5);
+    assert(ring.at(0).tick == 2 && ring.at(2).tick == 4);
+    ring.setCapacity(2);
+    assert(ring.size() == 2 && ring.at(0).tick == 3);
+    
+    auto duel = [](BattleEngine& engine) {
+        Unit a("a", "teamA", "soldier");
+        a.position = Position(5, 5);
+        a.health = 20;
+        a.attack = 30;
+        Unit b("b", "teamB", "soldier");
+        b.position = Position(6, 5);
+        engine.addUnit(a);
+        engine.addUnit(b);
+        engine.setAICallback("teamA", [](const Unit& self, const BattleState& state) {
+            Action action;
+            action.type = Action::ATTACK;
+            return action;
+        });
+        engine.run();
+    };
+    
+    // Strings are formatted from typed events on request
+    BattleEngine engine(20, 20);
+    duel(engine);
+    const auto& logs = engine.getState().logs;
+    assert(logs.front() == "[Tick 0] Battle initialized");
+    assert(logs[1] == "[Tick 1] teamA unit attacked teamB unit for 28 damage");
+    assert(logs[logs.size() - 2] == "[Tick 10] teamB unit eliminated!");
+    assert(logs.back() == "[Tick 11] Team A wins!");
+    assert(engine.getBattleStats().logs == logs);
+    assert(engine.getBattleStats().totalDamageDealt == 112);
+    
+    // Capture off: nothing is recorded, stats still add up
+    BattleEngine quiet(20, 20);
+    quiet.setEventCapture(false);
+    duel(quiet);
+    assert(quiet.getEvents().size() == 0);
+    assert(quiet.getState().logs.empty());
+    assert(quiet.getBattleStats().totalDamageDealt == 112);
+    assert(quiet.getWinner() == "teamA");
+    std::cout << "✓ Event log test passed\n";
+}
+
+void testStateDelta() {
+    BattleEngine engine(20, 20);
+    
+    Unit mover("mover", "teamA", "soldier");
+    mover.position = Position(2, 2);
+    Unit idle("idle", "teamA", "soldier");
+    idle.position = Position(0, 10);
+    Unit enemy("enemy", "teamB", "soldier");
+    enemy.position = Position(19, 19);
+    engine.addUnit(mover);
+    engine.addUnit(idle);
+    engine.addUnit(enemy);
+    
+    engine.setAICallback("teamA", [](const Unit& self, const BattleState& state) {
+        Action action;
+        // The idle unit keeps walking into the map edge
+        action.type = Action::MOVE;
+        action.direction = self.id == "mover" ? "right" : "left";
+        return action;
+    });
+    
+    engine.initialize();
+    engine.tick();
+    engine.tick();
+    
+    // Only the unit that moved is reported
+    StateDelta delta = engine.getStateDelta(1);
+    assert(!delta.full);
+    assert(delta.tick == 2);
+    assert(delta.units.size() == 1);
+    assert(delta.units[0].index == 0);
+    assert(delta.units[0].position == Position(4, 2));
+    assert(engine.getStateDelta(2).units.empty());
+    
+    assert(engine.getStateDelta(0).units.size() == 1);
+    
+    // Ticks in the future or before units were added need a full snapshot
+    assert(engine.getStateDelta(5).full);
+    engine.addUnit(Unit("late", "teamB", "soldier"));
+    delta = engine.getStateDelta(1);
+    assert(delta.full);
+    assert(delta.snapshot.size() == 4);
+    assert(delta.snapshot[0].position == Position(4, 2));
+    // ...including a client synced at the tick the unit was added
+    assert(engine.getStateDelta(2).full);
+    assert(engine.getStateDelta(2).snapshot.size() == 4);
+    
+    // An overwritten event history also forces a snapshot
+    engine.setEventLogCapacity(1);
+    engine.setEventMask(~0u);
+    engine.tick();
+    engine.tick();
+    assert(!engine.getStateDelta(4).full);
+    assert(engine.getStateDelta(3).full);
+    std::cout << "✓ State delta test passed\n";
+}
+
+void testStateBuffer() {
+    using namespace StateBufferLayout;
+    BattleEngine engine(20, 20);
+    
+    Unit a("a", "teamA", "soldier");
+    a.position = Position(5, 5);
+    a.attack = 30;
+    Unit b("b", "teamB", "soldier");
+    b.position = Position(6, 5);
+    engine.addUnit(a);
+    engine.addUnit(b);
+    engine.setAICallback("teamA", [](const Unit& self, const BattleState& state) {
+        Action action;
+        action.type = Action::ATTACK;
+        return action;
+    });
+    
+    const std::intptr_t* header = reinterpret_cast<const std::intptr_t*>(engine.getStateBuffer());
+    assert(header[Magic] == kMagic && header[Version] == kVersion);
+    const std::intptr_t generation = header[Generation];
+    
+    engine.initialize();
+    engine.tick();
+    
+    // Same header address, refreshed in place; columns alias engine storage
+    assert(reinterpret_cast<const std::intptr_t*>(engine.getStateBuffer()) == header);
+    assert(header[Generation] == generation);
+    assert(header[Tick] == 1 && header[UnitCount] == 2);
+    const int* x = reinterpret_cast<const int*>(header[PosXColumn]);
+    const int* health = reinterpret_cast<const int*>(header[HealthColumn]);
+    const int* team = reinterpret_cast<const int*>(header[TeamColumn]);
+    const std::uint8_t* alive = reinterpret_cast<const std::uint8_t*>(header[AliveColumn]);
+    const BattleState& state = engine.getState();
+    for (int i = 0; i < 2; i++) {
+        assert(x[i] == state.units[i].position.x);
+        assert(health[i] == state.units[i].health);
+        assert(engine.getTeamName(team[i]) == state.units[i].team);
+        assert((alive[i] != 0) == state.units[i].isAlive());
+    }
+    assert(health[1] == 72);
+    
+    // Adding units may move the columns
+    engine.addUnit(Unit("c", "teamB", "soldier"));
+    engine.getStateBuffer();
+    assert(header[Generation] != generation && header[UnitCount] == 3);
+    std::cout << "✓ State buffer test passed\n";
+}
+
+void testPackedSetup() {
+    using namespace PackedUnitLayout;
+    BattleEngine engine(4, 3);
+    
+    const std::vector<std::string> names = {"teamA", "teamB", "archer", "u1", "u2"};
+    std::vector<std::int32_t> records = {
+        3, 0, 2, 1, 1, 80, 0, 12, 4, 2, 3,
+        4, 1, 2, 2, 2, 60, 90, 8, 6, 1, 1,
+    };
+    assert(engine.addUnitsPacked(records.data(), 2, names));
+    
+    const BattleState& state = engine.getState();
+    assert(state.units.size() == 2);
+    assert(state.units[0].id == "u1" && state.units[0].team == "teamA");
+    assert(state.units[0].type == "archer" && state.units[0].maxHealth == 80);
+    assert(state.units[1].position == Position(2, 2) && state.units[1].maxHealth == 90);
+    assert(engine.getTeamAliveCount("teamB") == 1);
+    
+    // A bad name index rejects the whole batch
+    records[Words + Team] = 7;
+    assert(!engine.addUnitsPacked(records.data(), 2, names));
+    assert(engine.getState().units.size() == 2);
+    
+    const std::vector<TerrainCell> palette = {TerrainCell("ground", 1.0), TerrainCell("water", 3.0)};
+    const std::vector<std::uint8_t> cells = {0, 0, 1, 0,
+                                             0, 1, 1, 0,
+                                             0, 0, 0, 0};
+    assert(engine.setTerrainPacked(cells.data(), 4, 3, palette));
+    assert(engine.getState().terrain[1][2].type == "water");
+    assert(engine.getState().terrain[1][2].moveCost == 3.0);
+    assert(engine.getState().terrain[2][3].type == "ground");
+    
+    const std::vector<std::uint8_t> bad = {0, 2, 0, 0};
+    assert(!engine.setTerrainPacked(bad.data(), 2, 2, palette));
+    assert(engine.getState().terrain.size() == 3);
+    std::cout << "✓ Packed setup test passed\n";
+}
+
+void testAdvance() {
+    auto setup = [](BattleEngine& engine) {
+        Unit a("a", "teamA", "soldier");
+        a.position = Position(2, 5);
+        a.attack = 60;
+        Unit b1("b1", "teamB", "soldier");
+        b1.position = Position(6, 5);
+        Unit b2("b2", "teamB", "soldier");
+        b2.position = Position(6, 6);
+        engine.addUnit(a);
+        engine.addUnit(b1);
+        engine.addUnit(b2);
+        engine.setAICallback("teamA", [](const Unit& self, const BattleState& state) {
+            // Attack anything in range, otherwise close in
+            Action action;
+            action.type = Action::MOVE;
+            action.direction = "right";
+            for (const auto& unit : state.units) {
+                if (unit.team != self.team && unit.isAlive() &&
+                    self.position.distanceTo(unit.position) <= self.range) {
+                    action.type = Action::ATTACK;
+                }
+            }
+            return action;
+        });
+    };
+    
+    // Tick budget
+    BattleEngine engine(20, 20);
+    setup(engine);
+    AdvanceSummary summary = engine.advance(2);
+    assert(summary.stoppedBy == AdvanceStop::TickBudget);
+    assert(summary.startTick == 0 && summary.endTick == 2 && summary.ticks == 2);
+    assert(summary.moves == 2 && summary.attacks == 0);
+    
+    // Stop on the first kill, then run to the end
+    summary = engine.advance(100, eventBit(EventType::Kill));
+    assert(summary.stoppedBy == AdvanceStop::Event);
+    assert(summary.kills == 1 && summary.attacks == 2 && summary.damage == 116);
+    assert(engine.getTeamAliveCount("teamB") == 1);
+    const int firstKillTick = summary.endTick;
+    summary = engine.advance(100);
+    assert(summary.stoppedBy == AdvanceStop::Finished);
+    assert(engine.getWinner() == "teamA");
+    assert(engine.advance(10).ticks == 0);
+    
+    // Predicate, with event capture off
+    BattleEngine quiet(20, 20);
+    quiet.setEventCapture(false);
+    setup(quiet);
+    summary = quiet.advanceUntil([](const BattleEngine& e) {
+        return e.getTeamAliveCount("teamB") < 2;
+    }, 100);
+    assert(summary.stoppedBy == AdvanceStop::Predicate);
+    assert(summary.endTick == firstKillTick && summary.kills == 1);
+    std::cout << "✓ Advance test passed\n";
+}
+
+void testReplayRoundTrip() {
+    BattleEngine engine(40, 30, 200);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> yDist(0, 29);
+    for (int i = 0; i < 60; i++) {
+        bool teamA = (i % 2) == 0;
+        Unit unit("u" + std::to_string(i), teamA ? "teamA" : "teamB", "soldier");
+        unit.position = Position(teamA ? i % 10 : 39 - i % 10, yDist(rng));
+        unit.range = 1 + (i % 3);
+        unit.attack = 20 + (i % 5);
+        engine.addUnit(unit);
+    }
+    auto policy = [](const Unit& self, const BattleState& state) {
+        Action action;
+        action.type = (self.position.y + state.tick) % 3 == 0 ? Action::MOVE : Action::ATTACK;
+        action.direction = "forward";
+        return action;
+    };
+    engine.setAICallback("teamA", policy);
+    engine.setAICallback("teamB", policy);
+    
+    auto recorder = std::make_shared<ReplayRecorder>(8);
+    engine.setReplayRecorder(recorder);
+    engine.initialize();
+    
+    // Reference states captured while the battle runs
+    std::vector<std::vector<Unit>> states(1, engine.getState().units);
+    engine.advanceUntil([&](const BattleEngine& e) {
+        states.push_back(e.getState().units);
+        return false;
+    }, 1000);
+    assert(engine.isFinished());
+    // The predicate doesn't run after the finishing tick
+    states.push_back(engine.getState().units);
+    assert(static_cast<int>(states.size()) == engine.getCurrentTick() + 1);
+    
+    std::vector<std::uint8_t> bytes = recorder->finish();
+    ReplayReader reader;
+    assert(reader.open(bytes));
+    assert(reader.lastTick() == engine.getCurrentTick());
+    assert(reader.roster().size() == 60 && reader.roster()[5].id == "u5");
+    assert(reader.terrain().size() == 30 && reader.terrain()[0].size() == 40);
+    
+    auto matches = [&](int tick) {
+        const ReplayFrame& frame = reader.frame();
+        const std::vector<Unit>& units = states[tick];
+        if (frame.tick != tick) return false;
+        for (size_t i = 0; i < units.size(); i++) {
+            if (frame.x[i] != units[i].position.x || frame.y[i] != units[i].position.y ||
+                frame.health[i] != units[i].health || frame.cooldown[i] != units[i].cooldown ||
+                (frame.alive[i] != 0) != units[i].isAlive()) {
+                return false;
+            }
+        }
+        return true;
+    };
+    
+    // Streaming forward, then random seeks
+    for (int tick = 0; tick <= reader.lastTick(); tick++) {
+        assert(tick == 0 ? matches(0) : reader.next() && matches(tick));
+    }
+    assert(!reader.next());
+    for (int tick : {reader.lastTick(), 3, 17, 16, 0, 9, reader.lastTick() / 2}) {
+        assert(reader.seek(tick) && matches(tick));
+    }
+    assert(reader.frame().status == BattleStatus::Running);
+    assert(reader.seek(reader.lastTick()) && reader.frame().winner == engine.getWinner());
+    assert(!reader.seek(reader.lastTick() + 1));
+    
+    // Far smaller than a naive dump of every field of every unit per tick
+    const size_t naive = states.size() * 60 * 5 * sizeof(int);
+    assert(bytes.size() * 4 < naive);
+    
+    const size_t replaySize = bytes.size();
+    bytes.resize(replaySize / 2);
+    assert(!ReplayReader().open(bytes));
+    
+    // Corrupt sizes are rejected before anything is allocated: a header
+    // (magic, version, width, height, interval, no units, palette size)
+    // followed by a valid footer index
+    auto corrupt = [](std::vector<std::uint8_t> header) {
+        std::vector<std::uint8_t> data = {'B', 'R', 'P', 'L', 1};
+        data.insert(data.end(), header.begin(), header.end());
+        const size_t footer = data.size();
+        data.insert(data.end(), {1, 0, 5, 0});
+        for (int i = 0; i < 4; i++) data.push_back(static_cast<std::uint8_t>(footer >> (8 * i)));
+        return data;
+    };
+    const std::vector<std::uint8_t> hugePalette = {4, 4, 8, 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01};
+    const std::vector<std::uint8_t> negativeWidth = {0xff, 0xff, 0xff, 0xff, 0x0f, 4, 8, 0, 1};
+    const std::vector<std::uint8_t> hugeGrid = {0xe0, 0xd4, 0x03, 0xe0, 0xd4, 0x03, 8, 0, 1};
+    assert(!ReplayReader().open(corrupt(hugePalette)));
+    assert(!ReplayReader().open(corrupt(negativeWidth)));
+    assert(!ReplayReader().open(corrupt(hugeGrid)));
+    std::cout << "✓ Replay round trip test passed (" << states.size() << " frames, "
+              << replaySize << " bytes)\n";
+}
+
+void testSnapshotAndFork() {
+    // 1000 units, forked mid-battle
+    BattleEngine base(40, 30, 200);
+    for (int i = 0; i < 1000; i++) {
+        bool teamA = (i % 2) == 0;
+        Unit unit("u" + std::to_string(i), teamA ? "teamA" : "teamB", "soldier");
+        unit.position = Position(teamA ? (i / 2) % 15 : 39 - (i / 2) % 15, (i / 30) % 30);
+        base.addUnit(unit);
+    }
+    auto policy = [](const Unit& self, const BattleState& state) {
+        Action action;
+        action.type = (self.position.y + state.tick) % 3 == 0 ? Action::MOVE : Action::ATTACK;
+        action.direction = "forward";
+        return action;
+    };
+    base.setAICallback("teamA", policy);
+    base.setAICallback("teamB", policy);
+    base.initialize();
+    base.advance(10);
+    
+    auto start = std::chrono::steady_clock::now();
+    BattleEngine forked = base.fork();
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    
+    // Terrain is shared, not copied
+    assert(&forked.getState().terrain.grid() == &base.getState().terrain.grid());
+    assert(forked.getCurrentTick() == 10);
+    
+    // The fork plays out exactly as the original would
+    BattleEngine::Snapshot saved = base.snapshot();
+    forked.advance(20);
+    base.advance(20);
+    assert(forked.getCurrentTick() == base.getCurrentTick());
+    for (size_t i = 0; i < base.getState().units.size(); i++) {
+        assert(forked.getState().units[i].position == base.getState().units[i].position);
+        assert(forked.getState().units[i].health == base.getState().units[i].health);
+        assert(forked.getState().units[i].id == base.getState().units[i].id);
+    }
+    assert(forked.getBattleStats().logs == base.getBattleStats().logs);
+    
+    // Changing the fork's setup leaves the original alone
+    forked.setAICallback("teamA", nullptr);
+    forked.addUnit(Unit("extra", "teamA", "scout"));
+    assert(base.getState().units.size() == 1000);
+    assert(forked.getState().units.size() == 1001);
+    
+    // Restore rewinds to the snapshot, and replays identically
+    const std::vector<Unit> after = base.getState().units;
+    assert(base.restore(saved));
+    assert(base.getCurrentTick() == 10);
+    base.advance(20);
+    for (size_t i = 0; i < after.size(); i++) {
+        assert(base.getState().units[i].position == after[i].position);
+        assert(base.getState().units[i].health == after[i].health);
+    }
+    assert(!forked.restore(saved));
+
+    // Units following saved paths (a chaser whose goal moves every tick
+    // through mud) replay identically in a fork and after a restore
+    BattleEngine chase(96, 96, 200);
+    std::vector<std::vector<TerrainCell>> mud(96, std::vector<TerrainCell>(96));
+    for (int y = 0; y < 96; y++) {
+        for (int x = 0; x < 96; x++) {
+            if ((x * 5 + y * 3) % 2 == 0 || (x * x + y) % 5 == 1) mud[y][x] = TerrainCell("mud", 3.0);
+        }
+    }
+    assert(chase.setTerrain(mud));
+    Unit chaser("chaser", "teamA", "soldier");
+    chaser.position = Position(13, 80);
+    Unit runner("runner", "teamB", "scout");
+    runner.position = Position(60, 20);
+    chase.addUnit(chaser);
+    chase.addUnit(runner);
+    chase.setAICallback("teamA", [](const Unit&, const BattleState& state) {
+        Action action;
+        action.type = Action::MOVE;
+        action.targetPosition = state.units[1].position;
+        return action;
+    });
+    chase.setAICallback("teamB", [](const Unit&, const BattleState& state) {
+        Action action;
+        action.type = Action::MOVE;
+        const char* directions[] = {"right", "down", "left", "up"};
+        action.direction = directions[(state.tick / 3) % 4];
+        return action;
+    });
+    chase.initialize();
+    chase.advance(3);
+    BattleEngine chaseFork = chase.fork();
+    BattleEngine::Snapshot chaseSaved = chase.snapshot();
+    chase.advance(30);
+    chaseFork.advance(30);
+    const Position chaserEnd = chase.getState().units[0].position;
+    assert(chaseFork.getState().units[0].position == chaserEnd);
+    assert(chase.restore(chaseSaved));
+    chase.advance(30);
+    assert(chase.getState().units[0].position == chaserEnd);
+    std::cout << "✓ Snapshot and fork test passed (fork of 1000 units: " << micros << " us)\n";
+}
+
+void testMctsController() {
+    // Mirrored armies: archers behind a line of soldiers on each side
+    auto play = [](const std::string& mctsTeam, int threads) {
+        BattleEngine engine(20, 10, 300);
+        for (int i = 0; i < 4; i++) {
+            for (int side = 0; side < 2; side++) {
+                bool archer = i % 2 == 1;
+                Unit unit("u" + std::to_string(i * 2 + side), side == 0 ? "teamA" : "teamB",
+                          archer ? "archer" : "soldier");
+                int x = archer ? 1 : 3;
+                unit.position = Position(side == 0 ? x : 19 - x, 2 + i * 2);
+                unit.range = archer ? 4 : 1;
+                unit.health = unit.maxHealth = archer ? 70 : 120;
+                unit.attack = archer ? 14 : 20;
+                engine.addUnit(unit);
+            }
+        }
+        engine.setAICallback("teamA", attackClosestPolicy);
+        engine.setAICallback("teamB", attackClosestPolicy);
+        
+        MctsConfig config;
+        config.iterations = 40;
+        config.threads = threads;
+        auto controller = MctsController::attach(engine, mctsTeam, config);
+        engine.run();
+        assert(controller->decisions() > 0);
+        assert(controller->lastIterations() >= 40);
+        return std::make_pair(engine.getWinner(), engine.getCurrentTick());
+    };
+    
+    // A fixed iteration budget gives the same game every time
+    auto first = play("teamA", 1);
+    assert(play("teamA", 1) == first);
+    
+    // It plays at least as well as the baseline from either side
+    assert(first.first == "teamA");
+    assert(play("teamB", 1).first == "teamB");
+    assert(play("teamA", 2).first != "teamB");
+    std::cout << "✓ MCTS controller test passed\n";
+}
+
+void testFlowField() {
+    // Distances are summed move costs of the cells entered
+    auto row = std::make_shared<CostGrid>();
+    row->width = 3;
+    row->height = 1;
+    row->cost = {1.0f, 3.0f, 1.0f};
+    FlowField line;
+    line.update(row, {0});
+    assert(line.distance(0, 0) == 0.0f && line.distance(2, 0) == 4.0f);
+    
+    // Incremental repair matches a rebuild as goals move, die and appear
+    std::mt19937 rng(11);
+    auto costs = std::make_shared<CostGrid>();
+    costs->width = 20;
+    costs->height = 15;
+    const float palette[] = {0.0f, 0.5f, 1.0f, 1.0f, 2.0f, 3.0f};
+    for (int i = 0; i < costs->width * costs->height; i++) {
+        costs->cost.push_back(palette[rng() % 6]);
+    }
+    std::vector<int> goals = {3, 40, 77, 150, 201, 288};
+    FlowField field;
+    field.update(costs, goals);
+    for (int step = 0; step < 60; step++) {
+        for (int& goal : goals) {
+            if (rng() % 3 == 0) goal = rng() % 300;
+        }
+        if (step % 10 == 5) goals.pop_back();
+        if (step % 10 == 9) goals.push_back(rng() % 300);
+        
+        field.update(costs, goals);
+        assert(field.wasRepaired());
+        FlowField fresh;
+        fresh.update(costs, goals);
+        for (int y = 0; y < costs->height; y++) {
+            for (int x = 0; x < costs->width; x++) {
+                assert(field.distance(x, y) == fresh.distance(x, y));
+            }
+        }
+    }
+    
+    // "advance" routes through the gap in a wall and around allies
+    BattleEngine engine(9, 5, 100);
+    std::vector<std::vector<TerrainCell>> terrain(5, std::vector<TerrainCell>(9));
+    for (int y = 0; y < 4; y++) {
+        terrain[y][4] = TerrainCell("wall", 0.0);
+    }
+    engine.setTerrain(terrain);
+    Unit a1("a1", "teamA", "soldier");
+    a1.position = Position(1, 0);
+    Unit a2("a2", "teamA", "soldier");
+    a2.position = Position(1, 1);
+    Unit b("b", "teamB", "soldier");
+    b.position = Position(7, 0);
+    engine.addUnit(a1);
+    engine.addUnit(a2);
+    engine.addUnit(b);
+    engine.setAICallback("teamA", [](const Unit& self, const BattleState& state) {
+        Action action;
+        action.type = Action::MOVE;
+        action.direction = "advance";
+        for (const auto& unit : state.units) {
+            if (unit.team != self.team && unit.isAlive() &&
+                self.position.distanceTo(unit.position) <= self.range) {
+                action.type = Action::ATTACK;
+            }
+        }
+        return action;
+    });
+    
+    assert(engine.getFlowField("teamA").distance(1, 0) == 14.0f);
+    assert(!engine.getFlowField("teamA").reachable(4, 0));
+    assert(engine.getFlowField("nobody").empty());
+    engine.run();
+    assert(engine.getWinner() == "teamA");
+    assert(engine.getTeamAliveCount("teamA") == 2);
+    std::cout << "✓ Flow field test passed\n";
+}
+
+void testPathfinder() {
+    // Random walls and terrain on a map that isn't a whole number of clusters
+    std::mt19937 rng(5);
+    auto costs = std::make_shared<CostGrid>();
+    costs->width = 70;
+    costs->height = 45;
+    const float palette[] = {0.0f, 0.5f, 1.0f, 1.0f, 1.0f, 2.0f, 4.0f};
+    for (int i = 0; i < costs->width * costs->height; i++) {
+        costs->cost.push_back(palette[rng() % 7]);
+    }
+    
+    // Reference: Dijkstra over the whole grid
+    auto optimal = [](const CostGrid& grid, int from, int to) {
+        std::vector<float> dist(grid.cost.size(), CostGrid::kInfinity);
+        std::vector<std::pair<float, int>> open;
+        auto order = std::greater<std::pair<float, int>>();
+        dist[from] = 0.0f;
+        open.emplace_back(0.0f, from);
+        while (!open.empty()) {
+            std::pop_heap(open.begin(), open.end(), order);
+            auto top = open.back();
+            open.pop_back();
+            if (top.first > dist[top.second]) continue;
+            const int cell = top.second, x = cell % grid.width;
+            const int neighbours[4] = {cell - grid.width, x > 0 ? cell - 1 : -1,
+                                       x + 1 < grid.width ? cell + 1 : -1, cell + grid.width};
+            for (int n : neighbours) {
+                if (n < 0 || n >= static_cast<int>(grid.cost.size())) continue;
+                if (n != to && !grid.passable(n)) continue;
+                float next = top.first + (grid.passable(n) ? grid.cost[n] : 1.0f);
+                if (next < dist[n]) {
+                    dist[n] = next;
+                    open.emplace_back(next, n);
+                    std::push_heap(open.begin(), open.end(), order);
+                }
+            }
+        }
+        return dist[to];
+    };
+    
+    // Paths are connected, avoid walls, and stay close to optimal
+    double ratioSum = 0.0;
+    int compared = 0;
+    auto check = [&](const Pathfinder& pathfinder, const CostGrid& grid, int from, int to) {
+        std::vector<int> path;
+        const float best = optimal(grid, from, to);
+        const bool found = pathfinder.findPath(from, to, path);
+        assert(found == (best < CostGrid::kInfinity));
+        if (!found) return;
+        float cost = 0.0f;
+        int at = from;
+        for (int cell : path) {
+            assert(std::abs(cell % grid.width - at % grid.width) +
+                   std::abs(cell / grid.width - at / grid.width) == 1);
+            assert(cell == to || grid.passable(cell));
+            cost += grid.passable(cell) ? grid.cost[cell] : 1.0f;
+            at = cell;
+        }
+        assert(at == to || (from == to && path.empty()));
+        assert(cost <= best * 2.0f + 1e-3f);
+        ratioSum += best > 0.0f ? cost / best : 1.0f;
+        compared++;
+    };
+    
+    Pathfinder pathfinder(costs, 8);
+    std::uniform_int_distribution<int> cell(0, costs->width * costs->height - 1);
+    for (int i = 0; i < 300; i++) {
+        check(pathfinder, *costs, cell(rng), cell(rng));
+    }
+    assert(pathfinder.routeHits() > 0);
+    assert(ratioSum / compared < 1.2);
+    
+    // A local change rebuilds a few clusters, matching a fresh build
+    auto changed = std::make_shared<CostGrid>(*costs);
+    for (int y = 10; y < 30; y++) {
+        changed->cost[y * changed->width + 33] = 0.0f;
+    }
+    const int rebuilt = pathfinder.update(changed);
+    assert(rebuilt > 0 && rebuilt < pathfinder.clusterCount());
+    assert(pathfinder.nodeCount() == Pathfinder(changed, 8).nodeCount());
+    for (int i = 0; i < 300; i++) {
+        check(pathfinder, *changed, cell(rng), cell(rng));
+    }
+    
+    // Opening cells finds the same paths as a fresh build, even for routes
+    // cached through clusters the change didn't touch
+    auto opened = std::make_shared<CostGrid>(*changed);
+    for (int i = 0; i < 200; i++) {
+        const int at = cell(rng);
+        if (!opened->passable(at)) opened->cost[at] = 1.0f;
+    }
+    assert(pathfinder.update(opened) > 0);
+    const Pathfinder fresh(opened, 8);
+    for (int i = 0; i < 300; i++) {
+        const int from = cell(rng), to = cell(rng);
+        std::vector<int> path, expected;
+        assert(pathfinder.findPath(from, to, path) == fresh.findPath(from, to, expected));
+        assert(path == expected);
+    }
+    
+    // A cached "no path" across a wall goes once the wall is opened
+    auto walled = std::make_shared<CostGrid>();
+    walled->width = 128;
+    walled->height = 32;
+    walled->cost.assign(128 * 32, 1.0f);
+    for (int y = 0; y < 32; y++) {
+        walled->cost[y * 128 + 64] = 0.0f;
+    }
+    Pathfinder crossing(walled);
+    std::vector<int> path;
+    assert(!crossing.findPath(5 * 128 + 2, 5 * 128 + 125, path));
+    auto gap = std::make_shared<CostGrid>(*walled);
+    for (int y = 28; y < 32; y++) {
+        gap->cost[y * 128 + 64] = 1.0f;
+    }
+    assert(crossing.update(gap) > 0);
+    std::vector<int> expected;
+    assert(crossing.findPath(5 * 128 + 2, 5 * 128 + 125, path));
+    assert(Pathfinder(gap).findPath(5 * 128 + 2, 5 * 128 + 125, expected) && path == expected);
+    
+    // Units chasing a target go around a wall
+    BattleEngine engine(9, 5, 100);
+    std::vector<std::vector<TerrainCell>> terrain(5, std::vector<TerrainCell>(9));
+    for (int y = 0; y < 4; y++) {
+        terrain[y][4] = TerrainCell("wall", 0.0);
+    }
+    engine.setTerrain(terrain);
+    Unit a("a", "teamA", "soldier");
+    a.position = Position(1, 0);
+    Unit b("b", "teamB", "soldier");
+    b.position = Position(7, 0);
+    engine.addUnit(a);
+    engine.addUnit(b);
+    engine.setAICallback("teamA", [](const Unit& self, const BattleState& state) {
+        Action action;
+        action.type = self.position.distanceTo(state.units[1].position) <= self.range
+            ? Action::ATTACK : Action::MOVE;
+        action.targetUnitId = "b";
+        return action;
+    });
+    
+    assert(engine.findPath(Position(1, 0), Position(7, 0)).size() == 14);
+    engine.run();
+    assert(engine.getWinner() == "teamA");
+    std::cout << "✓ Pathfinder test passed\n";
+}
+
+void testTerrainGrid() {
+    std::cout << "Testing terrain grid...\n";
+    
+    // A large default map is one byte per cell
+    BattleEngine big(1000, 1000, 10);
+    const TerrainGrid& ground = big.getState().terrain.grid();
+    assert(ground.palette().size() == 1);
+    assert(ground.memoryBytes() < 1100000);
+    assert(ground.at(999, 999).type == "ground" && ground.moveCost(0, 0) == 1.0);
+    
+    // Rows are interned into a palette; ragged rows fill with ground
+    std::vector<std::vector<TerrainCell>> rows(37, std::vector<TerrainCell>(45));
+    for (int y = 0; y < 37; y++) {
+        for (int x = 0; x < 45; x++) {
+            if ((x * 7 + y * 3) % 11 == 0) rows[y][x] = TerrainCell("forest", 2.0);
+            if (x == 20 && y > 0) rows[y][x] = TerrainCell("wall", 0.0);
+        }
+    }
+    rows[5].resize(30);
+    TerrainGrid grid;
+    assert(TerrainGrid::fromRows(rows, grid));
+    assert(grid.width() == 45 && grid.height() == 37 && grid.palette().size() == 3);
+    assert(grid[5][40].type == "ground" && grid[6][20].type == "wall");
+    
+    // Tiled layout answers the same lookups and keeps tiles contiguous
+    TerrainGrid tiled = grid.retiled(3);
+    assert(tiled.tileSize() == 8 && tiled.tilesX() == 6 && tiled.tilesY() == 5);
+    for (int y = 0; y < 37; y++) {
+        for (int x = 0; x < 45; x++) {
+            assert(tiled.paletteIndex(x, y) == grid.paletteIndex(x, y));
+        }
+    }
+    assert(tiled.tile(2, 1)[3 * 8 + 4] == grid.paletteIndex(20, 11));
+    assert(tiled.toRows()[6][20].moveCost == 0.0);
+    
+    // Too many distinct cells is rejected without touching the engine
+    BattleEngine engine(45, 37, 10);
+    assert(engine.setTerrain(rows));
+    std::vector<std::vector<TerrainCell>> noisy(1, std::vector<TerrainCell>(300));
+    for (int x = 0; x < 300; x++) noisy[0][x] = TerrainCell("ground", 1.0 + x);
+    assert(!engine.setTerrain(noisy));
+    assert(engine.getState().terrain[6][20].type == "wall");
+    assert(engine.findPath(Position(19, 6), Position(21, 6)).size() > 2);
+    
+    std::cout << "✓ Terrain grid test passed\n";
+}
+
+void testTerrainFile() {
+    std::cout << "Testing terrain file...\n";
+    
+    const std::string json =
+        "{\"name\": \"ridge\", \"terrain\": [\n"
+        "  [\"grass\", {\"type\": \"water\", \"moveCost\": 3}, null, {\"moveCost\": 1.0}],\n"
+        "  [\"grass\", {\"type\": \"wall\", \"moveCost\": 0, \"note\": [1, {}]}]\n"
+        "], \"units\": []}";
+    TerrainGrid small;
+    assert(TerrainFile::parseJson(json, small));
+    assert(small.width() == 4 && small.height() == 2 && small.palette().size() == 4);
+    assert(small[0][1].type == "water" && small[0][1].moveCost == 3.0);
+    assert(small[0][2].type == "ground" && small[0][3].type == "ground" && small[1][3].type == "ground");
+    assert(!TerrainFile::parseJson("[[\"grass\", ]]", small));
+    
+    // A map that isn't a whole number of tiles, with uniform regions
+    std::vector<std::vector<TerrainCell>> rows(70, std::vector<TerrainCell>(100));
+    for (int y = 0; y < 70; y++) {
+        for (int x = 0; x < 100; x++) {
+            if (x > 60 && (x * y) % 7 == 0) rows[y][x] = TerrainCell("forest", 2.0);
+            if (y == 40 && x < 90) rows[y][x] = TerrainCell("wall", 0.0);
+        }
+    }
+    TerrainGrid grid;
+    assert(TerrainGrid::fromRows(rows, grid));
+    
+    const std::string rawPath = "terrain_test_raw.bter";
+    const std::string packedPath = "terrain_test_packed.bter";
+    assert(TerrainFile::write(rawPath, grid, 4));
+    assert(TerrainFile::write(packedPath, grid, 4, true));
+    assert(!TerrainFile::write(rawPath + ".bad", grid, 1));
+    
+    TerrainFile raw;
+    TerrainFile packed;
+    assert(raw.open(rawPath) && packed.open(packedPath));
+    assert(!raw.isCompressed() && packed.isCompressed());
+    assert(raw.tilesX() == 7 && raw.tilesY() == 5 && raw.palette().size() == 3);
+    
+    // The raw grid aliases the file; both read back the same cells
+    TerrainGrid mapped = raw.grid();
+    TerrainGrid decoded = packed.grid();
+    assert(mapped.tileShift() == 4 && mapped.data() == raw.tile(0, 0));
+    for (int y = 0; y < 70; y++) {
+        for (int x = 0; x < 100; x++) {
+            assert(mapped.at(x, y).type == rows[y][x].type);
+            assert(decoded.paletteIndex(x, y) == mapped.paletteIndex(x, y));
+        }
+    }
+    assert(packed.tile(6, 2)[3 * 16 + 5] == mapped.paletteIndex(6 * 16 + 5, 2 * 16 + 3));
+    
+    // Engines share the mapped cells; the grid outlives the file
+    raw.close();
+    BattleEngine engine(100, 70, 50);
+    engine.setTerrainGrid(mapped);
+    assert(engine.getState().terrain->data() == mapped.data());
+    assert(engine.getState().terrain[40][10].type == "wall");
+    assert(engine.findPath(Position(10, 39), Position(10, 41)).size() > 80);
+    // ...and the move costs derived from them, instead of a copy per battle
+    BattleEngine other(100, 70, 50);
+    other.setTerrainGrid(mapped);
+    const CostGrid* costs = engine.getFlowField("teamA").costs().get();
+    assert(other.getFlowField("teamA").costs().get() == costs);
+    BattleEngine plain(100, 70, 50);
+    plain.setTerrainGrid(decoded);
+    assert(plain.getFlowField("teamA").costs().get() != costs);
+    assert(plain.getFlowField("teamA").costs()->cost == costs->cost);
+    
+    // Truncated or foreign files are rejected
+    const std::string badPath = "terrain_test_bad.bter";
+    std::ofstream(badPath, std::ios::binary) << "BTER\x01\x04";
+    assert(!raw.open(badPath));
+    assert(!raw.open("terrain_test_missing.bter"));
+    std::remove(rawPath.c_str());
+    std::remove(packedPath.c_str());
+    std::remove(badPath.c_str());
+    
+    std::cout << "✓ Terrain file test passed\n";
+}
+
+void testStrategy() {
+    std::cout << "Testing strategy language...\n";
+    
+    // Compile errors name the line
+    Strategy strategy;
+    std::string error;
+    assert(!Strategy::compile("attack\nif health < then retreat", strategy, error));
+    assert(error.find("line 2") == 0);
+    assert(!Strategy::compile("move sideways", strategy, error));
+    assert(!Strategy::compile("if mana > 3 then idle", strategy, error));
+    assert(!Strategy::compile("if health > 3 attack", strategy, error));
+    // Deep nesting fails cleanly instead of overflowing the stack
+    const std::string deep = "if " + std::string(200000, '(') + "1" + std::string(200000, ')') + " then attack";
+    assert(!Strategy::compile(deep, strategy, error));
+    assert(error.find("too deeply nested") != std::string::npos);
+    assert(!Strategy::compile("if " + std::string(100000, '-') + "1 > 0 then attack", strategy, error));
+    std::string nestedIfs;
+    for (int i = 0; i < 100000; i++) nestedIfs += "if true then ";
+    assert(!Strategy::compile(nestedIfs + "attack", strategy, error));
+    assert(Strategy::compile("if ((((not not true)))) and -(-(2)) > 1 then attack", strategy, error));
+    
+    const std::string source =
+        "# hurt and alone: run\n"
+        "if health < maxHealth * 0.5 and not allies(3) > 0 then retreat\n"
+        "if enemyDistance <= range then\n"
+        "    if enemyHealth % 2 == 1 or tick / 0 > 1 then attack weakest else attack\n"
+        "move advance; idle";
+    assert(Strategy::compile(source, strategy, error));
+    
+    double health = 100, allies = 0, distance = 5, enemyHealth = 7;
+    auto sense = [&](StrategySensor sensor, double arg) -> double {
+        switch (sensor) {
+            case StrategySensor::Health: return health;
+            case StrategySensor::MaxHealth: return 100;
+            case StrategySensor::Range: return 2;
+            case StrategySensor::EnemyDistance: return distance;
+            case StrategySensor::EnemyHealth: return enemyHealth;
+            case StrategySensor::AlliesWithin: return arg == 3 ? allies : -1;
+            default: return 0;
+        }
+    };
+    assert(strategy.run(sense, 256).action == StrategyAction::MoveAdvance);
+    distance = 2;
+    assert(strategy.run(sense, 256).action == StrategyAction::AttackWeakest);
+    enemyHealth = 8;
+    assert(strategy.run(sense, 256).action == StrategyAction::AttackNearest);
+    health = 40;
+    assert(strategy.run(sense, 256).action == StrategyAction::Retreat);
+    allies = 1;
+    assert(strategy.run(sense, 256).action == StrategyAction::AttackNearest);
+    StrategyDecision cut = strategy.run(sense, 5);
+    assert(cut.exhausted && cut.action == StrategyAction::Idle);
+    
+    // In the engine: a hurt unit backs away from its attacker
+    BattleEngine engine(10, 10, 50);
+    Unit hurt("a1", "teamA", "soldier");
+    hurt.position = Position(5, 5);
+    hurt.health = 30;
+    Unit enemy("b1", "teamB", "soldier");
+    enemy.position = Position(7, 5);
+    engine.addUnit(hurt);
+    engine.addUnit(enemy);
+    assert(!engine.setTeamStrategy("teamA", "retreat now", &error));
+    assert(engine.setTeamStrategy("teamA", "if health < maxHealth * 0.5 then retreat"));
+    engine.initialize();
+    engine.tick();
+    assert(engine.getState().units[0].position == Position(4, 5));
+    
+    // Strategies beat idle armies, with the same result on any thread count
+    auto play = [](int threads) {
+        BattleEngine battle(30, 12, 300);
+        for (int i = 0; i < 12; i++) {
+            Unit a("a" + std::to_string(i), "teamA", "soldier");
+            a.position = Position(2 + i % 3, i);
+            a.range = i % 2 ? 3 : 1;
+            Unit b("b" + std::to_string(i), "teamB", "soldier");
+            b.position = Position(27 - i % 3, i);
+            battle.addUnit(a);
+            battle.addUnit(b);
+        }
+        battle.setTeamStrategy("teamA",
+            "if enemyDistance <= range then attack weakest\n"
+            "if enemies(4) > allies(4) + 2 then move left\n"
+            "move enemy");
+        battle.setTickMode(TickMode::TwoPhase);
+        battle.setDecisionThreads(threads);
+        battle.run();
+        return std::make_pair(battle.getWinner(), battle.getCurrentTick());
+    };
+    auto single = play(1);
+    assert(single.first == "teamA");
+    assert(play(4) == single);
+    
+    std::cout << "✓ Strategy test passed (" << strategy.code().size() << " instructions)\n";
+}
+
+void testTeamPolicy() {
+    std::cout << "Testing built-in team policies...\n";
+    
+    TeamPolicy parsed;
+    assert(parseTeamPolicy("retreatAndHeal", parsed) && parsed == TeamPolicy::RetreatAndHeal);
+    assert(!parseTeamPolicy("berserk", parsed));
+    
+    // A hurt unit with no enemy nearby heals itself; an archer backs away
+    // from a soldier that could reach it next tick
+    BattleEngine engine(20, 10, 50);
+    Unit hurt("a1", "teamA", "soldier");
+    hurt.position = Position(0, 0);
+    hurt.health = 20;
+    Unit archer("a2", "teamA", "archer");
+    archer.position = Position(10, 5);
+    archer.range = 4;
+    Unit enemy("b1", "teamB", "soldier");
+    enemy.position = Position(12, 5);
+    engine.addUnit(hurt);
+    engine.addUnit(archer);
+    engine.addUnit(enemy);
+    assert(!engine.setTeamPolicy("teamA", "berserk"));
+    PolicyParams params;
+    params.engageRange = 5;
+    engine.setTeamPolicy("teamA", TeamPolicy::RetreatAndHeal, params);
+    engine.initialize();
+    engine.tick();
+    assert(engine.getState().units[0].health == 25);
+    bool healed = false;
+    for (int i = 0; i < engine.getEvents().size(); i++) {
+        const BattleEvent& event = engine.getEvents().at(i);
+        healed |= event.type == EventType::Heal && event.amount == 5;
+    }
+    assert(healed);
+    
+    engine.reset();
+    engine.addUnit(hurt);
+    engine.addUnit(archer);
+    engine.addUnit(enemy);
+    engine.setTeamPolicy("teamA", "kite");
+    engine.initialize();
+    engine.tick();
+    assert(engine.getState().units[1].position == Position(9, 5));
+    
+    // A held unit waits at its post while the enemy is far off
+    engine.reset();
+    engine.addUnit(archer);
+    Unit far("b1", "teamB", "soldier");
+    far.position = Position(19, 0);
+    engine.addUnit(far);
+    engine.setTeamPolicy("teamA", TeamPolicy::HoldFormation);
+    engine.initialize();
+    for (int i = 0; i < 5; i++) engine.tick();
+    assert(engine.getState().units[0].position == Position(10, 5));
+    
+    // Every attacking policy beats an idle army
+    const TeamPolicy attackers[] = {
+        TeamPolicy::FocusFire, TeamPolicy::Kite, TeamPolicy::Flank, TeamPolicy::RetreatAndHeal
+    };
+    for (TeamPolicy policy : attackers) {
+        BattleEngine battle(30, 12, 400);
+        for (int i = 0; i < 8; i++) {
+            Unit a("a" + std::to_string(i), "teamA", "soldier");
+            a.position = Position(2, i);
+            a.range = i % 2 ? 3 : 1;
+            Unit b("b" + std::to_string(i), "teamB", "soldier");
+            b.position = Position(27, i + 2);
+            battle.addUnit(a);
+            battle.addUnit(b);
+        }
+        battle.setTeamPolicy("teamA", policy);
+        battle.setTickMode(TickMode::TwoPhase);
+        battle.run();
+        assert(battle.getWinner() == "teamA");
+    }
+    
+    std::cout << "✓ Team policy test passed\n";
+}
+
+void testTeamDecisionCallback() {
+    std::cout << "Testing batched team callbacks...\n";
+    
+    // The same attack-or-advance AI per unit and per team plays out the same
+    auto setup = [](BattleEngine& battle) {
+        for (int i = 0; i < 10; i++) {
+            Unit a("a" + std::to_string(i), "teamA", "soldier");
+            a.position = Position(1, i);
+            a.range = 1 + i % 3;
+            Unit b("b" + std::to_string(i), "teamB", "soldier");
+            b.position = Position(18, i);
+            battle.addUnit(a);
+            battle.addUnit(b);
+        }
+        battle.setTickMode(TickMode::TwoPhase);
+        battle.setAICallback("teamB", [](const Unit&, const BattleState&) {
+            Action action;
+            action.type = Action::ATTACK;
+            return action;
+        });
+    };
+    
+    BattleEngine perUnit(20, 10, 300);
+    setup(perUnit);
+    int unitCalls = 0;
+    perUnit.setAICallback("teamA", [&](const Unit& unit, const BattleState& state) {
+        unitCalls++;
+        Action action;
+        const Unit* nearest = nullptr;
+        for (const Unit& other : state.units) {
+            if (other.isAlive() && other.team != unit.team &&
+                (!nearest || unit.position.distanceTo(other.position) < unit.position.distanceTo(nearest->position))) {
+                nearest = &other;
+            }
+        }
+        if (!nearest) return action;
+        if (unit.position.distanceTo(nearest->position) <= unit.range) {
+            action.type = Action::ATTACK;
+            action.targetUnitId = nearest->id;
+        } else {
+            action.type = Action::MOVE;
+            action.targetPosition = nearest->position;
+        }
+        return action;
+    });
+    perUnit.run();
+    
+    BattleEngine batched(20, 10, 300);
+    setup(batched);
+    int teamCalls = 0;
+    int readyUnits = 0;
+    batched.setTeamDecisionCallback("teamA", [&](const TeamBatch& batch, Action* actions) {
+        teamCalls++;
+        readyUnits += batch.count;
+        for (int k = 0; k < batch.count; k++) {
+            assert(batch.units.x[batch.slots[k]] == batch.x[k] && batch.unitHealth[batch.slots[k]] == batch.health[k]);
+            const Position self(batch.x[k], batch.y[k]);
+            int nearest = -1;
+            for (int i = 0; i < batch.units.count; i++) {
+                if (batch.units.alive[i] && batch.units.team[i] != batch.units.team[batch.slots[k]] &&
+                    (nearest < 0 || self.distanceTo(Position(batch.units.x[i], batch.units.y[i])) <
+                                    self.distanceTo(Position(batch.units.x[nearest], batch.units.y[nearest])))) {
+                    nearest = i;
+                }
+            }
+            if (nearest < 0) continue;
+            const Position target(batch.units.x[nearest], batch.units.y[nearest]);
+            if (self.distanceTo(target) <= batch.range[k]) {
+                actions[k].type = Action::ATTACK;
+                actions[k].targetUnitId = batched.unitId(nearest);
+            } else {
+                actions[k].type = Action::MOVE;
+                actions[k].targetPosition = target;
+            }
+        }
+    });
+    batched.run();
+    
+    assert(batched.getWinner() == perUnit.getWinner());
+    assert(batched.getCurrentTick() == perUnit.getCurrentTick());
+    assert(readyUnits == unitCalls);
+    assert(teamCalls <= batched.getCurrentTick() && teamCalls < unitCalls);
+    
+    std::cout << "✓ Team decision callback test passed (" << teamCalls << " calls instead of "
+              << unitCalls << ")\n";
+}
+
+void testPerfCounters() {
+    std::cout << "Testing perf counters and trace...\n";
+    
+    BattleEngine engine(20, 10, 200);
+    for (int i = 0; i < 6; i++) {
+        Unit a("a" + std::to_string(i), "teamA", "soldier");
+        a.position = Position(1, i);
+        Unit b("b" + std::to_string(i), "teamB", "soldier");
+        b.position = Position(18, i);
+        engine.addUnit(a);
+        engine.addUnit(b);
+    }
+    engine.setAICallback("teamA", [](const Unit&, const BattleState&) {
+        Action action;
+        action.type = Action::ATTACK;
+        return action;
+    });
+    engine.setTeamPolicy("teamB", TeamPolicy::FocusFire);
+    engine.setTickMode(TickMode::TwoPhase);
+    engine.initialize();
+    
+    // Off by default
+    engine.tick();
+    assert(engine.getPerfCounters().ticks == 0);
+    
+    engine.setPerfTrace(true);
+    for (int i = 0; i < 20; i++) engine.tick();
+    PerfCounters counters = engine.getPerfCounters();
+    const std::string trace = engine.getPerfTrace();
+#if BATTLE_PERF_COUNTERS
+    assert(counters.ticks == 20);
+    // Units on cooldown don't decide
+    assert(counters.callbackInvocations > 0 && counters.callbackInvocations <= 20 * 6);
+    assert(counters.decisions > counters.callbackInvocations && counters.decisions <= 20 * 12);
+    assert(counters.collisionChecks > 0 && counters.unitsScanned > 0);
+    assert(counters.decideMs > 0.0);
+    assert(trace.find("\"traceEvents\"") != std::string::npos);
+    assert(trace.find("\"name\":\"tick\"") != std::string::npos);
+    assert(trace.find("\"name\":\"decide\"") != std::string::npos);
+#else
+    assert(counters.ticks == 0);
+#endif
+    
+    // Disabling stops the totals
+    engine.setPerfCounters(false);
+    engine.tick();
+    assert(engine.getPerfCounters().ticks == counters.ticks);
+    
+    std::cout << "✓ Perf counters test passed (" << trace.size() << " bytes of trace)\n";
+}
+
+void testResultCache() {
+    std::cout << "Testing input hash and result cache...\n";
+    
+    // The same battle assembled differently hashes the same
+    auto build = [](BattleEngine& engine, int tileShift, bool reversePalette, bool policyFirst) {
+        const TerrainCell forest("forest", 2.0);
+        std::vector<std::uint8_t> cells(20 * 10, reversePalette ? 1 : 0);
+        for (int x = 5; x < 9; x++) cells[4 * 20 + x] = reversePalette ? 0 : 1;
+        std::vector<TerrainCell> palette = {TerrainCell(), forest};
+        if (reversePalette) std::swap(palette[0], palette[1]);
+        TerrainGrid terrain;
+        assert(TerrainGrid::fromPacked(cells.data(), 20, 10, palette, terrain, tileShift));
+        engine.setTerrainGrid(terrain);
+        if (policyFirst) engine.setTeamPolicy("teamB", TeamPolicy::Kite);
+        for (int i = 0; i < 4; i++) {
+            Unit a("a" + std::to_string(i), "teamA", "soldier");
+            a.position = Position(1, 2 * i);
+            Unit b("b" + std::to_string(i), "teamB", "archer");
+            b.position = Position(18, 2 * i);
+            b.range = 3;
+            engine.addUnit(a);
+            engine.addUnit(b);
+        }
+        engine.setTeamStrategy("teamA", "if enemyDistance <= range then attack\nmove enemy");
+        if (!policyFirst) engine.setTeamPolicy("teamB", TeamPolicy::Kite);
+        engine.setSeed(7);
+    };
+    BattleEngine first(20, 10, 300);
+    BattleEngine second(20, 10, 300);
+    build(first, 0, false, false);
+    build(second, 3, true, true);
+    Hash128 firstHash, secondHash;
+    assert(first.inputHash(firstHash) && second.inputHash(secondHash));
+    assert(firstHash == secondHash && firstHash.toHex().size() == 32);
+    
+    second.setSeed(8);
+    assert(second.inputHash(secondHash) && secondHash != firstHash);
+    second.setSeed(7);
+    second.setTeamPolicy("teamB", TeamPolicy::Kite, PolicyParams());
+    assert(second.inputHash(secondHash) && secondHash == firstHash);
+    
+    // run() starts over at tick 0, so the current tick isn't hashed
+    BattleEngine later(20, 10, 300);
+    later.initialize();
+    later.tick();
+    build(later, 0, false, false);
+    Hash128 laterHash;
+    assert(later.getState().tick == 1);
+    assert(later.inputHash(laterHash) && laterHash == firstHash);
+    
+    // Callbacks need a key to be hashed
+    BattleEngine scripted(20, 10, 300);
+    build(scripted, 0, false, false);
+    scripted.setTeamStrategy("teamA", "");
+    scripted.setAICallback("teamA", [](const Unit&, const BattleState&) { return Action(); });
+    Hash128 scriptedHash;
+    assert(!scripted.inputHash(scriptedHash));
+    scripted.setCallbackKey("teamA", "idle-v1");
+    assert(scripted.inputHash(scriptedHash) && scriptedHash != firstHash);
+    
+    // A repeat is served from the cache without running
+    BattleResultCache cache(1 << 20);
+    const BattleEngine::BattleStats played = cache.run(first);
+    assert(cache.misses() == 1 && cache.hits() == 0 && cache.size() == 1);
+    const BattleEngine::BattleStats cached = cache.run(second);
+    assert(cache.hits() == 1 && second.getCurrentTick() == 0);
+    assert(cached.winner == played.winner && cached.totalTicks == played.totalTicks &&
+           cached.totalDamageDealt == played.totalDamageDealt && cached.logs == played.logs);
+    
+    BattleEngine unkeyed(20, 10, 50);
+    unkeyed.setAICallback("teamA", [](const Unit&, const BattleState&) { return Action(); });
+    unkeyed.addUnit(Unit("a0", "teamA", "soldier"));
+    cache.run(unkeyed);
+    assert(cache.uncacheable() == 1 && cache.size() == 1);
+    
+    // The budget bounds the footprint, evicting the oldest entries
+    const size_t one = cache.memoryBytes();
+    cache.setMaxBytes(one * 2 + one / 2);
+    for (int seed = 0; seed < 5; seed++) {
+        BattleEngine engine(20, 10, 300);
+        build(engine, 0, false, false);
+        engine.setSeed(100 + seed);
+        cache.run(engine);
+    }
+    assert(cache.memoryBytes() <= cache.maxBytes() && cache.size() <= 2 && cache.evictions() >= 4);
+    
+    std::cout << "✓ Result cache test passed (" << firstHash.toHex() << ")\n";
+}
+
 int main() {
     std::cout << "Running Battle Simulator Tests...\n\n";
     
@@ -152,6 +1702,31 @@ int main() {
         testMovement();
         testTeamCounting();
         testSimpleBattle();
+        testSpatialGridQueries();
+        testSpatialIndexMatchesLinearScan();
+        testUnitViewTracksStore();
+        testInternedLookups();
+        testSimdKernelsMatchScalar();
+        testTwoPhaseConflictPolicy();
+        testTwoPhaseSimultaneousAttacks();
+        testTwoPhaseThreadCountInvariant();
+        testEventLog();
+        testStateDelta();
+        testStateBuffer();
+        testPackedSetup();
+        testAdvance();
+        testReplayRoundTrip();
+        testSnapshotAndFork();
+        testMctsController();
+        testFlowField();
+        testPathfinder();
+        testTerrainGrid();
+        testTerrainFile();
+        testStrategy();
+        testTeamPolicy();
+        testTeamDecisionCallback();
+        testPerfCounters();
+        testResultCache();
         
         std::cout << "\n✅ All tests passed!\n";
         return 0;
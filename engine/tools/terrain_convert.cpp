@@ -0,0 +1,60 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include "../include/TerrainFile.h"
+
+using namespace BattleSimulator;
+
+// Converts the JSON terrain the backend sends (an array of rows, or a battle
+// configuration with a "terrain" member) into a tiled terrain file.
+//
+// Usage: terrain_convert <in.json> <out.bter> [tileShift] [--compress]
+//        (default tileShift 5: 32x32 tiles)
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: terrain_convert <in.json> <out.bter> [tileShift] [--compress]\n";
+        return 2;
+    }
+    int tileShift = 5;
+    bool compress = false;
+    for (int i = 3; i < argc; i++) {
+        if (std::string(argv[i]) == "--compress") {
+            compress = true;
+        } else {
+            tileShift = std::atoi(argv[i]);
+        }
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "cannot read " << argv[1] << "\n";
+        return 1;
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+
+    TerrainGrid grid;
+    if (!TerrainFile::parseJson(text.str(), grid)) {
+        std::cerr << "malformed terrain JSON (or more than 256 distinct cells)\n";
+        return 1;
+    }
+    if (!TerrainFile::write(argv[2], grid, tileShift, compress)) {
+        std::cerr << "cannot write " << argv[2] << " (tileShift must be 3..10)\n";
+        return 1;
+    }
+
+    TerrainFile file;
+    if (!file.open(argv[2])) {
+        std::cerr << "wrote " << argv[2] << " but cannot read it back\n";
+        return 1;
+    }
+    std::ifstream written(argv[2], std::ios::binary | std::ios::ate);
+    std::cout << grid.width() << "x" << grid.height() << ", " << grid.palette().size()
+              << " terrain types, " << file.tilesX() * file.tilesY() << " tiles of "
+              << (1 << tileShift) << "x" << (1 << tileShift) << (compress ? " (compressed)" : "")
+              << ", " << written.tellg() << " bytes\n";
+    return 0;
+}